@@ -3,6 +3,9 @@
  * Copyright (c) 2021 Rockchip Electronics Co. Ltd.
  */
 
+#include <linux/debugfs.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/dma-buf.h>
 #undef CONFIG_DMABUF_CACHE
@@ -10,17 +13,150 @@
 
 /* NOTE: dma-buf-cache APIs are not irq safe, please DO NOT run in irq context !! */
 
+/*
+ * Lock order: dmabuf->cache_lock, then dma_buf_cache_lru_lock. Eviction
+ * takes the cache_lock of other dma-bufs with mutex_trylock() only.
+ */
+
+/* Cached attachments kept per device before the least recent is dropped */
+static unsigned int max_entries = 256;
+module_param(max_entries, uint, 0644);
+MODULE_PARM_DESC(max_entries, "max cached attachments per device, 0 for no limit");
+
 struct dma_buf_cache_list {
 	struct list_head head;
 };
 
+/* Per-device LRU of cached attachments, freed with its last entry */
+struct dma_buf_cache_dev {
+	struct list_head node;
+	struct device *dev;
+	struct list_head lru;
+	unsigned int count;
+	unsigned long evict;
+};
+
 struct dma_buf_cache {
 	struct list_head list;
+	struct list_head lru;
+	struct dma_buf_cache_dev *cdev;
 	struct dma_buf_attachment *attach;
 	enum dma_data_direction direction;
 	struct sg_table *sg_table;
+	/* attach calls not yet balanced by detach, never evicted while set */
+	unsigned int users;
 };
 
+static DEFINE_MUTEX(dma_buf_cache_lru_lock);
+static LIST_HEAD(dma_buf_cache_devs);
+
+static struct {
+	atomic_long_t attach_hit;
+	atomic_long_t attach_miss;
+	atomic_long_t map_hit;
+	atomic_long_t map_miss;
+	atomic_long_t evict;
+	atomic_long_t entries;
+	atomic_long_t bytes;
+} dma_buf_cache_stats;
+
+static void dma_buf_cache_release_entry(struct dma_buf *dmabuf,
+					struct dma_buf_cache *cache)
+{
+	if (!IS_ERR_OR_NULL(cache->sg_table))
+		dma_buf_unmap_attachment(cache->attach,
+					 cache->sg_table,
+					 cache->direction);
+
+	dma_buf_detach(dmabuf, cache->attach);
+	atomic_long_dec(&dma_buf_cache_stats.entries);
+	atomic_long_sub(dmabuf->size, &dma_buf_cache_stats.bytes);
+	kfree(cache);
+}
+
+/* Called with dma_buf_cache_lru_lock held */
+static void dma_buf_cache_lru_del(struct dma_buf_cache *cache)
+{
+	struct dma_buf_cache_dev *cdev = cache->cdev;
+
+	list_del(&cache->lru);
+	if (!--cdev->count) {
+		list_del(&cdev->node);
+		kfree(cdev);
+	}
+}
+
+/*
+ * Drop the least recently used idle attachments of @cdev until it is
+ * back under max_entries. Called with dma_buf_cache_lru_lock held.
+ */
+static void dma_buf_cache_lru_evict(struct dma_buf_cache_dev *cdev)
+{
+	struct dma_buf_cache *cache, *tmp;
+	struct dma_buf *dmabuf;
+	unsigned int limit = READ_ONCE(max_entries);
+
+	list_for_each_entry_safe(cache, tmp, &cdev->lru, lru) {
+		if (!limit || cdev->count <= limit)
+			return;
+		if (cache->users)
+			continue;
+
+		dmabuf = cache->attach->dmabuf;
+		/* Busy, or the dma-buf we are caching for right now */
+		if (!mutex_trylock(&dmabuf->cache_lock))
+			continue;
+
+		list_del(&cache->list);
+		list_del(&cache->lru);
+		cdev->count--;
+		cdev->evict++;
+		dma_buf_cache_release_entry(dmabuf, cache);
+		atomic_long_inc(&dma_buf_cache_stats.evict);
+
+		mutex_unlock(&dmabuf->cache_lock);
+	}
+}
+
+static int dma_buf_cache_lru_add(struct dma_buf_cache *cache,
+				 struct device *dev)
+{
+	struct dma_buf_cache_dev *cdev;
+
+	mutex_lock(&dma_buf_cache_lru_lock);
+
+	list_for_each_entry(cdev, &dma_buf_cache_devs, node) {
+		if (cdev->dev == dev)
+			goto found;
+	}
+
+	cdev = kzalloc(sizeof(*cdev), GFP_KERNEL);
+	if (!cdev) {
+		mutex_unlock(&dma_buf_cache_lru_lock);
+		return -ENOMEM;
+	}
+	cdev->dev = dev;
+	INIT_LIST_HEAD(&cdev->lru);
+	list_add(&cdev->node, &dma_buf_cache_devs);
+
+found:
+	cache->cdev = cdev;
+	list_add_tail(&cache->lru, &cdev->lru);
+	cdev->count++;
+	dma_buf_cache_lru_evict(cdev);
+
+	mutex_unlock(&dma_buf_cache_lru_lock);
+
+	return 0;
+}
+
+static void dma_buf_cache_lru_touch(struct dma_buf_cache *cache)
+{
+	mutex_lock(&dma_buf_cache_lru_lock);
+	list_move_tail(&cache->lru, &cache->cdev->lru);
+	mutex_unlock(&dma_buf_cache_lru_lock);
+}
+
 static int dma_buf_cache_destructor(struct dma_buf *dmabuf, void *dtor_data)
 {
 	struct dma_buf_cache_list *data;
@@ -31,14 +167,12 @@ static int dma_buf_cache_destructor(struct dma_buf *dmabuf, void *dtor_data)
 	data = dmabuf->dtor_data;
 
 	list_for_each_entry_safe(cache, tmp, &data->head, list) {
-		if (!IS_ERR_OR_NULL(cache->sg_table))
-			dma_buf_unmap_attachment(cache->attach,
-						 cache->sg_table,
-						 cache->direction);
+		mutex_lock(&dma_buf_cache_lru_lock);
+		dma_buf_cache_lru_del(cache);
+		mutex_unlock(&dma_buf_cache_lru_lock);
 
-		dma_buf_detach(dmabuf, cache->attach);
 		list_del(&cache->list);
-		kfree(cache);
+		dma_buf_cache_release_entry(dmabuf, cache);
 	}
 
 	mutex_unlock(&dmabuf->cache_lock);
@@ -77,6 +211,8 @@ void dma_buf_cache_detach(struct dma_buf *dmabuf,
 	cache = dma_buf_cache_get_cache(attach);
 	if (!cache)
 		dma_buf_detach(dmabuf, attach);
+	else if (cache->users)
+		cache->users--;
 
 	mutex_unlock(&dmabuf->cache_lock);
 }
@@ -112,6 +248,9 @@ struct dma_buf_attachment *dma_buf_cache_attach(struct dma_buf *dmabuf,
 		if (cache->attach->dev == dev) {
 			/* Already attached */
 			attach = cache->attach;
+			cache->users++;
+			dma_buf_cache_lru_touch(cache);
+			atomic_long_inc(&dma_buf_cache_stats.attach_hit);
 			goto attach_done;
 		}
 	}
@@ -127,7 +266,16 @@ struct dma_buf_attachment *dma_buf_cache_attach(struct dma_buf *dmabuf,
 		goto err_attach;
 
 	cache->attach = attach;
+	cache->users = 1;
+	if (dma_buf_cache_lru_add(cache, dev)) {
+		/* No LRU bookkeeping, hand out an uncached attachment */
+		kfree(cache);
+		goto attach_done;
+	}
 	list_add(&cache->list, &data->head);
+	atomic_long_inc(&dma_buf_cache_stats.attach_miss);
+	atomic_long_inc(&dma_buf_cache_stats.entries);
+	atomic_long_add(dmabuf->size, &dma_buf_cache_stats.bytes);
 
 attach_done:
 	mutex_unlock(&dmabuf->cache_lock);
@@ -136,8 +284,10 @@ attach_done:
 err_attach:
 	kfree(cache);
 err_cache:
-	kfree(data);
-	dma_buf_set_destructor(dmabuf, NULL, NULL);
+	if (list_empty(&data->head)) {
+		kfree(data);
+		dma_buf_set_destructor(dmabuf, NULL, NULL);
+	}
 err_data:
 	mutex_unlock(&dmabuf->cache_lock);
 	return attach;
@@ -179,6 +329,7 @@ struct sg_table *dma_buf_cache_map_attachment(struct dma_buf_attachment *attach,
 		/* Already mapped */
 		if (cache->direction == direction) {
 			sg_table = cache->sg_table;
+			atomic_long_inc(&dma_buf_cache_stats.map_hit);
 			goto map_done;
 		}
 		/* Different directions */
@@ -190,9 +341,48 @@ struct sg_table *dma_buf_cache_map_attachment(struct dma_buf_attachment *attach,
 	sg_table = dma_buf_map_attachment(attach, direction);
 	cache->sg_table = sg_table;
 	cache->direction = direction;
+	atomic_long_inc(&dma_buf_cache_stats.map_miss);
 
 map_done:
 	mutex_unlock(&dmabuf->cache_lock);
 	return sg_table;
 }
 EXPORT_SYMBOL(dma_buf_cache_map_attachment);
+
+#ifdef CONFIG_DEBUG_FS
+static int dma_buf_cache_show(struct seq_file *s, void *unused)
+{
+	struct dma_buf_cache_dev *cdev;
+
+	seq_printf(s, "attach: hit %ld miss %ld\n",
+		   atomic_long_read(&dma_buf_cache_stats.attach_hit),
+		   atomic_long_read(&dma_buf_cache_stats.attach_miss));
+	seq_printf(s, "map: hit %ld miss %ld\n",
+		   atomic_long_read(&dma_buf_cache_stats.map_hit),
+		   atomic_long_read(&dma_buf_cache_stats.map_miss));
+	seq_printf(s, "entries %ld bytes %ld evict %ld max_entries %u\n",
+		   atomic_long_read(&dma_buf_cache_stats.entries),
+		   atomic_long_read(&dma_buf_cache_stats.bytes),
+		   atomic_long_read(&dma_buf_cache_stats.evict),
+		   READ_ONCE(max_entries));
+
+	seq_puts(s, "\ndevice\tentries\tevict\n");
+	mutex_lock(&dma_buf_cache_lru_lock);
+	list_for_each_entry(cdev, &dma_buf_cache_devs, node)
+		seq_printf(s, "%s\t%u\t%lu\n", dev_name(cdev->dev),
+			   cdev->count, cdev->evict);
+	mutex_unlock(&dma_buf_cache_lru_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dma_buf_cache);
+
+static int __init dma_buf_cache_debugfs_init(void)
+{
+	debugfs_create_file("dma_buf_cache", 0444, NULL, NULL,
+			    &dma_buf_cache_fops);
+
+	return 0;
+}
+late_initcall(dma_buf_cache_debugfs_init);
+#endif
@@ -9,20 +9,80 @@
  */
 
 #include <linux/freezer.h>
+#include <linux/jiffies.h>
+#include <linux/kobject.h>
 #include <linux/list.h>
+#include <linux/percpu.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/swap.h>
+#include <linux/sysfs.h>
+#include <linux/workqueue.h>
 #include <linux/sched/signal.h>
 #include "page_pool.h"
 
+/*
+ * Per-CPU magazine in front of the shared lists. Pages move between a
+ * magazine and the shared lists in batches of half the magazine, and
+ * the vmstat/pool_pages updates for pages passing through the magazine
+ * are accumulated in @vm_delta and flushed in batches as well.
+ *
+ * The lock is only ever contended by the shrinker draining the
+ * magazine from another CPU.
+ */
+struct dmabuf_page_pool_pcp {
+	spinlock_t lock;
+	struct list_head items;
+	int count;
+	int vm_delta;
+	struct pglist_data *vm_pgdat;
+};
+
+/* Pages (not items) a magazine may hold, so order 8 pools get none */
+#define POOL_PCP_PAGES		64
+
+/*
+ * @low_watermark/@high_watermark: when an allocation leaves fewer than
+ * @low_watermark items in the pool, the refill worker tops it up to
+ * @high_watermark items in the background. 0 disables refilling.
+ * @pcp_size: items per magazine, 0 if @pcp is not used.
+ */
 struct dmabuf_page_pool_with_spinlock {
 	struct dmabuf_page_pool pool;
 	struct spinlock spinlock;
+	struct dmabuf_page_pool_pcp __percpu *pcp;
+	int pcp_size;
+	unsigned int low_watermark;
+	unsigned int high_watermark;
+	atomic_long_t hit;
+	atomic_long_t miss;
+	atomic_long_t refill;
+	atomic_long_t overflow;
+	struct kobject kobj;
 };
 
 static LIST_HEAD(pool_list);
 static DEFINE_MUTEX(pool_list_lock);
+static atomic_t pool_id = ATOMIC_INIT(0);
+
+/* pages held by all pools, capped by pool_max_pages (0 means no cap) */
+static atomic_long_t pool_pages = ATOMIC_LONG_INIT(0);
+static unsigned long pool_max_pages;
+
+/* no background refill for a while after the shrinker asked for pages */
+#define POOL_REFILL_BACKOFF	(HZ)
+static unsigned long pool_shrink_jiffies;
+
+static struct kobject *pool_kobj;
+
+static void dmabuf_page_pool_refill_worker(struct work_struct *work);
+static DECLARE_WORK(pool_refill_work, dmabuf_page_pool_refill_worker);
+
+static inline struct dmabuf_page_pool_with_spinlock *
+to_container_pool(struct dmabuf_page_pool *pool)
+{
+	return container_of(pool, struct dmabuf_page_pool_with_spinlock, pool);
+}
 
 static inline
 struct page *dmabuf_page_pool_alloc_pages(struct dmabuf_page_pool *pool)
@@ -53,6 +113,7 @@ static void dmabuf_page_pool_add(struct dmabuf_page_pool *pool, struct page *pag
 	list_add_tail(&page->lru, &pool->items[index]);
 	pool->count[index]++;
 	spin_unlock(&container_pool->spinlock);
+	atomic_long_add(1 << pool->order, &pool_pages);
 	mod_node_page_state(page_pgdat(page), NR_KERNEL_MISC_RECLAIMABLE,
 			    1 << pool->order);
 }
@@ -69,6 +130,7 @@ static struct page *dmabuf_page_pool_remove(struct dmabuf_page_pool *pool, int i
 		pool->count[index]--;
 		list_del(&page->lru);
 		spin_unlock(&container_pool->spinlock);
+		atomic_long_sub(1 << pool->order, &pool_pages);
 		mod_node_page_state(page_pgdat(page), NR_KERNEL_MISC_RECLAIMABLE,
 				    -(1 << pool->order));
 		goto out;
@@ -79,10 +141,161 @@ out:
 	return page;
 }
 
+static void dmabuf_page_pool_pcp_flush_vm(struct dmabuf_page_pool_pcp *pcp)
+{
+	if (!pcp->vm_delta)
+		return;
+
+	atomic_long_add(pcp->vm_delta, &pool_pages);
+	mod_node_page_state(pcp->vm_pgdat, NR_KERNEL_MISC_RECLAIMABLE,
+			    pcp->vm_delta);
+	pcp->vm_delta = 0;
+}
+
+static void dmabuf_page_pool_pcp_account(struct dmabuf_page_pool *pool,
+					 struct dmabuf_page_pool_pcp *pcp,
+					 struct page *page, int sign)
+{
+	struct pglist_data *pgdat = page_pgdat(page);
+
+	if (pcp->vm_pgdat != pgdat) {
+		dmabuf_page_pool_pcp_flush_vm(pcp);
+		pcp->vm_pgdat = pgdat;
+	}
+
+	pcp->vm_delta += sign * (1 << pool->order);
+	if (abs(pcp->vm_delta) >= POOL_PCP_PAGES)
+		dmabuf_page_pool_pcp_flush_vm(pcp);
+}
+
+/*
+ * Move up to @nr items from the magazine to the shared lists, under a
+ * single acquisition of the pool lock. Called with pcp->lock held.
+ * The pages stay accounted, so there is no vmstat update here.
+ */
+static void dmabuf_page_pool_pcp_drain(struct dmabuf_page_pool *pool,
+				       struct dmabuf_page_pool_pcp *pcp, int nr)
+{
+	struct dmabuf_page_pool_with_spinlock *container_pool =
+		to_container_pool(pool);
+	struct page *page;
+	int index;
+
+	spin_lock(&container_pool->spinlock);
+	while (nr-- && pcp->count) {
+		page = list_first_entry(&pcp->items, struct page, lru);
+		index = PageHighMem(page) ? POOL_HIGHPAGE : POOL_LOWPAGE;
+		list_move_tail(&page->lru, &pool->items[index]);
+		pool->count[index]++;
+		pcp->count--;
+	}
+	spin_unlock(&container_pool->spinlock);
+}
+
+/* The reverse of dmabuf_page_pool_pcp_drain(), high pages first */
+static void dmabuf_page_pool_pcp_fill(struct dmabuf_page_pool *pool,
+				      struct dmabuf_page_pool_pcp *pcp, int nr)
+{
+	struct dmabuf_page_pool_with_spinlock *container_pool =
+		to_container_pool(pool);
+	struct page *page;
+	int index;
+
+	spin_lock(&container_pool->spinlock);
+	for (index = POOL_HIGHPAGE; index >= POOL_LOWPAGE; index--) {
+		while (nr && pool->count[index]) {
+			page = list_first_entry(&pool->items[index],
+						struct page, lru);
+			list_move(&page->lru, &pcp->items);
+			pool->count[index]--;
+			pcp->count++;
+			nr--;
+		}
+	}
+	spin_unlock(&container_pool->spinlock);
+}
+
+static struct page *dmabuf_page_pool_pcp_fetch(struct dmabuf_page_pool *pool)
+{
+	struct dmabuf_page_pool_with_spinlock *container_pool =
+		to_container_pool(pool);
+	struct dmabuf_page_pool_pcp *pcp = raw_cpu_ptr(container_pool->pcp);
+	struct page *page = NULL;
+
+	spin_lock(&pcp->lock);
+	if (!pcp->count)
+		dmabuf_page_pool_pcp_fill(pool, pcp,
+					  max(container_pool->pcp_size / 2, 1));
+	if (pcp->count) {
+		page = list_first_entry(&pcp->items, struct page, lru);
+		list_del(&page->lru);
+		pcp->count--;
+		dmabuf_page_pool_pcp_account(pool, pcp, page, -1);
+	}
+	spin_unlock(&pcp->lock);
+
+	return page;
+}
+
+static void dmabuf_page_pool_pcp_add(struct dmabuf_page_pool *pool,
+				     struct page *page)
+{
+	struct dmabuf_page_pool_with_spinlock *container_pool =
+		to_container_pool(pool);
+	struct dmabuf_page_pool_pcp *pcp = raw_cpu_ptr(container_pool->pcp);
+
+	spin_lock(&pcp->lock);
+	if (pcp->count >= container_pool->pcp_size)
+		dmabuf_page_pool_pcp_drain(pool, pcp,
+					   max(container_pool->pcp_size / 2, 1));
+	list_add(&page->lru, &pcp->items);
+	pcp->count++;
+	dmabuf_page_pool_pcp_account(pool, pcp, page, 1);
+	spin_unlock(&pcp->lock);
+}
+
+/* Push every magazine back to the shared lists, e.g. for the shrinker */
+static void dmabuf_page_pool_pcp_drain_all(struct dmabuf_page_pool *pool)
+{
+	struct dmabuf_page_pool_with_spinlock *container_pool =
+		to_container_pool(pool);
+	struct dmabuf_page_pool_pcp *pcp;
+	int cpu;
+
+	if (!container_pool->pcp)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		pcp = per_cpu_ptr(container_pool->pcp, cpu);
+		spin_lock(&pcp->lock);
+		dmabuf_page_pool_pcp_drain(pool, pcp, pcp->count);
+		dmabuf_page_pool_pcp_flush_vm(pcp);
+		spin_unlock(&pcp->lock);
+	}
+}
+
+static int dmabuf_page_pool_pcp_items(struct dmabuf_page_pool *pool)
+{
+	struct dmabuf_page_pool_with_spinlock *container_pool =
+		to_container_pool(pool);
+	int cpu, count = 0;
+
+	if (!container_pool->pcp)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		count += READ_ONCE(per_cpu_ptr(container_pool->pcp, cpu)->count);
+
+	return count;
+}
+
 static struct page *dmabuf_page_pool_fetch(struct dmabuf_page_pool *pool)
 {
 	struct page *page = NULL;
 
+	if (to_container_pool(pool)->pcp)
+		return dmabuf_page_pool_pcp_fetch(pool);
+
 	page = dmabuf_page_pool_remove(pool, POOL_HIGHPAGE);
 	if (!page)
 		page = dmabuf_page_pool_remove(pool, POOL_LOWPAGE);
@@ -90,15 +303,79 @@ static struct page *dmabuf_page_pool_fetch(struct dmabuf_page_pool *pool)
 	return page;
 }
 
+static inline int dmabuf_page_pool_items(struct dmabuf_page_pool *pool)
+{
+	return READ_ONCE(pool->count[POOL_LOWPAGE]) +
+	       READ_ONCE(pool->count[POOL_HIGHPAGE]) +
+	       dmabuf_page_pool_pcp_items(pool);
+}
+
+static inline bool dmabuf_page_pool_full(unsigned int order)
+{
+	unsigned long max_pages = READ_ONCE(pool_max_pages);
+
+	return max_pages &&
+	       atomic_long_read(&pool_pages) + (1 << order) > max_pages;
+}
+
+static void dmabuf_page_pool_refill_worker(struct work_struct *work)
+{
+	struct dmabuf_page_pool_with_spinlock *container_pool;
+	struct dmabuf_page_pool *pool;
+	struct page *page;
+
+	mutex_lock(&pool_list_lock);
+	list_for_each_entry(pool, &pool_list, list) {
+		container_pool = to_container_pool(pool);
+
+		while (dmabuf_page_pool_items(pool) <
+		       READ_ONCE(container_pool->high_watermark)) {
+			if (time_before(jiffies, READ_ONCE(pool_shrink_jiffies) +
+					POOL_REFILL_BACKOFF))
+				goto out;
+			if (dmabuf_page_pool_full(pool->order))
+				goto out;
+
+			/*
+			 * No direct reclaim: we hold pool_list_lock, which the
+			 * shrinker takes, and a refill is only worth doing when
+			 * memory is readily available anyway.
+			 */
+			page = alloc_pages((pool->gfp_mask | __GFP_NOWARN) &
+					   ~__GFP_DIRECT_RECLAIM, pool->order);
+			if (!page)
+				break;
+
+			dmabuf_page_pool_add(pool, page);
+			atomic_long_inc(&container_pool->refill);
+		}
+	}
+out:
+	mutex_unlock(&pool_list_lock);
+}
+
 struct page *dmabuf_page_pool_alloc(struct dmabuf_page_pool *pool)
 {
+	struct dmabuf_page_pool_with_spinlock *container_pool;
 	struct page *page = NULL;
+	unsigned int low_watermark;
 
 	if (WARN_ON(!pool))
 		return NULL;
 
+	container_pool = to_container_pool(pool);
+
 	page = dmabuf_page_pool_fetch(pool);
 
+	if (page)
+		atomic_long_inc(&container_pool->hit);
+	else
+		atomic_long_inc(&container_pool->miss);
+
+	low_watermark = READ_ONCE(container_pool->low_watermark);
+	if (low_watermark && dmabuf_page_pool_items(pool) < low_watermark)
+		queue_work(system_unbound_wq, &pool_refill_work);
+
 	if (!page)
 		page = dmabuf_page_pool_alloc_pages(pool);
 	return page;
@@ -110,10 +387,193 @@ void dmabuf_page_pool_free(struct dmabuf_page_pool *pool, struct page *page)
 	if (WARN_ON(pool->order != compound_order(page)))
 		return;
 
-	dmabuf_page_pool_add(pool, page);
+	/* Over the cap, give the page back to the system right away */
+	if (dmabuf_page_pool_full(pool->order)) {
+		atomic_long_inc(&to_container_pool(pool)->overflow);
+		dmabuf_page_pool_free_pages(pool, page);
+		return;
+	}
+
+	if (to_container_pool(pool)->pcp)
+		dmabuf_page_pool_pcp_add(pool, page);
+	else
+		dmabuf_page_pool_add(pool, page);
 }
 EXPORT_SYMBOL_GPL(dmabuf_page_pool_free);
 
+struct pool_attribute {
+	struct attribute attr;
+	ssize_t (*show)(struct dmabuf_page_pool_with_spinlock *container_pool,
+			char *buf);
+	ssize_t (*store)(struct dmabuf_page_pool_with_spinlock *container_pool,
+			 const char *buf, size_t count);
+};
+
+#define to_pool_attr(x) container_of(x, struct pool_attribute, attr)
+
+static ssize_t pool_attr_show(struct kobject *kobj, struct attribute *attr,
+			      char *buf)
+{
+	struct pool_attribute *attribute = to_pool_attr(attr);
+	struct dmabuf_page_pool_with_spinlock *container_pool =
+		container_of(kobj, struct dmabuf_page_pool_with_spinlock, kobj);
+
+	if (!attribute->show)
+		return -EIO;
+
+	return attribute->show(container_pool, buf);
+}
+
+static ssize_t pool_attr_store(struct kobject *kobj, struct attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct pool_attribute *attribute = to_pool_attr(attr);
+	struct dmabuf_page_pool_with_spinlock *container_pool =
+		container_of(kobj, struct dmabuf_page_pool_with_spinlock, kobj);
+
+	if (!attribute->store)
+		return -EIO;
+
+	return attribute->store(container_pool, buf, count);
+}
+
+static const struct sysfs_ops pool_sysfs_ops = {
+	.show = pool_attr_show,
+	.store = pool_attr_store,
+};
+
+static ssize_t order_show(struct dmabuf_page_pool_with_spinlock *container_pool,
+			  char *buf)
+{
+	return sysfs_emit(buf, "%u\n", container_pool->pool.order);
+}
+
+static ssize_t dma32_show(struct dmabuf_page_pool_with_spinlock *container_pool,
+			  char *buf)
+{
+	return sysfs_emit(buf, "%d\n",
+			  !!(container_pool->pool.gfp_mask & GFP_DMA32));
+}
+
+static ssize_t count_show(struct dmabuf_page_pool_with_spinlock *container_pool,
+			  char *buf)
+{
+	return sysfs_emit(buf, "%d\n",
+			  dmabuf_page_pool_items(&container_pool->pool));
+}
+
+#define POOL_STAT_ATTR(_name)						\
+static ssize_t _name##_show(						\
+	struct dmabuf_page_pool_with_spinlock *container_pool, char *buf)\
+{									\
+	return sysfs_emit(buf, "%ld\n",					\
+			  atomic_long_read(&container_pool->_name));	\
+}									\
+static struct pool_attribute _name##_attribute = __ATTR_RO(_name)
+
+POOL_STAT_ATTR(hit);
+POOL_STAT_ATTR(miss);
+POOL_STAT_ATTR(refill);
+POOL_STAT_ATTR(overflow);
+
+#define POOL_WATERMARK_ATTR(_name)					\
+static ssize_t _name##_show(						\
+	struct dmabuf_page_pool_with_spinlock *container_pool, char *buf)\
+{									\
+	return sysfs_emit(buf, "%u\n", READ_ONCE(container_pool->_name));\
+}									\
+static ssize_t _name##_store(						\
+	struct dmabuf_page_pool_with_spinlock *container_pool,		\
+	const char *buf, size_t count)					\
+{									\
+	unsigned int val;						\
+	int ret;							\
+									\
+	ret = kstrtouint(buf, 10, &val);				\
+	if (ret)							\
+		return ret;						\
+	WRITE_ONCE(container_pool->_name, val);				\
+	queue_work(system_unbound_wq, &pool_refill_work);		\
+	return count;							\
+}									\
+static struct pool_attribute _name##_attribute = __ATTR_RW(_name)
+
+POOL_WATERMARK_ATTR(low_watermark);
+POOL_WATERMARK_ATTR(high_watermark);
+
+static struct pool_attribute order_attribute = __ATTR_RO(order);
+static struct pool_attribute dma32_attribute = __ATTR_RO(dma32);
+static struct pool_attribute count_attribute = __ATTR_RO(count);
+
+static struct attribute *pool_default_attrs[] = {
+	&order_attribute.attr,
+	&dma32_attribute.attr,
+	&count_attribute.attr,
+	&hit_attribute.attr,
+	&miss_attribute.attr,
+	&refill_attribute.attr,
+	&overflow_attribute.attr,
+	&low_watermark_attribute.attr,
+	&high_watermark_attribute.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(pool_default);
+
+static void pool_kobj_release(struct kobject *kobj)
+{
+	struct dmabuf_page_pool_with_spinlock *container_pool =
+		container_of(kobj, struct dmabuf_page_pool_with_spinlock, kobj);
+
+	kfree(container_pool);
+}
+
+static struct kobj_type pool_ktype = {
+	.sysfs_ops = &pool_sysfs_ops,
+	.release = pool_kobj_release,
+	.default_groups = pool_default_groups,
+};
+
+static ssize_t max_pages_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%lu\n", READ_ONCE(pool_max_pages));
+}
+
+static ssize_t max_pages_store(struct kobject *kobj,
+			       struct kobj_attribute *attr, const char *buf,
+			       size_t count)
+{
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(pool_max_pages, val);
+
+	return count;
+}
+
+static ssize_t total_pages_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%ld\n", atomic_long_read(&pool_pages));
+}
+
+static struct kobj_attribute max_pages_attribute = __ATTR_RW(max_pages);
+static struct kobj_attribute total_pages_attribute = __ATTR_RO(total_pages);
+
+static struct attribute *pool_root_attrs[] = {
+	&max_pages_attribute.attr,
+	&total_pages_attribute.attr,
+	NULL,
+};
+
+static const struct attribute_group pool_root_group = {
+	.attrs = pool_root_attrs,
+};
+
 static int dmabuf_page_pool_total(struct dmabuf_page_pool *pool, bool high)
 {
 	int count = pool->count[POOL_LOWPAGE];
@@ -128,13 +588,29 @@ struct dmabuf_page_pool *dmabuf_page_pool_create(gfp_t gfp_mask, unsigned int or
 {
 	struct dmabuf_page_pool *pool;
 	struct dmabuf_page_pool_with_spinlock *container_pool =
-		kmalloc(sizeof(*container_pool), GFP_KERNEL);
-	int i;
+		kzalloc(sizeof(*container_pool), GFP_KERNEL);
+	struct dmabuf_page_pool_pcp *pcp;
+	int i, cpu;
 
 	if (!container_pool)
 		return NULL;
 
+	container_pool->pcp_size = POOL_PCP_PAGES >> order;
+	if (container_pool->pcp_size > 1) {
+		container_pool->pcp = alloc_percpu(struct dmabuf_page_pool_pcp);
+		if (!container_pool->pcp) {
+			kfree(container_pool);
+			return NULL;
+		}
+		for_each_possible_cpu(cpu) {
+			pcp = per_cpu_ptr(container_pool->pcp, cpu);
+			spin_lock_init(&pcp->lock);
+			INIT_LIST_HEAD(&pcp->items);
+		}
+	}
+
 	spin_lock_init(&container_pool->spinlock);
+	kobject_init(&container_pool->kobj, &pool_ktype);
 	pool = &container_pool->pool;
 
 	for (i = 0; i < POOL_TYPE_SIZE; i++) {
@@ -150,6 +626,12 @@ struct dmabuf_page_pool *dmabuf_page_pool_create(gfp_t gfp_mask, unsigned int or
 	list_add(&pool->list, &pool_list);
 	mutex_unlock(&pool_list_lock);
 
+	if (pool_kobj &&
+	    kobject_add(&container_pool->kobj, pool_kobj, "pool%d",
+			atomic_inc_return(&pool_id) - 1))
+		pr_warn("%s: failed to add sysfs for order %u pool\n",
+			__func__, order);
+
 	return pool;
 }
 EXPORT_SYMBOL_GPL(dmabuf_page_pool_create);
@@ -166,13 +648,15 @@ void dmabuf_page_pool_destroy(struct dmabuf_page_pool *pool)
 	mutex_unlock(&pool_list_lock);
 
 	/* Free any remaining pages in the pool */
+	dmabuf_page_pool_pcp_drain_all(pool);
 	for (i = 0; i < POOL_TYPE_SIZE; i++) {
 		while ((page = dmabuf_page_pool_remove(pool, i)))
 			dmabuf_page_pool_free_pages(pool, page);
 	}
 
 	container_pool = container_of(pool, struct dmabuf_page_pool_with_spinlock, pool);
-	kfree(container_pool);
+	free_percpu(container_pool->pcp);
+	kobject_put(&container_pool->kobj);
 }
 EXPORT_SYMBOL_GPL(dmabuf_page_pool_destroy);
 
@@ -188,7 +672,12 @@ static int dmabuf_page_pool_do_shrink(struct dmabuf_page_pool *pool, gfp_t gfp_m
 		high = !!(gfp_mask & __GFP_HIGHMEM);
 
 	if (nr_to_scan == 0)
-		return dmabuf_page_pool_total(pool, high);
+		return dmabuf_page_pool_total(pool, high) +
+		       (dmabuf_page_pool_pcp_items(pool) << pool->order);
+
+	/* Memory pressure, hold off the background refill */
+	WRITE_ONCE(pool_shrink_jiffies, jiffies);
+	dmabuf_page_pool_pcp_drain_all(pool);
 
 	while (freed < nr_to_scan) {
 		struct page *page;
@@ -262,6 +751,15 @@ struct shrinker pool_shrinker = {
 
 static int dmabuf_page_pool_init_shrinker(void)
 {
+	/* Never let the pools hold more than 1/8 of the memory by default */
+	pool_max_pages = totalram_pages() >> 3;
+
+	pool_kobj = kobject_create_and_add("dmabuf_page_pool", kernel_kobj);
+	if (pool_kobj && sysfs_create_group(pool_kobj, &pool_root_group)) {
+		kobject_put(pool_kobj);
+		pool_kobj = NULL;
+	}
+
 	return register_shrinker(&pool_shrinker);
 }
 module_init(dmabuf_page_pool_init_shrinker);
@@ -36,12 +36,19 @@ static struct dma_heap *sys_uncached_dma32_heap;
 static u32 bank_bit_first = 12;
 static u32 bank_bit_mask = 0x7;
 
+/* Start offset of each sg entry, to find a partial sync range quickly */
+struct system_heap_sg_index {
+	unsigned int offset;
+	struct scatterlist *sg;
+};
+
 struct system_heap_buffer {
 	struct dma_heap *heap;
 	struct list_head attachments;
 	struct mutex lock;
 	unsigned long len;
 	struct sg_table sg_table;
+	struct system_heap_sg_index *sg_index;
 	int vmap_cnt;
 	void *vaddr;
 	struct deferred_freelist_item deferred_free;
@@ -223,45 +230,113 @@ static int system_heap_dma_buf_end_cpu_access(struct dma_buf *dmabuf,
 	return 0;
 }
 
+static void system_heap_sync_single(struct device *dev, phys_addr_t phys,
+				   size_t size, enum dma_data_direction dir,
+				   bool for_cpu)
+{
+	if (for_cpu)
+		dma_sync_single_for_cpu(dev, phys, size, dir);
+	else
+		dma_sync_single_for_device(dev, phys, size, dir);
+}
+
+/*
+ * Find the sg entry holding @offset. The index is built on first use
+ * with the buffer lock held; without it we fall back to a linear walk.
+ */
+static struct scatterlist *system_heap_sg_find(struct system_heap_buffer *buffer,
+					       unsigned int offset,
+					       unsigned int *sg_start)
+{
+	struct sg_table *sgt = &buffer->sg_table;
+	struct system_heap_sg_index *index = buffer->sg_index;
+	struct scatterlist *sg;
+	unsigned int len = 0;
+	int lo, hi, mid, i;
+
+	if (!index) {
+		index = kvmalloc_array(sgt->orig_nents, sizeof(*index),
+				       GFP_KERNEL);
+		if (index) {
+			for_each_sgtable_sg(sgt, sg, i) {
+				index[i].offset = len;
+				index[i].sg = sg;
+				len += sg->length;
+			}
+			buffer->sg_index = index;
+		}
+	}
+
+	if (!index) {
+		for_each_sgtable_sg(sgt, sg, i) {
+			if (offset < len + sg->length) {
+				*sg_start = len;
+				return sg;
+			}
+			len += sg->length;
+		}
+		return NULL;
+	}
+
+	lo = 0;
+	hi = sgt->orig_nents - 1;
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (index[mid].offset <= offset)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	*sg_start = index[lo].offset;
+
+	return index[lo].sg;
+}
+
+/*
+ * Sync [offset, offset + length) only. Physically contiguous entries,
+ * which are common since pages come from the high order pools first,
+ * are merged so that each contiguous run costs one cache operation.
+ */
 static int system_heap_sgl_sync_range(struct device *dev,
-				      struct sg_table *sgt,
+				      struct system_heap_buffer *buffer,
 				      unsigned int offset,
 				      unsigned int length,
 				      enum dma_data_direction dir,
 				      bool for_cpu)
 {
 	struct scatterlist *sg;
-	unsigned int len = 0;
-	dma_addr_t sg_dma_addr;
-	int i;
-
-	for_each_sgtable_sg(sgt, sg, i) {
-		unsigned int sg_offset, sg_left, size = 0;
+	phys_addr_t run_phys = 0, phys;
+	size_t run_len = 0;
+	unsigned int sg_start, sg_offset, size;
 
-		sg_dma_addr = sg_phys(sg);
+	if (!length)
+		return 0;
 
-		len += sg->length;
-		if (len <= offset)
-			continue;
+	sg = system_heap_sg_find(buffer, offset, &sg_start);
+	if (!sg)
+		return -EINVAL;
 
-		sg_left = len - offset;
-		sg_offset = sg->length - sg_left;
+	sg_offset = offset - sg_start;
+	for (; sg && length; sg = sg_next(sg), sg_offset = 0) {
+		size = min(length, sg->length - sg_offset);
+		phys = sg_phys(sg) + sg_offset;
 
-		size = (length < sg_left) ? length : sg_left;
-		if (for_cpu)
-			dma_sync_single_range_for_cpu(dev, sg_dma_addr,
-						      sg_offset, size, dir);
-		else
-			dma_sync_single_range_for_device(dev, sg_dma_addr,
-							 sg_offset, size, dir);
+		if (run_len && run_phys + run_len == phys) {
+			run_len += size;
+		} else {
+			if (run_len)
+				system_heap_sync_single(dev, run_phys, run_len,
+							dir, for_cpu);
+			run_phys = phys;
+			run_len = size;
+		}
 
-		offset += size;
 		length -= size;
-
-		if (length == 0)
-			break;
 	}
 
+	if (run_len)
+		system_heap_sync_single(dev, run_phys, run_len, dir, for_cpu);
+
 	return 0;
 }
 
@@ -273,22 +348,25 @@ system_heap_dma_buf_begin_cpu_access_partial(struct dma_buf *dmabuf,
 {
 	struct system_heap_buffer *buffer = dmabuf->priv;
 	struct dma_heap *heap = buffer->heap;
-	struct sg_table *table = &buffer->sg_table;
 	int ret;
 
 	if (direction == DMA_TO_DEVICE)
 		return 0;
 
+	if (offset >= buffer->len)
+		return -EINVAL;
+	len = min_t(unsigned long, len, buffer->len - offset);
+
 	mutex_lock(&buffer->lock);
 	if (buffer->vmap_cnt)
-		invalidate_kernel_vmap_range(buffer->vaddr, buffer->len);
+		invalidate_kernel_vmap_range(buffer->vaddr + offset, len);
 
 	if (buffer->uncached) {
 		mutex_unlock(&buffer->lock);
 		return 0;
 	}
 
-	ret = system_heap_sgl_sync_range(dma_heap_get_dev(heap), table,
+	ret = system_heap_sgl_sync_range(dma_heap_get_dev(heap), buffer,
 					 offset, len, direction, true);
 	mutex_unlock(&buffer->lock);
 
@@ -303,19 +381,22 @@ system_heap_dma_buf_end_cpu_access_partial(struct dma_buf *dmabuf,
 {
 	struct system_heap_buffer *buffer = dmabuf->priv;
 	struct dma_heap *heap = buffer->heap;
-	struct sg_table *table = &buffer->sg_table;
 	int ret;
 
+	if (offset >= buffer->len)
+		return -EINVAL;
+	len = min_t(unsigned long, len, buffer->len - offset);
+
 	mutex_lock(&buffer->lock);
 	if (buffer->vmap_cnt)
-		flush_kernel_vmap_range(buffer->vaddr, buffer->len);
+		flush_kernel_vmap_range(buffer->vaddr + offset, len);
 
 	if (buffer->uncached) {
 		mutex_unlock(&buffer->lock);
 		return 0;
 	}
 
-	ret = system_heap_sgl_sync_range(dma_heap_get_dev(heap), table,
+	ret = system_heap_sgl_sync_range(dma_heap_get_dev(heap), buffer,
 					 offset, len, direction, false);
 	mutex_unlock(&buffer->lock);
 
@@ -416,16 +497,29 @@ static void system_heap_vunmap(struct dma_buf *dmabuf, void *vaddr)
 static int system_heap_zero_buffer(struct system_heap_buffer *buffer)
 {
 	struct sg_table *sgt = &buffer->sg_table;
-	struct sg_page_iter piter;
+	struct scatterlist *sg;
 	struct page *p;
 	void *vaddr;
-	int ret = 0;
+	int i, j, ret = 0;
 
-	for_each_sgtable_page(sgt, &piter, 0) {
-		p = sg_page_iter_page(&piter);
-		vaddr = kmap_atomic(p);
-		memset(vaddr, 0, PAGE_SIZE);
-		kunmap_atomic(vaddr);
+	/*
+	 * Runs from the deferred free thread. Lowmem entries are cleared
+	 * through the linear map in one go, only highmem needs per page
+	 * kmaps.
+	 */
+	for_each_sgtable_sg(sgt, sg, i) {
+		cond_resched();
+		p = sg_page(sg);
+		if (!PageHighMem(p)) {
+			memset(page_address(p), 0, sg->length);
+			continue;
+		}
+
+		for (j = 0; j < sg->length >> PAGE_SHIFT; j++) {
+			vaddr = kmap_atomic(nth_page(p, j));
+			memset(vaddr, 0, PAGE_SIZE);
+			kunmap_atomic(vaddr);
+		}
 	}
 
 	return ret;
@@ -460,6 +554,7 @@ static void system_heap_buf_free(struct deferred_freelist_item *item,
 		}
 	}
 	sg_free_table(table);
+	kvfree(buffer->sg_index);
 	kfree(buffer);
 }
 
@@ -25,13 +25,22 @@
 static u32 bank_bit_first = 12;
 static u32 bank_bit_mask = 0x7;
 
-struct page_info {
-	struct page *page;
-	struct list_head list;
-};
-
 #define PG_ROUND       8
 
+/*
+ * Page order of shmem backed buffers:
+ * 0: as returned by shmem
+ * 1: chunks of at least bank_chunk_pages contiguous pages first, the pages
+ *    of shorter chunks spread round robin over the DDR banks
+ */
+static unsigned int bank_order = 1;
+module_param(bank_order, uint, 0644);
+MODULE_PARM_DESC(bank_order, "0: shmem page order, 1: interleave short chunks over DDR banks");
+
+static unsigned int bank_chunk_pages = PG_ROUND;
+module_param(bank_chunk_pages, uint, 0644);
+MODULE_PARM_DESC(bank_chunk_pages, "chunks of at least this many pages are kept contiguous");
+
 static int rockchip_gem_iommu_map(struct rockchip_gem_object *rk_obj)
 {
 	struct drm_device *drm = rk_obj->base.dev;
@@ -91,19 +100,6 @@ static int rockchip_gem_iommu_unmap(struct rockchip_gem_object *rk_obj)
 	return 0;
 }
 
-static void rockchip_gem_free_list(struct list_head lists[])
-{
-	struct page_info *info, *tmp_info;
-	int i;
-
-	for (i = 0; i < PG_ROUND; i++) {
-		list_for_each_entry_safe(info, tmp_info, &lists[i], list) {
-			list_del(&info->list);
-			kfree(info);
-		}
-	}
-}
-
 void rockchip_gem_get_ddr_info(void)
 {
 	struct dram_addrmap_info *ddr_map_info;
@@ -115,27 +111,72 @@ void rockchip_gem_get_ddr_info(void)
 	}
 }
 
+static inline unsigned int rockchip_gem_page_bank(struct page *page)
+{
+	return ((page_to_phys(page) >> bank_bit_first) & bank_bit_mask) % PG_ROUND;
+}
+
+/*
+ * Fill @dst with @pages: chunks of at least @chunk_min contiguous pages
+ * first and unchanged, then the pages of shorter chunks round robin over
+ * the DDR banks.
+ *
+ * Nothing is allocated. The short chunk pages are compacted to the front of
+ * @pages, and as the round robin order only depends on the number of pages
+ * per bank, the k-th page of each bank is stored straight into its slot.
+ */
+static void rockchip_gem_order_pages(struct page **dst, struct page **pages,
+				     unsigned int n_pages,
+				     unsigned int chunk_min)
+{
+	unsigned int count[PG_ROUND] = {0};
+	unsigned int seen[PG_ROUND] = {0};
+	unsigned int i, j, k, b, c, pos;
+	unsigned int end = 0, n_short = 0;
+
+	for (i = 0; i < n_pages; i = j) {
+		/* look for the end of the current chunk */
+		for (j = i + 1; j < n_pages; j++) {
+			if (page_to_pfn(pages[j]) !=
+			    page_to_pfn(pages[j - 1]) + 1)
+				break;
+		}
+
+		if (j - i >= chunk_min) {
+			memcpy(&dst[end], &pages[i], (j - i) * sizeof(*pages));
+			end += j - i;
+			continue;
+		}
+
+		for (k = i; k < j; k++) {
+			count[rockchip_gem_page_bank(pages[k])]++;
+			pages[n_short++] = pages[k];
+		}
+	}
+
+	for (i = 0; i < n_short; i++) {
+		b = rockchip_gem_page_bank(pages[i]);
+		k = seen[b]++;
+
+		/* k complete rounds, then the banks before b still in round k */
+		pos = end;
+		for (c = 0; c < PG_ROUND; c++)
+			pos += min(count[c], k) + (c < b && count[c] > k);
+
+		dst[pos] = pages[i];
+	}
+
+	DRM_DEBUG_KMS("%u pages, %u in long chunks\n", n_pages, end);
+}
+
 static int rockchip_gem_get_pages(struct rockchip_gem_object *rk_obj)
 {
 	struct drm_device *drm = rk_obj->base.dev;
 	int ret, i;
 	struct scatterlist *s;
-	unsigned int cur_page;
 	struct page **pages, **dst_pages;
-	int j;
-	int n_pages;
-	unsigned long chunk_pages;
-	unsigned long remain;
-	struct list_head lists[PG_ROUND];
-	dma_addr_t phys;
-	int end = 0;
-	unsigned int bit_index;
-	unsigned int block_index[PG_ROUND] = {0};
-	struct page_info *info;
-	unsigned int maximum;
-
-	for (i = 0; i < PG_ROUND; i++)
-		INIT_LIST_HEAD(&lists[i]);
+	unsigned int chunk_min;
+	ktime_t start;
 
 	pages = drm_gem_get_pages(&rk_obj->base);
 	if (IS_ERR(pages))
@@ -145,9 +186,7 @@ static int rockchip_gem_get_pages(struct rockchip_gem_object *rk_obj)
 
 	rk_obj->num_pages = rk_obj->base.size >> PAGE_SHIFT;
 
-	n_pages = rk_obj->num_pages;
-
-	dst_pages = __vmalloc(sizeof(struct page *) * n_pages,
+	dst_pages = __vmalloc(sizeof(struct page *) * rk_obj->num_pages,
 			GFP_KERNEL | __GFP_HIGHMEM);
 	if (!dst_pages) {
 		ret = -ENOMEM;
@@ -157,67 +196,21 @@ static int rockchip_gem_get_pages(struct rockchip_gem_object *rk_obj)
 	DRM_DEBUG_KMS("bank_bit_first = 0x%x, bank_bit_mask = 0x%x\n",
 		      bank_bit_first, bank_bit_mask);
 
-	cur_page = 0;
-	remain = n_pages;
-	/* look for the end of the current chunk */
-	while (remain) {
-		for (j = cur_page + 1; j < n_pages; ++j) {
-			if (page_to_pfn(pages[j]) !=
-				page_to_pfn(pages[j - 1]) + 1)
-				break;
-		}
-
-		chunk_pages = j - cur_page;
-		if (chunk_pages >= PG_ROUND) {
-			for (i = 0; i < chunk_pages; i++)
-				dst_pages[end + i] = pages[cur_page + i];
-			end += chunk_pages;
-		} else {
-			for (i = 0; i < chunk_pages; i++) {
-				info = kmalloc(sizeof(*info), GFP_KERNEL);
-				if (!info) {
-					ret = -ENOMEM;
-					goto err_put_list;
-				}
-
-				INIT_LIST_HEAD(&info->list);
-				info->page = pages[cur_page + i];
-				phys = page_to_phys(info->page);
-				bit_index = ((phys >> bank_bit_first) & bank_bit_mask) % PG_ROUND;
-				list_add_tail(&info->list, &lists[bit_index]);
-				block_index[bit_index]++;
-			}
-		}
-
-		cur_page = j;
-		remain -= chunk_pages;
-	}
-
-	maximum = block_index[0];
-	for (i = 1; i < PG_ROUND; i++)
-		maximum = max(maximum, block_index[i]);
+	/* Every chunk is long enough with a minimum of one page */
+	chunk_min = 1;
+	if (READ_ONCE(bank_order))
+		chunk_min = max(READ_ONCE(bank_chunk_pages), 1U);
 
-	for (i = 0; i < maximum; i++) {
-		for (j = 0; j < PG_ROUND; j++) {
-			if (!list_empty(&lists[j])) {
-				struct page_info *info;
+	start = ktime_get();
+	rockchip_gem_order_pages(dst_pages, pages, rk_obj->num_pages, chunk_min);
+	DRM_DEBUG_KMS("ordered %lu pages in %lld us\n", rk_obj->num_pages,
+		      ktime_us_delta(ktime_get(), start));
 
-				info = list_first_entry(&lists[j],
-							struct page_info, list);
-				dst_pages[end++] = info->page;
-				list_del(&info->list);
-				kfree(info);
-			}
-		}
-	}
-
-	DRM_DEBUG_KMS("%s, %d, end = %d, n_pages = %d\n", __func__, __LINE__,
-			end, n_pages);
 	rk_obj->sgt = drm_prime_pages_to_sg(rk_obj->base.dev,
 					    dst_pages, rk_obj->num_pages);
 	if (IS_ERR(rk_obj->sgt)) {
 		ret = PTR_ERR(rk_obj->sgt);
-		goto err_put_list;
+		goto err_free_dst;
 	}
 
 	rk_obj->pages = dst_pages;
@@ -238,9 +231,10 @@ static int rockchip_gem_get_pages(struct rockchip_gem_object *rk_obj)
 
 	return 0;
 
-err_put_list:
-	rockchip_gem_free_list(lists);
-	kvfree(dst_pages);
+err_free_dst:
+	/* The short chunk pages were compacted, hand back the full set */
+	rk_obj->pages = dst_pages;
+	kvfree(pages);
 err_put_pages:
 	drm_gem_put_pages(&rk_obj->base, rk_obj->pages, false, false);
 	return ret;
@@ -6,7 +6,13 @@
 
 #include <linux/module.h>
 #include <linux/component.h>
+#include <linux/crc32.h>
+#include <linux/debugfs.h>
 #include <linux/platform_device.h>
+#include <linux/workqueue.h>
+#include <drm/drm_atomic.h>
+#include <drm/drm_blend.h>
+#include <drm/drm_fourcc.h>
 #include <drm/drm_gem.h>
 #include <drm/drm_atomic_helper.h>
 #include <drm/drm_crtc_helper.h>
@@ -14,6 +20,9 @@
 #include <drm/drm_plane_helper.h>
 #include <drm/drm_probe_helper.h>
 #include <drm/drm_vblank.h>
+#include <drm/drm_writeback.h>
+
+#include "rockchip_drm_gem.h"
 
 #define DRIVER_NAME	"virtual-vop"
 
@@ -26,6 +35,43 @@
 #define XRES_MAX  8192
 #define YRES_MAX  8192
 
+#define VVOP_NUM_OVERLAYS	2
+#define VVOP_MAX_PLANES		(1 + VVOP_NUM_OVERLAYS)
+
+#define VVOP_MIN_SCALE		(DRM_PLANE_HELPER_NO_SCALING / 8)
+#define VVOP_MAX_SCALE		(DRM_PLANE_HELPER_NO_SCALING * 8)
+
+struct vvop_plane_frame {
+	struct drm_framebuffer *fb;
+	struct drm_rect src;	/* 16.16 fixed point */
+	struct drm_rect dst;
+	u16 alpha;
+	unsigned int zpos;
+};
+
+/* The planes of a commit, bottom first, as the composer sees them */
+struct vvop_frame {
+	struct kref ref;
+	ktime_t commit_time;
+	bool composed;
+	int width;
+	int height;
+	int nplanes;
+	struct vvop_plane_frame planes[VVOP_MAX_PLANES];
+};
+
+struct vvop_stats {
+	u64 composed;
+	u64 skipped;
+	u64 wb_dropped;
+	u64 total_us;
+	u32 last_us;
+	u32 max_us;
+	/* atomic flush to the end of the first composition of the commit */
+	u32 commit_last_us;
+	u32 commit_max_us;
+	u32 crc;
+};
 
 struct vvop {
 	struct device *dev;
@@ -33,41 +79,451 @@ struct vvop {
 	struct platform_device *pdev;
 	struct drm_crtc crtc;
 	struct drm_plane *plane;
+	struct drm_plane *overlays[VVOP_NUM_OVERLAYS];
 	struct drm_encoder encoder;
 	struct drm_connector connector;
+	struct drm_writeback_connector wb_connector;
 	struct hrtimer vblank_hrtimer;
 	ktime_t period_ns;
 	struct drm_pending_vblank_event *event;
 
+	struct workqueue_struct *composer_wq;
+	struct work_struct composer_work;
+	/* protects the fields below, taken from the vblank hrtimer */
+	spinlock_t composer_lock;
+	struct vvop_frame *frame;
+	bool frame_dirty;
+	bool crc_enabled;
+	u32 crc_frame;
+	struct drm_framebuffer *wb_fb;
+	unsigned int wb_queued;
+	struct vvop_stats stats;
+
+	/* composer output in XRGB8888, only used by composer_work */
+	u32 *out;
+	size_t out_size;
 };
 
 static const u32 vvop_formats[] = {
 	DRM_FORMAT_XRGB8888,
+	DRM_FORMAT_ARGB8888,
+	DRM_FORMAT_XBGR8888,
+	DRM_FORMAT_ABGR8888,
+	DRM_FORMAT_RGB888,
+	DRM_FORMAT_BGR888,
+	DRM_FORMAT_RGB565,
+	DRM_FORMAT_NV12,
+};
+
+static const u32 vvop_wb_formats[] = {
+	DRM_FORMAT_XRGB8888,
+};
+
+static const char * const vvop_crc_sources[] = {
+	"auto",
 };
 
 #define drm_crtc_to_vvop(crtc) \
 	container_of(crtc, struct vvop, crtc)
 
+/*
+ * Source of a plane for the composer, fetch() returns the pixel at (x, y)
+ * as ARGB8888.
+ */
+struct vvop_src {
+	const u8 *vaddr[2];
+	unsigned int pitch[2];
+	u32 (*fetch)(const struct vvop_src *src, int x, int y);
+};
+
+static u32 vvop_fetch_xrgb8888(const struct vvop_src *src, int x, int y)
+{
+	const u32 *p = (const u32 *)(src->vaddr[0] + y * src->pitch[0]) + x;
+
+	return *p | 0xff000000;
+}
+
+static u32 vvop_fetch_argb8888(const struct vvop_src *src, int x, int y)
+{
+	const u32 *p = (const u32 *)(src->vaddr[0] + y * src->pitch[0]) + x;
+
+	return *p;
+}
+
+static u32 vvop_fetch_xbgr8888(const struct vvop_src *src, int x, int y)
+{
+	const u32 *p = (const u32 *)(src->vaddr[0] + y * src->pitch[0]) + x;
+
+	return 0xff000000 | (*p & 0xff00) | (*p & 0xff) << 16 |
+	       (*p >> 16 & 0xff);
+}
+
+static u32 vvop_fetch_abgr8888(const struct vvop_src *src, int x, int y)
+{
+	const u32 *p = (const u32 *)(src->vaddr[0] + y * src->pitch[0]) + x;
+
+	return (*p & 0xff00ff00) | (*p & 0xff) << 16 | (*p >> 16 & 0xff);
+}
+
+static u32 vvop_fetch_rgb888(const struct vvop_src *src, int x, int y)
+{
+	const u8 *p = src->vaddr[0] + y * src->pitch[0] + x * 3;
+
+	return 0xff000000 | p[2] << 16 | p[1] << 8 | p[0];
+}
+
+static u32 vvop_fetch_bgr888(const struct vvop_src *src, int x, int y)
+{
+	const u8 *p = src->vaddr[0] + y * src->pitch[0] + x * 3;
+
+	return 0xff000000 | p[0] << 16 | p[1] << 8 | p[2];
+}
+
+static u32 vvop_fetch_rgb565(const struct vvop_src *src, int x, int y)
+{
+	const u16 *p = (const u16 *)(src->vaddr[0] + y * src->pitch[0]) + x;
+	u32 r = *p >> 11 & 0x1f;
+	u32 g = *p >> 5 & 0x3f;
+	u32 b = *p & 0x1f;
+
+	r = r << 3 | r >> 2;
+	g = g << 2 | g >> 4;
+	b = b << 3 | b >> 2;
+
+	return 0xff000000 | r << 16 | g << 8 | b;
+}
+
+/* BT.601 limited range */
+static u32 vvop_fetch_nv12(const struct vvop_src *src, int x, int y)
+{
+	const u8 *uv = src->vaddr[1] + (y / 2) * src->pitch[1] + (x & ~1);
+	int c = src->vaddr[0][y * src->pitch[0] + x] - 16;
+	int d = uv[0] - 128;
+	int e = uv[1] - 128;
+	u32 r = clamp((298 * c + 409 * e + 128) >> 8, 0, 255);
+	u32 g = clamp((298 * c - 100 * d - 208 * e + 128) >> 8, 0, 255);
+	u32 b = clamp((298 * c + 516 * d + 128) >> 8, 0, 255);
+
+	return 0xff000000 | r << 16 | g << 8 | b;
+}
+
+static u32 (*vvop_get_fetch(u32 format))(const struct vvop_src *, int, int)
+{
+	switch (format) {
+	case DRM_FORMAT_XRGB8888:
+		return vvop_fetch_xrgb8888;
+	case DRM_FORMAT_ARGB8888:
+		return vvop_fetch_argb8888;
+	case DRM_FORMAT_XBGR8888:
+		return vvop_fetch_xbgr8888;
+	case DRM_FORMAT_ABGR8888:
+		return vvop_fetch_abgr8888;
+	case DRM_FORMAT_RGB888:
+		return vvop_fetch_rgb888;
+	case DRM_FORMAT_BGR888:
+		return vvop_fetch_bgr888;
+	case DRM_FORMAT_RGB565:
+		return vvop_fetch_rgb565;
+	case DRM_FORMAT_NV12:
+		return vvop_fetch_nv12;
+	default:
+		return NULL;
+	}
+}
+
+/* Pre-multiplied alpha, as DRM planes without a blend mode property */
+static inline u32 vvop_blend(u32 src, u32 dst, u32 plane_alpha)
+{
+	u32 a = ((src >> 24) * plane_alpha + 127) / 255;
+	u32 out = 0xff000000;
+	u32 s, d;
+	int shift;
+
+	if (a == 0xff)
+		return src | 0xff000000;
+
+	for (shift = 0; shift < 24; shift += 8) {
+		s = src >> shift & 0xff;
+		d = dst >> shift & 0xff;
+		s = (s * plane_alpha + d * (255 - a) + 127) / 255;
+		out |= min(s, 0xffU) << shift;
+	}
+
+	return out;
+}
+
+/* Nearest neighbour scaling from the clipped source to the destination */
+static void vvop_blit(u32 *out, int out_width,
+		      const struct vvop_plane_frame *p,
+		      const struct vvop_src *src)
+{
+	int dst_w = drm_rect_width(&p->dst);
+	int dst_h = drm_rect_height(&p->dst);
+	u32 step_x = drm_rect_width(&p->src) / dst_w;
+	u32 step_y = drm_rect_height(&p->src) / dst_h;
+	u32 alpha = p->alpha >> 8;
+	u32 sx, sy = p->src.y1;
+	u32 *line;
+	int x, y;
+
+	for (y = 0; y < dst_h; y++, sy += step_y) {
+		line = out + (p->dst.y1 + y) * out_width + p->dst.x1;
+		sx = p->src.x1;
+		for (x = 0; x < dst_w; x++, sx += step_x)
+			line[x] = vvop_blend(src->fetch(src, sx >> 16, sy >> 16),
+					     line[x], alpha);
+	}
+}
+
+static int vvop_compose_plane(struct vvop *vvop, struct vvop_frame *frame,
+			      const struct vvop_plane_frame *p)
+{
+	struct drm_framebuffer *fb = p->fb;
+	struct vvop_src src = {};
+	void *vaddr[2] = {};
+	int i, ret = 0;
+
+	src.fetch = vvop_get_fetch(fb->format->format);
+	if (!src.fetch)
+		return -EINVAL;
+
+	for (i = 0; i < fb->format->num_planes; i++) {
+		vaddr[i] = rockchip_gem_prime_vmap(fb->obj[i]);
+		if (!vaddr[i]) {
+			ret = -ENOMEM;
+			goto out_unmap;
+		}
+		src.vaddr[i] = vaddr[i] + fb->offsets[i];
+		src.pitch[i] = fb->pitches[i];
+	}
+
+	vvop_blit(vvop->out, frame->width, p, &src);
+
+out_unmap:
+	while (i--)
+		rockchip_gem_prime_vunmap(fb->obj[i], vaddr[i]);
+
+	return ret;
+}
+
+static int vvop_compose(struct vvop *vvop, struct vvop_frame *frame)
+{
+	size_t size = frame->width * frame->height * sizeof(u32);
+	int i, ret;
+
+	if (vvop->out_size != size) {
+		kvfree(vvop->out);
+		vvop->out = kvmalloc(size, GFP_KERNEL);
+		if (!vvop->out) {
+			vvop->out_size = 0;
+			return -ENOMEM;
+		}
+		vvop->out_size = size;
+	}
+
+	memset32(vvop->out, 0xff000000, frame->width * frame->height);
+
+	for (i = 0; i < frame->nplanes; i++) {
+		ret = vvop_compose_plane(vvop, frame, &frame->planes[i]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int vvop_writeback(struct vvop *vvop, struct vvop_frame *frame,
+			  struct drm_framebuffer *fb)
+{
+	int width = min_t(int, fb->width, frame->width);
+	int height = min_t(int, fb->height, frame->height);
+	void *vaddr;
+	int y;
+
+	vaddr = rockchip_gem_prime_vmap(fb->obj[0]);
+	if (!vaddr)
+		return -ENOMEM;
+
+	for (y = 0; y < height; y++)
+		memcpy(vaddr + fb->offsets[0] + y * fb->pitches[0],
+		       vvop->out + y * frame->width, width * sizeof(u32));
+
+	rockchip_gem_prime_vunmap(fb->obj[0], vaddr);
+
+	return 0;
+}
+
+static void vvop_frame_release(struct kref *ref)
+{
+	struct vvop_frame *frame = container_of(ref, struct vvop_frame, ref);
+	int i;
+
+	for (i = 0; i < frame->nplanes; i++)
+		drm_framebuffer_put(frame->planes[i].fb);
+
+	kfree(frame);
+}
+
+static struct vvop_frame *vvop_frame_create(struct drm_crtc *crtc)
+{
+	struct drm_crtc_state *crtc_state = crtc->state;
+	struct drm_plane_state *state;
+	struct vvop_frame *frame;
+	struct drm_plane *plane;
+	int i;
+
+	frame = kzalloc(sizeof(*frame), GFP_KERNEL);
+	if (!frame)
+		return NULL;
+
+	kref_init(&frame->ref);
+	frame->commit_time = ktime_get();
+	frame->width = crtc_state->mode.hdisplay;
+	frame->height = crtc_state->mode.vdisplay;
+
+	drm_for_each_plane_mask(plane, crtc->dev, crtc_state->plane_mask) {
+		state = plane->state;
+		if (!state->visible || !state->fb ||
+		    frame->nplanes == VVOP_MAX_PLANES)
+			continue;
+
+		/* insertion sort on zpos, equal zpos keeps plane order */
+		for (i = frame->nplanes; i > 0; i--) {
+			if (frame->planes[i - 1].zpos <= state->zpos)
+				break;
+			frame->planes[i] = frame->planes[i - 1];
+		}
+
+		frame->planes[i].fb = state->fb;
+		frame->planes[i].src = state->src;
+		frame->planes[i].dst = state->dst;
+		frame->planes[i].alpha = state->alpha;
+		frame->planes[i].zpos = state->zpos;
+		drm_framebuffer_get(state->fb);
+		frame->nplanes++;
+	}
+
+	return frame;
+}
+
+static void vvop_composer_work(struct work_struct *work)
+{
+	struct vvop *vvop = container_of(work, struct vvop, composer_work);
+	struct drm_writeback_connector *wb_conn = &vvop->wb_connector;
+	struct vvop_stats *stats = &vvop->stats;
+	struct drm_framebuffer *wb_fb;
+	struct vvop_frame *frame;
+	unsigned int wb_queued;
+	bool crc_enabled;
+	ktime_t start, end;
+	u32 crc_frame, crc = 0;
+	u32 us;
+	int ret = -ENODATA;
+
+	spin_lock_irq(&vvop->composer_lock);
+	frame = vvop->frame;
+	if (frame)
+		kref_get(&frame->ref);
+	vvop->frame_dirty = false;
+	crc_enabled = vvop->crc_enabled;
+	crc_frame = vvop->crc_frame;
+	wb_fb = vvop->wb_fb;
+	wb_queued = vvop->wb_queued;
+	vvop->wb_fb = NULL;
+	vvop->wb_queued = 0;
+	stats->wb_dropped += wb_queued ? wb_queued - 1 : 0;
+	spin_unlock_irq(&vvop->composer_lock);
+
+	/* Only the last writeback queued since the previous frame is filled */
+	for (; wb_queued > 1; wb_queued--)
+		drm_writeback_signal_completion(wb_conn, -EAGAIN);
+
+	start = ktime_get();
+	if (frame)
+		ret = vvop_compose(vvop, frame);
+	if (!ret && crc_enabled)
+		crc = crc32_le(0, (u8 *)vvop->out,
+			       frame->width * frame->height * sizeof(u32));
+	if (wb_fb)
+		drm_writeback_signal_completion(wb_conn, ret ? ret :
+						vvop_writeback(vvop, frame, wb_fb));
+	end = ktime_get();
+
+	if (ret) {
+		DRM_DEBUG_KMS("vvop compose failed: %d\n", ret);
+		goto out;
+	}
+
+	if (crc_enabled)
+		drm_crtc_add_crc_entry(&vvop->crtc, true, crc_frame, &crc);
+
+	us = ktime_us_delta(end, start);
+
+	spin_lock_irq(&vvop->composer_lock);
+	stats->composed++;
+	stats->total_us += us;
+	stats->last_us = us;
+	stats->max_us = max(stats->max_us, us);
+	stats->crc = crc;
+	if (!frame->composed) {
+		us = ktime_us_delta(end, frame->commit_time);
+		stats->commit_last_us = us;
+		stats->commit_max_us = max(stats->commit_max_us, us);
+	}
+	spin_unlock_irq(&vvop->composer_lock);
+
+	frame->composed = true;
+out:
+	if (frame)
+		kref_put(&frame->ref, vvop_frame_release);
+}
+
+static void vvop_plane_destroy(struct drm_plane *plane)
+{
+	drm_plane_cleanup(plane);
+	kfree(plane);
+}
 
 static const struct drm_plane_funcs vvop_plane_funcs = {
 	.update_plane		= drm_atomic_helper_update_plane,
 	.disable_plane		= drm_atomic_helper_disable_plane,
-	.destroy		= drm_plane_cleanup,
+	.destroy		= vvop_plane_destroy,
 	.reset			= drm_atomic_helper_plane_reset,
 	.atomic_duplicate_state = drm_atomic_helper_plane_duplicate_state,
 	.atomic_destroy_state	= drm_atomic_helper_plane_destroy_state,
 };
 
+static int vvop_plane_atomic_check(struct drm_plane *plane,
+				   struct drm_plane_state *state)
+{
+	struct drm_crtc_state *crtc_state;
+
+	if (!state->fb || WARN_ON(!state->crtc))
+		return 0;
+
+	crtc_state = drm_atomic_get_crtc_state(state->state, state->crtc);
+	if (IS_ERR(crtc_state))
+		return PTR_ERR(crtc_state);
+
+	return drm_atomic_helper_check_plane_state(state, crtc_state,
+						   VVOP_MIN_SCALE,
+						   VVOP_MAX_SCALE,
+						   true, true);
+}
+
 static void vvop_plane_atomic_update(struct drm_plane *plane,
 				      struct drm_plane_state *old_state)
 {
 }
 
 static const struct drm_plane_helper_funcs vvop_plane_helper_funcs = {
+	.atomic_check		= vvop_plane_atomic_check,
 	.atomic_update		= vvop_plane_atomic_update,
 };
 
-static struct drm_plane *vvop_plane_init(struct vvop *vvop)
+static struct drm_plane *vvop_plane_init(struct vvop *vvop,
+					 enum drm_plane_type type,
+					 u32 possible_crtcs, unsigned int zpos)
 {
 	struct drm_device *dev = vvop->drm_dev;
 	struct drm_plane *plane;
@@ -81,16 +537,18 @@ static struct drm_plane *vvop_plane_init(struct vvop *vvop)
 	formats = vvop_formats;
 	nformats = ARRAY_SIZE(vvop_formats);
 
-	ret = drm_universal_plane_init(dev, plane, 0,
+	ret = drm_universal_plane_init(dev, plane, possible_crtcs,
 				       &vvop_plane_funcs,
 				       formats, nformats,
-				       NULL, DRM_PLANE_TYPE_PRIMARY, NULL);
+				       NULL, type, NULL);
 	if (ret) {
 		kfree(plane);
 		return ERR_PTR(ret);
 	}
 
 	drm_plane_helper_add(plane, &vvop_plane_helper_funcs);
+	drm_plane_create_alpha_property(plane);
+	drm_plane_create_zpos_property(plane, zpos, 0, VVOP_MAX_PLANES - 1);
 
 	return plane;
 }
@@ -105,6 +563,14 @@ static enum hrtimer_restart vvop_vblank_simulate(struct hrtimer *timer)
 	if (!ret)
 		DRM_ERROR("vvop failure on handling vblank");
 
+	spin_lock(&vvop->composer_lock);
+	if (vvop->frame_dirty || vvop->crc_enabled || vvop->wb_queued) {
+		vvop->crc_frame = drm_crtc_accurate_vblank_count(crtc);
+		if (!queue_work(vvop->composer_wq, &vvop->composer_work))
+			vvop->stats.skipped++;
+	}
+	spin_unlock(&vvop->composer_lock);
+
 	hrtimer_forward_now(&vvop->vblank_hrtimer, vvop->period_ns);
 
 	return HRTIMER_RESTART;
@@ -134,6 +600,87 @@ static void vvop_disable_vblank(struct drm_crtc *crtc)
 	hrtimer_cancel(&vvop->vblank_hrtimer);
 }
 
+static const char *const *vvop_crtc_get_crc_sources(struct drm_crtc *crtc,
+						     size_t *count)
+{
+	*count = ARRAY_SIZE(vvop_crc_sources);
+
+	return vvop_crc_sources;
+}
+
+static int vvop_crtc_verify_crc_source(struct drm_crtc *crtc,
+				       const char *source_name,
+				       size_t *values_cnt)
+{
+	if (source_name && strcmp(source_name, "auto") != 0)
+		return -EINVAL;
+
+	*values_cnt = 1;
+	return 0;
+}
+
+static int vvop_crtc_set_crc_source(struct drm_crtc *crtc,
+				    const char *source_name)
+{
+	struct vvop *vvop = drm_crtc_to_vvop(crtc);
+	bool enable = source_name != NULL;
+	unsigned long flags;
+	bool was_enabled;
+	int ret;
+
+	/* Keep the vblanks, and so the composer, running while enabled */
+	if (enable) {
+		ret = drm_crtc_vblank_get(crtc);
+		if (ret)
+			return ret;
+	}
+
+	spin_lock_irqsave(&vvop->composer_lock, flags);
+	was_enabled = vvop->crc_enabled;
+	vvop->crc_enabled = enable;
+	spin_unlock_irqrestore(&vvop->composer_lock, flags);
+
+	if (was_enabled)
+		drm_crtc_vblank_put(crtc);
+
+	return 0;
+}
+
+static int vvop_stats_show(struct seq_file *s, void *data)
+{
+	struct vvop *vvop = s->private;
+	struct vvop_stats stats;
+
+	spin_lock_irq(&vvop->composer_lock);
+	stats = vvop->stats;
+	spin_unlock_irq(&vvop->composer_lock);
+
+	seq_printf(s, "composed: %llu skipped: %llu wb_dropped: %llu\n",
+		   stats.composed, stats.skipped, stats.wb_dropped);
+	seq_printf(s, "compose_us: last %u avg %llu max %u\n",
+		   stats.last_us,
+		   stats.composed ? div64_u64(stats.total_us, stats.composed) : 0,
+		   stats.max_us);
+	seq_printf(s, "commit_us: last %u max %u\n",
+		   stats.commit_last_us, stats.commit_max_us);
+	seq_printf(s, "crc: 0x%08x\n", stats.crc);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(vvop_stats);
+
+static int vvop_crtc_late_register(struct drm_crtc *crtc)
+{
+#ifdef CONFIG_DEBUG_FS
+	struct vvop *vvop = drm_crtc_to_vvop(crtc);
+
+	debugfs_create_file("vvop_stats", 0444, crtc->debugfs_entry, vvop,
+			    &vvop_stats_fops);
+#endif
+
+	return 0;
+}
+
 static void vvop_connector_destroy(struct drm_connector *connector)
 {
 	drm_connector_unregister(connector);
@@ -166,6 +713,98 @@ static const struct drm_connector_helper_funcs vvop_conn_helper_funcs = {
 	.get_modes    = vvop_conn_get_modes,
 };
 
+static const struct drm_connector_funcs vvop_wb_connector_funcs = {
+	.fill_modes = drm_helper_probe_single_connector_modes,
+	.destroy = drm_connector_cleanup,
+	.reset = drm_atomic_helper_connector_reset,
+	.atomic_duplicate_state = drm_atomic_helper_connector_duplicate_state,
+	.atomic_destroy_state = drm_atomic_helper_connector_destroy_state,
+};
+
+static int vvop_wb_encoder_atomic_check(struct drm_encoder *encoder,
+					struct drm_crtc_state *crtc_state,
+					struct drm_connector_state *conn_state)
+{
+	struct drm_framebuffer *fb;
+
+	if (!conn_state->writeback_job || !conn_state->writeback_job->fb)
+		return 0;
+
+	fb = conn_state->writeback_job->fb;
+	if (fb->width != crtc_state->mode.hdisplay ||
+	    fb->height != crtc_state->mode.vdisplay) {
+		DRM_DEBUG_KMS("Invalid framebuffer size %ux%u\n",
+			      fb->width, fb->height);
+		return -EINVAL;
+	}
+
+	if (fb->format->format != DRM_FORMAT_XRGB8888) {
+		struct drm_format_name_buf format_name;
+
+		DRM_DEBUG_KMS("Invalid pixel format %s\n",
+			      drm_get_format_name(fb->format->format,
+						  &format_name));
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static const struct drm_encoder_helper_funcs vvop_wb_encoder_helper_funcs = {
+	.atomic_check = vvop_wb_encoder_atomic_check,
+};
+
+static const struct drm_connector_helper_funcs vvop_wb_conn_helper_funcs = {
+	.get_modes    = vvop_conn_get_modes,
+};
+
+static int vvop_wb_connector_init(struct vvop *vvop)
+{
+	int ret;
+
+	vvop->wb_connector.encoder.possible_crtcs = drm_crtc_mask(&vvop->crtc);
+	drm_connector_helper_add(&vvop->wb_connector.base,
+				 &vvop_wb_conn_helper_funcs);
+
+	ret = drm_writeback_connector_init(vvop->drm_dev, &vvop->wb_connector,
+					   &vvop_wb_connector_funcs,
+					   &vvop_wb_encoder_helper_funcs,
+					   vvop_wb_formats,
+					   ARRAY_SIZE(vvop_wb_formats));
+	if (ret)
+		DRM_ERROR("Failed to init writeback connector\n");
+
+	return ret;
+}
+
+static void vvop_wb_connector_destroy(struct vvop *vvop)
+{
+	drm_encoder_cleanup(&vvop->wb_connector.encoder);
+	drm_connector_cleanup(&vvop->wb_connector.base);
+}
+
+/* Hand the writeback job of this commit to the composer */
+static void vvop_wb_commit(struct vvop *vvop)
+{
+	struct drm_writeback_connector *wb_conn = &vvop->wb_connector;
+	struct drm_connector_state *conn_state = wb_conn->base.state;
+	struct drm_framebuffer *fb;
+	unsigned long flags;
+
+	if (!conn_state || conn_state->crtc != &vvop->crtc ||
+	    !conn_state->writeback_job || !conn_state->writeback_job->fb)
+		return;
+
+	fb = conn_state->writeback_job->fb;
+	drm_writeback_queue_job(wb_conn, conn_state);
+	conn_state->writeback_job = NULL;
+
+	spin_lock_irqsave(&vvop->composer_lock, flags);
+	vvop->wb_fb = fb;
+	vvop->wb_queued++;
+	spin_unlock_irqrestore(&vvop->composer_lock, flags);
+}
+
 static const struct drm_crtc_funcs vvop_crtc_funcs = {
 	.set_config             = drm_atomic_helper_set_config,
 	.destroy                = drm_crtc_cleanup,
@@ -175,6 +814,10 @@ static const struct drm_crtc_funcs vvop_crtc_funcs = {
 	.atomic_destroy_state   = drm_atomic_helper_crtc_destroy_state,
 	.enable_vblank		= vvop_enable_vblank,
 	.disable_vblank		= vvop_disable_vblank,
+	.late_register		= vvop_crtc_late_register,
+	.get_crc_sources	= vvop_crtc_get_crc_sources,
+	.set_crc_source		= vvop_crtc_set_crc_source,
+	.verify_crc_source	= vvop_crtc_verify_crc_source,
 };
 
 static void vvop_crtc_atomic_enable(struct drm_crtc *crtc,
@@ -186,9 +829,28 @@ static void vvop_crtc_atomic_enable(struct drm_crtc *crtc,
 static void vvop_crtc_atomic_disable(struct drm_crtc *crtc,
 				     struct drm_crtc_state *old_state)
 {
+	struct vvop *vvop = drm_crtc_to_vvop(crtc);
+	struct vvop_frame *frame;
 	unsigned long flags;
+	bool wb_pending;
 
 	drm_crtc_vblank_off(crtc);
+
+	/* Writebacks that missed the last vblank still complete */
+	spin_lock_irqsave(&vvop->composer_lock, flags);
+	wb_pending = vvop->wb_queued;
+	spin_unlock_irqrestore(&vvop->composer_lock, flags);
+	if (wb_pending)
+		queue_work(vvop->composer_wq, &vvop->composer_work);
+	flush_work(&vvop->composer_work);
+
+	spin_lock_irqsave(&vvop->composer_lock, flags);
+	frame = vvop->frame;
+	vvop->frame = NULL;
+	vvop->frame_dirty = false;
+	spin_unlock_irqrestore(&vvop->composer_lock, flags);
+	if (frame)
+		kref_put(&frame->ref, vvop_frame_release);
 	if (crtc->state->event && !crtc->state->active) {
 		spin_lock_irqsave(&crtc->dev->event_lock, flags);
 		drm_crtc_send_vblank_event(crtc, crtc->state->event);
@@ -202,8 +864,23 @@ static void vvop_crtc_atomic_disable(struct drm_crtc *crtc,
 static void vvop_crtc_atomic_flush(struct drm_crtc *crtc,
 				   struct drm_crtc_state *old_crtc_state)
 {
+	struct vvop *vvop = drm_crtc_to_vvop(crtc);
+	struct vvop_frame *frame, *old = NULL;
 	unsigned long flags;
 
+	frame = vvop_frame_create(crtc);
+	if (frame) {
+		spin_lock_irqsave(&vvop->composer_lock, flags);
+		old = vvop->frame;
+		vvop->frame = frame;
+		vvop->frame_dirty = true;
+		spin_unlock_irqrestore(&vvop->composer_lock, flags);
+	}
+	if (old)
+		kref_put(&old->ref, vvop_frame_release);
+
+	vvop_wb_commit(vvop);
+
 	if (crtc->state->event) {
 		spin_lock_irqsave(&crtc->dev->event_lock, flags);
 
@@ -247,9 +924,10 @@ static int vvop_bind(struct device *dev, struct device *master, void *data)
 	struct drm_connector *connector;
 	struct drm_encoder *encoder;
 	struct drm_plane *primary;
+	struct drm_plane *overlay;
 	struct drm_crtc *crtc;
 	struct vvop *vvop;
-	int ret;
+	int ret, i;
 
 	vvop = devm_kzalloc(dev, sizeof(*vvop), GFP_KERNEL);
 	if (!vvop)
@@ -263,15 +941,33 @@ static int vvop_bind(struct device *dev, struct device *master, void *data)
 
 	dev_set_drvdata(dev, vvop);
 
-	primary = vvop_plane_init(vvop);
-	if (IS_ERR(primary))
-		return PTR_ERR(primary);
+	spin_lock_init(&vvop->composer_lock);
+	INIT_WORK(&vvop->composer_work, vvop_composer_work);
+	vvop->composer_wq = alloc_ordered_workqueue("vvop_composer", 0);
+	if (!vvop->composer_wq)
+		return -ENOMEM;
+
+	primary = vvop_plane_init(vvop, DRM_PLANE_TYPE_PRIMARY, 0, 0);
+	if (IS_ERR(primary)) {
+		ret = PTR_ERR(primary);
+		goto err_plane;
+	}
 	vvop->plane = primary;
 
 	ret = vvop_crtc_init(drm_dev, crtc, primary, NULL);
 	if (ret)
 		goto err_crtc;
 
+	for (i = 0; i < VVOP_NUM_OVERLAYS; i++) {
+		overlay = vvop_plane_init(vvop, DRM_PLANE_TYPE_OVERLAY,
+					  drm_crtc_mask(crtc), i + 1);
+		if (IS_ERR(overlay)) {
+			ret = PTR_ERR(overlay);
+			goto err_overlay;
+		}
+		vvop->overlays[i] = overlay;
+	}
+
 	ret = drm_connector_init(drm_dev, connector, &vvop_connector_funcs,
 				 DRM_MODE_CONNECTOR_VIRTUAL);
 	if (ret) {
@@ -301,6 +997,10 @@ static int vvop_bind(struct device *dev, struct device *master, void *data)
 		goto err_attach;
 	}
 
+	ret = vvop_wb_connector_init(vvop);
+	if (ret)
+		goto err_attach;
+
 	return 0;
 
 err_attach:
@@ -313,10 +1013,16 @@ err_connector_register:
 	drm_connector_cleanup(connector);
 
 err_connector:
+err_overlay:
+	for (i = 0; i < VVOP_NUM_OVERLAYS && vvop->overlays[i]; i++)
+		vvop_plane_destroy(vvop->overlays[i]);
 	drm_crtc_cleanup(crtc);
 
 err_crtc:
-	drm_plane_cleanup(primary);
+	vvop_plane_destroy(primary);
+
+err_plane:
+	destroy_workqueue(vvop->composer_wq);
 
 	return ret;
 }
@@ -324,8 +1030,17 @@ err_crtc:
 static void vvop_unbind(struct device *dev, struct device *master, void *data)
 {
 	struct vvop *vvop = dev_get_drvdata(dev);
+	int i;
+
+	destroy_workqueue(vvop->composer_wq);
+	if (vvop->frame)
+		kref_put(&vvop->frame->ref, vvop_frame_release);
+	kvfree(vvop->out);
 
-	drm_plane_cleanup(vvop->plane);
+	vvop_wb_connector_destroy(vvop);
+	for (i = 0; i < VVOP_NUM_OVERLAYS; i++)
+		vvop_plane_destroy(vvop->overlays[i]);
+	vvop_plane_destroy(vvop->plane);
 	drm_connector_cleanup(&vvop->connector);
 	drm_crtc_cleanup(&vvop->crtc);
 }
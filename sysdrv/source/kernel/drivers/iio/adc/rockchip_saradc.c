@@ -13,6 +13,7 @@
 #include <linux/clk.h>
 #include <linux/completion.h>
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
 #include <linux/reset.h>
 #include <linux/regulator/consumer.h>
 #include <linux/iio/buffer.h>
@@ -37,6 +38,17 @@
 #define SARADC_TIMEOUT			msecs_to_jiffies(100)
 #define SARADC_MAX_CHANNELS		8
 
+/* Continuous (software buffer) mode scan rate limits, in Hz */
+#define SARADC_CONT_DEF_FREQ		1000
+#define SARADC_CONT_MAX_FREQ		50000
+/*
+ * With the channel switch reset workaround every conversion on another
+ * channel spins 10us with irqs off, keep that a small share of the CPU.
+ */
+#define SARADC_CONT_MAX_FREQ_RESET	2000
+/* Completed scans held back in continuous mode, up to the buffer watermark */
+#define SARADC_CONT_BATCH		32
+
 /* v2 registers */
 #define SARADC2_CONV_CON		0x0
 #define SARADC_T_PD_SOC			0x4
@@ -75,6 +87,31 @@ struct rockchip_saradc {
 	const struct iio_chan_spec *last_chan;
 	struct notifier_block nb;
 	bool			suspended;
+	/*
+	 * Continuous mode: an hrtimer starts a scan every period and the ISR
+	 * chains the conversions of the enabled channels. Completed scans are
+	 * batched and pushed to the kfifo together once the buffer watermark
+	 * is reached, so the reader is woken once per batch.
+	 */
+	struct iio_dev		*indio_dev;
+	struct hrtimer		timer;
+	spinlock_t		cont_lock;
+	ktime_t			period;
+	u32			samp_freq;
+	u32			overrun;
+	bool			cont;
+	bool			scan_busy;
+	int			cont_chn;
+	int			scan_idx;
+	int			scan_num;
+	const struct iio_chan_spec *scan_chans[SARADC_MAX_CHANNELS];
+	struct rockchip_saradc_scan {
+		u16 values[SARADC_MAX_CHANNELS];
+		s64 timestamp __aligned(8);
+	} scan;
+	struct rockchip_saradc_scan batch[SARADC_CONT_BATCH];
+	unsigned int		batch_num;
+	unsigned int		batch_len;
 #ifdef CONFIG_ROCKCHIP_SARADC_TEST_CHN
 	bool			test;
 	u32			chn;
@@ -85,6 +122,7 @@ struct rockchip_saradc {
 };
 
 static void rockchip_saradc_reset_controller(struct reset_control *reset);
+static void rockchip_saradc_reset_controller_atomic(struct reset_control *reset);
 
 static void rockchip_saradc_start_v1(struct rockchip_saradc *info,
 					int chn)
@@ -104,8 +142,17 @@ static void rockchip_saradc_start_v2(struct rockchip_saradc *info,
 	/* If read other chn at anytime, then chn1 will error, assert
 	 * controller as a workaround.
 	 */
-	if (info->reset)
-		rockchip_saradc_reset_controller(info->reset);
+	if (info->reset) {
+		/*
+		 * Continuous scans are started from hrtimer and irq context,
+		 * only reset there when the channel actually changes.
+		 */
+		if (!info->cont)
+			rockchip_saradc_reset_controller(info->reset);
+		else if (chn != info->cont_chn)
+			rockchip_saradc_reset_controller_atomic(info->reset);
+		info->cont_chn = chn;
+	}
 
 	writel_relaxed(0xc, info->regs + SARADC_T_DAS_SOC);
 	writel_relaxed(0x20, info->regs + SARADC_T_PD_SOC);
@@ -191,7 +238,7 @@ static int rockchip_saradc_read_raw(struct iio_dev *indio_dev,
 	case IIO_CHAN_INFO_RAW:
 		mutex_lock(&indio_dev->mlock);
 
-		if (info->suspended) {
+		if (info->suspended || info->cont) {
 			mutex_unlock(&indio_dev->mlock);
 			return -EBUSY;
 		}
@@ -214,17 +261,134 @@ static int rockchip_saradc_read_raw(struct iio_dev *indio_dev,
 		*val = info->uv_vref / 1000;
 		*val2 = chan->scan_type.realbits;
 		return IIO_VAL_FRACTIONAL_LOG2;
+	case IIO_CHAN_INFO_SAMP_FREQ:
+		*val = info->samp_freq;
+		return IIO_VAL_INT;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int rockchip_saradc_write_raw(struct iio_dev *indio_dev,
+				     struct iio_chan_spec const *chan,
+				     int val, int val2, long mask)
+{
+	struct rockchip_saradc *info = iio_priv(indio_dev);
+	int ret;
+
+	switch (mask) {
+	case IIO_CHAN_INFO_SAMP_FREQ:
+		if (val <= 0 || val2 || val > (info->reset ?
+						SARADC_CONT_MAX_FREQ_RESET :
+						SARADC_CONT_MAX_FREQ))
+			return -EINVAL;
+
+		ret = iio_device_claim_direct_mode(indio_dev);
+		if (ret)
+			return ret;
+
+		info->samp_freq = val;
+		info->period = ns_to_ktime(NSEC_PER_SEC / val);
+		iio_device_release_direct_mode(indio_dev);
+		return 0;
 	default:
 		return -EINVAL;
 	}
 }
 
+/* Push up to count batched scans to the buffer, called with cont_lock held */
+static unsigned int rockchip_saradc_cont_flush(struct rockchip_saradc *info,
+					       unsigned int count)
+{
+	unsigned int i, num = min(count, info->batch_num);
+
+	for (i = 0; i < num; i++) {
+		/* The kfifo is full, userspace is not keeping up */
+		if (iio_push_to_buffers_with_timestamp(info->indio_dev,
+						       &info->batch[i],
+						       info->batch[i].timestamp))
+			info->overrun++;
+	}
+
+	info->batch_num -= num;
+	memmove(info->batch, info->batch + num,
+		info->batch_num * sizeof(info->batch[0]));
+
+	return num;
+}
+
+/* Called with cont_lock held, from irq context */
+static void rockchip_saradc_cont_isr(struct rockchip_saradc *info)
+{
+	const struct iio_chan_spec *chan = info->scan_chans[info->scan_idx];
+	int val;
+
+	val = rockchip_saradc_read(info);
+	info->scan.values[info->scan_idx++] =
+		val & GENMASK(chan->scan_type.realbits - 1, 0);
+
+	/* The buffer is being disabled, drop the partial scan */
+	if (!info->cont) {
+		rockchip_saradc_power_down(info);
+		info->scan_busy = false;
+		return;
+	}
+
+	if (info->scan_idx < info->scan_num) {
+		info->last_chan = info->scan_chans[info->scan_idx];
+		rockchip_saradc_start(info, info->last_chan->channel);
+		return;
+	}
+
+	rockchip_saradc_power_down(info);
+	info->scan_busy = false;
+
+	info->batch[info->batch_num++] = info->scan;
+	if (info->batch_num >= info->batch_len)
+		rockchip_saradc_cont_flush(info, info->batch_num);
+}
+
+static enum hrtimer_restart rockchip_saradc_timer(struct hrtimer *timer)
+{
+	struct rockchip_saradc *info =
+			container_of(timer, struct rockchip_saradc, timer);
+	unsigned long flags;
+
+	hrtimer_forward_now(timer, info->period);
+
+	spin_lock_irqsave(&info->cont_lock, flags);
+	if (!info->cont) {
+		spin_unlock_irqrestore(&info->cont_lock, flags);
+		return HRTIMER_NORESTART;
+	}
+
+	/* The previous scan has not finished, the rate is too high */
+	if (info->scan_busy) {
+		info->overrun++;
+	} else {
+		info->scan_busy = true;
+		info->scan_idx = 0;
+		info->scan.timestamp = iio_get_time_ns(info->indio_dev);
+		info->last_chan = info->scan_chans[0];
+		rockchip_saradc_start(info, info->last_chan->channel);
+	}
+	spin_unlock_irqrestore(&info->cont_lock, flags);
+
+	return HRTIMER_RESTART;
+}
+
 static irqreturn_t rockchip_saradc_isr(int irq, void *dev_id)
 {
 	struct rockchip_saradc *info = dev_id;
-#ifdef CONFIG_ROCKCHIP_SARADC_TEST_CHN
 	unsigned long flags;
-#endif
+
+	if (READ_ONCE(info->scan_busy)) {
+		spin_lock_irqsave(&info->cont_lock, flags);
+		if (info->scan_busy)
+			rockchip_saradc_cont_isr(info);
+		spin_unlock_irqrestore(&info->cont_lock, flags);
+		return IRQ_HANDLED;
+	}
 
 	/* Read value */
 	info->last_val = rockchip_saradc_read(info);
@@ -246,8 +410,55 @@ static irqreturn_t rockchip_saradc_isr(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+static ssize_t overrun_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct rockchip_saradc *info = iio_priv(dev_to_iio_dev(dev));
+
+	return sprintf(buf, "%u\n", READ_ONCE(info->overrun));
+}
+
+static DEVICE_ATTR_RO(overrun);
+
+static struct attribute *rockchip_saradc_iio_attrs[] = {
+	&dev_attr_overrun.attr,
+	NULL
+};
+
+static const struct attribute_group rockchip_saradc_iio_attr_group = {
+	.attrs = rockchip_saradc_iio_attrs,
+};
+
+static int rockchip_saradc_set_watermark(struct iio_dev *indio_dev,
+					 unsigned int val)
+{
+	struct rockchip_saradc *info = iio_priv(indio_dev);
+
+	info->batch_len = clamp_t(unsigned int, val, 1, SARADC_CONT_BATCH);
+
+	return 0;
+}
+
+/* A read asking for less than the watermark takes the batched scans */
+static int rockchip_saradc_flush(struct iio_dev *indio_dev, unsigned int count)
+{
+	struct rockchip_saradc *info = iio_priv(indio_dev);
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&info->cont_lock, flags);
+	ret = rockchip_saradc_cont_flush(info, count);
+	spin_unlock_irqrestore(&info->cont_lock, flags);
+
+	return ret;
+}
+
 static const struct iio_info rockchip_saradc_iio_info = {
 	.read_raw = rockchip_saradc_read_raw,
+	.write_raw = rockchip_saradc_write_raw,
+	.hwfifo_set_watermark = rockchip_saradc_set_watermark,
+	.hwfifo_flush_to_buffer = rockchip_saradc_flush,
+	.attrs = &rockchip_saradc_iio_attr_group,
 };
 
 #define SARADC_CHANNEL(_index, _id, _res) {			\
@@ -256,6 +467,7 @@ static const struct iio_info rockchip_saradc_iio_info = {
 	.channel = _index,					\
 	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW),		\
 	.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE),	\
+	.info_mask_shared_by_all = BIT(IIO_CHAN_INFO_SAMP_FREQ),\
 	.datasheet_name = _id,					\
 	.scan_index = _index,					\
 	.scan_type = {						\
@@ -439,6 +651,13 @@ static void rockchip_saradc_reset_controller(struct reset_control *reset)
 	reset_control_deassert(reset);
 }
 
+static void rockchip_saradc_reset_controller_atomic(struct reset_control *reset)
+{
+	reset_control_assert(reset);
+	udelay(10);
+	reset_control_deassert(reset);
+}
+
 static void rockchip_saradc_clk_disable(void *data)
 {
 	struct rockchip_saradc *info = data;
@@ -500,6 +719,79 @@ out:
 	return IRQ_HANDLED;
 }
 
+static void rockchip_saradc_cont_start(struct rockchip_saradc *info)
+{
+	info->scan_busy = false;
+	info->cont_chn = -1;
+	info->batch_num = 0;
+	WRITE_ONCE(info->cont, true);
+	hrtimer_start(&info->timer, info->period, HRTIMER_MODE_REL);
+}
+
+static void rockchip_saradc_cont_stop(struct rockchip_saradc *info)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&info->cont_lock, flags);
+	WRITE_ONCE(info->cont, false);
+	spin_unlock_irqrestore(&info->cont_lock, flags);
+	hrtimer_cancel(&info->timer);
+
+	/* Let an in-flight conversion land before powering down */
+	for (i = 0; i < 10 && READ_ONCE(info->scan_busy); i++)
+		usleep_range(100, 200);
+
+	info->scan_busy = false;
+	rockchip_saradc_power_down(info);
+
+	/* The buffer is still enabled, hand over the last partial batch */
+	spin_lock_irqsave(&info->cont_lock, flags);
+	rockchip_saradc_cont_flush(info, info->batch_num);
+	spin_unlock_irqrestore(&info->cont_lock, flags);
+}
+
+static int rockchip_saradc_buffer_postenable(struct iio_dev *indio_dev)
+{
+	struct rockchip_saradc *info = iio_priv(indio_dev);
+	int i, j = 0;
+
+	/* Triggered mode keeps converting from the poll function */
+	if (indio_dev->currentmode != INDIO_BUFFER_SOFTWARE)
+		return 0;
+
+#ifdef CONFIG_ROCKCHIP_SARADC_TEST_CHN
+	if (info->test)
+		return -EBUSY;
+#endif
+	for_each_set_bit(i, indio_dev->active_scan_mask, indio_dev->masklength)
+		info->scan_chans[j++] = &indio_dev->channels[i];
+
+	if (!j)
+		return -EINVAL;
+
+	info->scan_num = j;
+	info->overrun = 0;
+	rockchip_saradc_cont_start(info);
+
+	return 0;
+}
+
+static int rockchip_saradc_buffer_predisable(struct iio_dev *indio_dev)
+{
+	struct rockchip_saradc *info = iio_priv(indio_dev);
+
+	if (info->cont)
+		rockchip_saradc_cont_stop(info);
+
+	return 0;
+}
+
+static const struct iio_buffer_setup_ops rockchip_saradc_buffer_ops = {
+	.postenable = rockchip_saradc_buffer_postenable,
+	.predisable = rockchip_saradc_buffer_predisable,
+};
+
 static int rockchip_saradc_volt_notify(struct notifier_block *nb,
 						   unsigned long event,
 						   void *data)
@@ -645,6 +937,14 @@ static int rockchip_saradc_probe(struct platform_device *pdev)
 
 	init_completion(&info->completion);
 
+	info->indio_dev = indio_dev;
+	spin_lock_init(&info->cont_lock);
+	info->batch_len = 1;
+	hrtimer_init(&info->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	info->timer.function = rockchip_saradc_timer;
+	info->samp_freq = SARADC_CONT_DEF_FREQ;
+	info->period = ns_to_ktime(NSEC_PER_SEC / info->samp_freq);
+
 	irq = platform_get_irq(pdev, 0);
 	if (irq < 0)
 		return irq;
@@ -745,10 +1045,17 @@ static int rockchip_saradc_probe(struct platform_device *pdev)
 	indio_dev->num_channels = info->data->num_channels;
 	ret = devm_iio_triggered_buffer_setup(&indio_dev->dev, indio_dev, NULL,
 					      rockchip_saradc_trigger_handler,
-					      NULL);
+					      &rockchip_saradc_buffer_ops);
 	if (ret)
 		return ret;
 
+	/*
+	 * Enabling the buffer without a trigger selects continuous mode,
+	 * paced by sampling_frequency; scans are pushed in batches of up to
+	 * the buffer watermark rather than per sample.
+	 */
+	indio_dev->modes |= INDIO_BUFFER_SOFTWARE;
+
 	info->nb.notifier_call = rockchip_saradc_volt_notify;
 	ret = regulator_register_notifier(info->vref, &info->nb);
 	if (ret)
@@ -796,6 +1103,9 @@ static int rockchip_saradc_suspend(struct device *dev)
 	/* Avoid reading saradc when suspending */
 	mutex_lock(&indio_dev->mlock);
 
+	if (info->cont)
+		rockchip_saradc_cont_stop(info);
+
 	clk_disable_unprepare(info->clk);
 	clk_disable_unprepare(info->pclk);
 	regulator_disable(info->vref);
@@ -821,11 +1131,16 @@ static int rockchip_saradc_resume(struct device *dev)
 		return ret;
 
 	ret = clk_prepare_enable(info->clk);
-	if (ret)
+	if (ret) {
 		clk_disable_unprepare(info->pclk);
+		return ret;
+	}
 
 	info->suspended = false;
 
+	if (indio_dev->currentmode == INDIO_BUFFER_SOFTWARE)
+		rockchip_saradc_cont_start(info);
+
 	return ret;
 }
 #endif
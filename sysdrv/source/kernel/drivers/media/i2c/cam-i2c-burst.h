@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright (C) 2023 Rockchip Electronics Co., Ltd. */
+
+#ifndef CAM_I2C_BURST_H
+#define CAM_I2C_BURST_H
+
+#include <linux/i2c.h>
+#include <linux/ktime.h>
+#include <linux/types.h>
+
+/*
+ * Sensor register tables are mostly runs of consecutive 8-bit registers.
+ * Writes to consecutive addresses are queued and sent as one
+ * auto-increment transfer instead of one i2c_master_send() per register.
+ */
+#define CAM_I2C_BURST_MAX		32
+
+struct cam_i2c_burst {
+	struct i2c_client *client;
+	ktime_t start_time;
+	int addr_bytes;
+	int page_reg;
+	u16 start;
+	u16 len;
+	u32 regs;
+	u32 msgs;
+	u8 buf[2 + CAM_I2C_BURST_MAX];
+};
+
+/*
+ * addr_bytes is the register address width, 1 or 2.  Writes to page_reg
+ * (-1 for none) switch the register bank and are always sent on their own.
+ */
+static inline void cam_i2c_burst_init(struct cam_i2c_burst *b,
+				      struct i2c_client *client,
+				      int addr_bytes, int page_reg)
+{
+	b->client = client;
+	b->start_time = ktime_get();
+	b->addr_bytes = addr_bytes;
+	b->page_reg = page_reg;
+	b->len = 0;
+	b->regs = 0;
+	b->msgs = 0;
+}
+
+static inline int cam_i2c_burst_flush(struct cam_i2c_burst *b)
+{
+	int len = b->addr_bytes + b->len;
+
+	if (!b->len)
+		return 0;
+
+	b->len = 0;
+	b->msgs++;
+	if (i2c_master_send(b->client, b->buf, len) != len)
+		return -EIO;
+
+	return 0;
+}
+
+static inline int cam_i2c_burst_write(struct cam_i2c_burst *b, u16 reg, u8 val)
+{
+	bool page = b->page_reg >= 0 && reg == b->page_reg;
+	int ret;
+
+	if (b->len && (page || reg != b->start + b->len ||
+		       b->len == CAM_I2C_BURST_MAX)) {
+		ret = cam_i2c_burst_flush(b);
+		if (ret)
+			return ret;
+	}
+
+	if (!b->len) {
+		b->start = reg;
+		if (b->addr_bytes == 2) {
+			b->buf[0] = reg >> 8;
+			b->buf[1] = reg & 0xff;
+		} else {
+			b->buf[0] = reg & 0xff;
+		}
+	}
+
+	b->buf[b->addr_bytes + b->len++] = val;
+	b->regs++;
+
+	return page ? cam_i2c_burst_flush(b) : 0;
+}
+
+/* Flush the pending run and report how long the table took */
+static inline int cam_i2c_burst_finish(struct cam_i2c_burst *b)
+{
+	int ret = cam_i2c_burst_flush(b);
+
+	dev_dbg(&b->client->dev, "wrote %u regs in %u transfers, %lld us\n",
+		b->regs, b->msgs,
+		ktime_us_delta(ktime_get(), b->start_time));
+
+	return ret;
+}
+
+#endif
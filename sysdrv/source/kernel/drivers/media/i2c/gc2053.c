@@ -35,6 +35,7 @@
 #include <media/v4l2-image-sizes.h>
 #include <media/v4l2-mediabus.h>
 #include <media/v4l2-subdev.h>
+#include "cam-i2c-burst.h"
 
 #define DRIVER_VERSION          KERNEL_VERSION(0, 0x01, 0x02)
 #define GC2053_NAME             "gc2053"
@@ -372,17 +373,22 @@ static int gc2053_write_reg(struct i2c_client *client, u8 reg, u8 val)
 static int gc2053_write_array(struct i2c_client *client,
 				  const struct regval *regs)
 {
+	struct cam_i2c_burst burst;
 	int i, ret = 0;
 
+	/* 0xfe selects the register page, never burst across it */
+	cam_i2c_burst_init(&burst, client, 1, 0xfe);
 	i = 0;
 	while (regs[i].addr != REG_NULL) {
-		ret = gc2053_write_reg(client, regs[i].addr, regs[i].val);
-		if (ret) {
-			dev_err(&client->dev, "%s failed !\n", __func__);
+		ret = cam_i2c_burst_write(&burst, regs[i].addr, regs[i].val);
+		if (ret)
 			break;
-		}
 		i++;
 	}
+	if (!ret)
+		ret = cam_i2c_burst_finish(&burst);
+	if (ret)
+		dev_err(&client->dev, "%s failed !\n", __func__);
 
 	return ret;
 }
@@ -29,6 +29,7 @@
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-subdev.h>
 #include <linux/pinctrl/consumer.h>
+#include "cam-i2c-burst.h"
 
 #define DRIVER_VERSION			KERNEL_VERSION(0, 0x02, 0x00)
 
@@ -431,18 +432,24 @@ static int gc4023_write_reg(struct i2c_client *client, u16 reg,
 static int gc4023_write_array(struct i2c_client *client,
 			      const struct regval *regs)
 {
+	struct cam_i2c_burst burst;
 	u32 i;
 	int ret = 0;
 
+	cam_i2c_burst_init(&burst, client, 2, -1);
 	for (i = 0; ret == 0 && regs[i].addr != REG_NULL; i++) {
-		if (regs[i].addr == REG_DELAY)
+		if (regs[i].addr == REG_DELAY) {
+			ret = cam_i2c_burst_flush(&burst);
 			usleep_range(regs[i].val * 1000, regs[i].val * 2 * 1000);
-		else
-			ret = gc4023_write_reg(client, regs[i].addr,
-				       GC4023_REG_VALUE_08BIT, regs[i].val);
+		} else {
+			ret = cam_i2c_burst_write(&burst, regs[i].addr,
+						  regs[i].val);
+		}
 	}
+	if (ret)
+		return ret;
 
-	return ret;
+	return cam_i2c_burst_finish(&burst);
 }
 
 /* Read registers up to 4 at a time */
@@ -30,6 +30,7 @@
 #include "../platform/rockchip/isp/rkisp_tb_helper.h"
 #include "cam-tb-setup.h"
 #include "cam-sleep-wakeup.h"
+#include "cam-i2c-burst.h"
 
 #define DRIVER_VERSION			KERNEL_VERSION(0, 0x01, 0x01)
 
@@ -380,14 +381,17 @@ static int sc4336_write_reg(struct i2c_client *client, u16 reg,
 static int sc4336_write_array(struct i2c_client *client,
 			       const struct regval *regs)
 {
+	struct cam_i2c_burst burst;
 	u32 i;
 	int ret = 0;
 
+	cam_i2c_burst_init(&burst, client, 2, -1);
 	for (i = 0; ret == 0 && regs[i].addr != REG_NULL; i++)
-		ret = sc4336_write_reg(client, regs[i].addr,
-					SC4336_REG_VALUE_08BIT, regs[i].val);
+		ret = cam_i2c_burst_write(&burst, regs[i].addr, regs[i].val);
+	if (ret)
+		return ret;
 
-	return ret;
+	return cam_i2c_burst_finish(&burst);
 }
 
 /* Read registers up to 4 at a time */
@@ -2421,6 +2421,7 @@ static void rkcif_assign_new_buffer_init(struct rkcif_stream *stream,
 	struct csi_channel_info *channel = &dev->channels[channel_id];
 
 	stream->lack_buf_cnt = 0;
+	memset(&stream->buf_stats, 0, sizeof(stream->buf_stats));
 	if (mbus_cfg->type == V4L2_MBUS_CSI2_DPHY ||
 	    mbus_cfg->type == V4L2_MBUS_CSI2_CPHY ||
 	    mbus_cfg->type == V4L2_MBUS_CCP2) {
@@ -2673,7 +2674,19 @@ static int rkcif_assign_new_buffer_update(struct rkcif_stream *stream,
 		}
 	} else {
 		buffer = NULL;
-		if (!(stream->cur_stream_mode & RKCIF_STREAM_MODE_TOISP) && dummy_buf->vaddr) {
+		stream->buf_stats.late_cnt++;
+		if (stream->is_latest_frame &&
+		    !(stream->cur_stream_mode & RKCIF_STREAM_MODE_TOISP) &&
+		    rkcif_get_interlace_mode(stream) != RKCIF_INTERLACE_SOFT &&
+		    ((stream->frame_phase == CIF_CSI_FRAME0_READY && stream->curr_buf) ||
+		     (stream->frame_phase == CIF_CSI_FRAME1_READY && stream->next_buf))) {
+			/*
+			 * latest frame wins: keep the just finished buffer armed
+			 * and let the next frame overwrite it, instead of handing
+			 * out this frame and losing the newer one to the dummy.
+			 */
+			ret = -EAGAIN;
+		} else if (!(stream->cur_stream_mode & RKCIF_STREAM_MODE_TOISP) && dummy_buf->vaddr) {
 			if (stream->frame_phase == CIF_CSI_FRAME0_READY) {
 				stream->curr_buf  = NULL;
 			} else if (stream->frame_phase == CIF_CSI_FRAME1_READY) {
@@ -7556,6 +7569,9 @@ static long rkcif_ioctl_default(struct file *file, void *fh,
 			stream->is_high_align = false;
 		}
 		break;
+	case RKCIF_CMD_SET_LATEST_FRAME:
+		stream->is_latest_frame = !!*(int *)arg;
+		break;
 	case RKCIF_CMD_SET_FPS:
 		fps = *(struct rkcif_fps *)arg;
 		rkcif_set_fps(stream, &fps);
@@ -9468,11 +9484,16 @@ static void rkcif_update_stream(struct rkcif_device *cif_dev,
 	rkcif_deal_readout_time(stream);
 
 	if (!stream->is_line_wake_up) {
+		if (!active_buf && cif_dev->hw_dev->dummy_buf.vaddr)
+			stream->buf_stats.dummy_cnt++;
 		ret = rkcif_assign_new_buffer_pingpong(stream,
 						       RKCIF_YUV_ADDR_STATE_UPDATE,
 						       mipi_id);
-		if (ret && cif_dev->chip_id < CHIP_RK3588_CIF)
+		if (ret && (cif_dev->chip_id < CHIP_RK3588_CIF || ret == -EAGAIN)) {
+			if (active_buf)
+				stream->buf_stats.drop_cnt++;
 			return;
+		}
 	} else {
 		ret = rkcif_update_new_buffer_wake_up_mode(stream);
 		if (ret && cif_dev->chip_id < CHIP_RK3588_CIF)
@@ -373,6 +373,17 @@ struct rkcif_irq_stats {
 	u64 all_err_cnt;
 };
 
+/* struct rkcif_buf_stats - take notes on buffer rotation of one stream
+ * @late_cnt: frame end with no buffer queued by userspace
+ * @dummy_cnt: frames written to the dummy buffer
+ * @drop_cnt: frames written to a real buffer but not returned to userspace
+ */
+struct rkcif_buf_stats {
+	u64 late_cnt;
+	u64 dummy_cnt;
+	u64 drop_cnt;
+};
+
 /*
  * the detecting mode of cif reset timer
  * related with dts property:rockchip,cif-monitor
@@ -503,6 +514,9 @@ struct rkcif_toisp_buf_state {
  * @curr_buf: the buffer used for current frame
  * @next_buf: the buffer used for next frame
  * @fps_lock: to protect parameters about calculating fps
+ * @buf_stats: late/dummy/drop statistics of the buffer rotation
+ * @is_latest_frame: when userspace is late, overwrite the oldest
+ *		     frame instead of dropping the newest one
  */
 struct rkcif_stream {
 	unsigned id:3;
@@ -540,6 +554,7 @@ struct rkcif_stream {
 	struct rkcif_fps_stats		fps_stats;
 	struct rkcif_extend_info	extend_line;
 	struct rkcif_readout_stats	readout;
+	struct rkcif_buf_stats		buf_stats;
 	unsigned int			fs_cnt_in_single_frame;
 	unsigned int			capture_mode;
 	struct rkcif_scale_vdev		*scale_vdev;
@@ -591,6 +606,7 @@ struct rkcif_stream {
 	bool				is_single_cap;
 	bool				is_wait_stop_complete;
 	bool				interlaced_bad_frame;
+	bool				is_latest_frame;
 };
 
 struct rkcif_lvds_subdev {
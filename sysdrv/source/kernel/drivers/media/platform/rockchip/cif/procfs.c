@@ -381,6 +381,26 @@ static void rkcif_show_format(struct rkcif_device *dev, struct seq_file *f)
 			   dev->stream[1].total_buf_num,
 			   dev->stream[2].total_buf_num,
 			   dev->stream[3].total_buf_num);
+		seq_printf(f, "late buf_cnt: %llu %llu %llu %llu\n",
+			   dev->stream[0].buf_stats.late_cnt,
+			   dev->stream[1].buf_stats.late_cnt,
+			   dev->stream[2].buf_stats.late_cnt,
+			   dev->stream[3].buf_stats.late_cnt);
+		seq_printf(f, "dummy frame: %llu %llu %llu %llu\n",
+			   dev->stream[0].buf_stats.dummy_cnt,
+			   dev->stream[1].buf_stats.dummy_cnt,
+			   dev->stream[2].buf_stats.dummy_cnt,
+			   dev->stream[3].buf_stats.dummy_cnt);
+		seq_printf(f, "drop frame: %llu %llu %llu %llu\n",
+			   dev->stream[0].buf_stats.drop_cnt,
+			   dev->stream[1].buf_stats.drop_cnt,
+			   dev->stream[2].buf_stats.drop_cnt,
+			   dev->stream[3].buf_stats.drop_cnt);
+		seq_printf(f, "latest frame: %d %d %d %d\n",
+			   dev->stream[0].is_latest_frame,
+			   dev->stream[1].is_latest_frame,
+			   dev->stream[2].is_latest_frame,
+			   dev->stream[3].is_latest_frame);
 	}
 }
 
@@ -19,6 +19,8 @@ void rkisp_write(struct rkisp_device *dev, u32 reg, u32 val, bool is_direct)
 	*flag = SW_REG_CACHE;
 	if (dev->hw_dev->is_single || is_direct) {
 		*flag = SW_REG_CACHE_SYNC;
+		if (!dev->hw_dev->is_single)
+			rkisp_hw_reg_mirror_drop(dev->hw_dev, reg, false);
 		if (dev->isp_ver == ISP_V32 && reg <= 0x200)
 			rv1106_sdmmc_get_lock();
 		writel(val, dev->hw_dev->base_addr + reg);
@@ -45,6 +47,8 @@ void rkisp_idx_write(struct rkisp_device *dev, u32 reg, u32 val, int idx, bool i
 	*flag = SW_REG_CACHE;
 	if (dev->hw_dev->is_single || is_direct) {
 		*flag = SW_REG_CACHE_SYNC;
+		if (!hw->is_single)
+			rkisp_hw_reg_mirror_drop(hw, reg, base_addr != hw->base_addr);
 		if (dev->isp_ver == ISP_V32 && reg <= 0x200)
 			rv1106_sdmmc_get_lock();
 		if (idx == ISP_UNITE_LEFT ||
@@ -219,6 +223,62 @@ void rkisp_update_regs(struct rkisp_device *dev, u32 start, u32 end)
 	}
 }
 
+static void
+rkisp_write_diff(struct rkisp_hw_dev *hw, void __iomem *base,
+		 u32 reg, u32 val, bool is_next)
+{
+	u32 idx = reg / 4;
+
+	if (is_next)
+		idx += RKISP_ISP_SW_REG_SIZE / 4;
+	if (!test_bit(reg / 4, hw->reg_volatile) &&
+	    test_bit(idx, hw->reg_mirror_valid) &&
+	    hw->reg_mirror[idx] == val) {
+		hw->reg_diff_skip_cnt++;
+		return;
+	}
+	writel(val, base + reg);
+	hw->reg_mirror[idx] = val;
+	set_bit(idx, hw->reg_mirror_valid);
+	hw->reg_diff_wr_cnt++;
+}
+
+/*
+ * Same as rkisp_update_regs() for multi sensor context switch, but skip
+ * the registers which already hold the value from the last switch. Most
+ * of the params window is the same between sensors of one product.
+ */
+void rkisp_update_regs_diff(struct rkisp_device *dev, u32 start, u32 end)
+{
+	struct rkisp_hw_dev *hw = dev->hw_dev;
+	u32 i, offset = 0;
+
+	if (!rkisp_reg_diff || !hw->reg_mirror ||
+	    dev->procfs.mode & RKISP_PROCFS_FIL_SW) {
+		rkisp_update_regs(dev, start, end);
+		return;
+	}
+	if (end > RKISP_ISP_SW_REG_SIZE - 4) {
+		dev_err(dev->dev, "%s out of range\n", __func__);
+		return;
+	}
+	if (hw->unite == ISP_UNITE_ONE && dev->unite_index > ISP_UNITE_LEFT)
+		offset = RKISP_ISP_SW_MAX_SIZE * dev->unite_index;
+
+	for (i = start; i <= end; i += 4) {
+		u32 *val = dev->sw_base_addr + i + offset;
+		u32 *flag = dev->sw_base_addr + i + RKISP_ISP_SW_REG_SIZE + offset;
+
+		if (*flag != SW_REG_CACHE)
+			continue;
+		rkisp_write_diff(hw, hw->base_addr, i, *val, false);
+		if (hw->unite == ISP_UNITE_TWO) {
+			val = dev->sw_base_addr + i + RKISP_ISP_SW_MAX_SIZE;
+			rkisp_write_diff(hw, hw->base_next_addr, i, *val, true);
+		}
+	}
+}
+
 int rkisp_buf_get_fd(struct rkisp_device *dev,
 		     struct rkisp_dummy_buffer *buf, bool try_fd)
 {
@@ -139,6 +139,8 @@ extern bool rkisp_monitor;
 extern bool rkisp_irq_dbg;
 extern bool rkisp_buf_dbg;
 extern u64 rkisp_debug_reg;
+extern bool rkisp_reg_diff;
+extern unsigned int rkisp_sched_fps[];
 extern struct platform_driver rkisp_plat_drv;
 
 static inline
@@ -186,6 +188,7 @@ void rkisp_idx_set_reg_cache_bits(struct rkisp_device *dev, u32 reg, u32 mask, u
 void rkisp_idx_clear_reg_cache_bits(struct rkisp_device *dev, u32 reg, u32 mask, int idx);
 
 void rkisp_update_regs(struct rkisp_device *dev, u32 start, u32 end);
+void rkisp_update_regs_diff(struct rkisp_device *dev, u32 start, u32 end);
 
 int rkisp_buf_get_fd(struct rkisp_device *dev, struct rkisp_dummy_buffer *buf, bool try_fd);
 int rkisp_alloc_buffer(struct rkisp_device *dev, struct rkisp_dummy_buffer *buf);
@@ -96,6 +96,14 @@ static unsigned int rkisp_wrap_line;
 module_param_named(wrap_line, rkisp_wrap_line, uint, 0644);
 MODULE_PARM_DESC(wrap_line, "rkisp wrap line for mpp");
 
+bool rkisp_reg_diff = true;
+module_param_named(reg_diff, rkisp_reg_diff, bool, 0644);
+MODULE_PARM_DESC(reg_diff, "rkisp multi sensor only write changed params registers");
+
+unsigned int rkisp_sched_fps[DEV_MAX];
+module_param_array_named(sched_fps, rkisp_sched_fps, uint, NULL, 0644);
+MODULE_PARM_DESC(sched_fps, "rkisp multi sensor fps target of each virtual isp, 0 for sensor fps");
+
 static DEFINE_MUTEX(rkisp_dev_mutex);
 static LIST_HEAD(rkisp_device_list);
 
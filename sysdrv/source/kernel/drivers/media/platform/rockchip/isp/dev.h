@@ -167,6 +167,23 @@ struct rkisp_sensor_info {
 	struct v4l2_subdev_pad_config cfg;
 };
 
+/* struct rkisp_sched - readback scheduling of one virtual isp
+ * @vtime: weighted frames run, the lowest ready one runs next
+ * @run_cnt: frames run
+ * @late_cnt: frames run ahead of the fair pick for being past their latency target
+ * @wait_sum: sum of sof to readback start, in ns
+ * @wait_max: max of sof to readback start, in ns
+ * @is_wait: frame queued but not picked at last schedule
+ */
+struct rkisp_sched {
+	u64 vtime;
+	u64 run_cnt;
+	u64 late_cnt;
+	u64 wait_sum;
+	u64 wait_max;
+	bool is_wait;
+};
+
 /* struct rkisp_hdr - hdr configured
  * @op_mode: hdr optional mode
  * @esp_mode: hdr especial mode
@@ -275,6 +292,7 @@ struct rkisp_device {
 	int sw_rd_cnt;
 
 	struct rkisp_rx_buf_pool pv_pool[RKISP_RX_BUF_POOL_MAX];
+	struct rkisp_sched sched;
 
 	struct mutex buf_lock;
 	spinlock_t cmsk_lock;
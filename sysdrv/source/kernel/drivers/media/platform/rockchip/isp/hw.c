@@ -354,6 +354,57 @@ int rkisp_register_irq(struct rkisp_hw_dev *hw_dev)
 	return 0;
 }
 
+/*
+ * Registers changed by hardware or written around the sw cache, which
+ * must be written on every context switch even if the value is the same.
+ */
+static const u32 rkisp_hw_volatile_reg[] = {
+	ISP21_BAY3D_BASE, ISP21_DRC_BASE, ISP3X_BAY3D_CTRL,
+	ISP_DHAZ_CTRL, ISP3X_3DLUT_BASE, ISP_3DLUT_UPDATE,
+	ISP_RAWAE_LITE_BASE, RAWAE_BIG1_BASE, RAWAE_BIG2_BASE, RAWAE_BIG3_BASE,
+	RAWAE_BIG1_BASE + RAWAE_BIG_RAM_CTRL, RAWAE_BIG2_BASE + RAWAE_BIG_RAM_CTRL,
+	RAWAE_BIG3_BASE + RAWAE_BIG_RAM_CTRL,
+	ISP_RAWHIST_LITE_BASE, ISP_RAWHIST_LITE_RAM_CTRL,
+	ISP_RAWHIST_BIG1_BASE, ISP_RAWHIST_BIG2_BASE, ISP_RAWHIST_BIG3_BASE,
+	ISP_RAWHIST_BIG1_BASE + ISP_RAWHIST_BIG_HRAM_CTRL,
+	ISP_RAWHIST_BIG2_BASE + ISP_RAWHIST_BIG_HRAM_CTRL,
+	ISP_RAWHIST_BIG3_BASE + ISP_RAWHIST_BIG_HRAM_CTRL,
+	ISP_RAWHIST_BIG1_BASE + ISP_RAWHIST_BIG_WRAM_CTRL,
+	ISP_RAWHIST_BIG2_BASE + ISP_RAWHIST_BIG_WRAM_CTRL,
+	ISP_RAWHIST_BIG3_BASE + ISP_RAWHIST_BIG_WRAM_CTRL,
+	0x4840, 0x4a80, 0x4b40,
+	ISP_RAWAF_BASE, ISP3X_RAWAF_RAM_DATA,
+	ISP_RAWAWB_BASE, ISP_RAWAWB_RAM_CTRL, ISP_RAWAWB_RAM_DATA,
+	ISP_LDCH_BASE, ISP3X_CAC_BASE,
+	ISP3X_DRC_IIRWG_GAIN, ISP3X_DRC_EXPLRATIO,
+	ISP3X_YNR_GLOBAL_CTRL, ISP3X_CNR_CTRL,
+};
+
+static int rkisp_hw_reg_mirror_init(struct rkisp_hw_dev *dev, int mult)
+{
+	u32 num = RKISP_ISP_SW_REG_SIZE / 4;
+	int i;
+
+	dev->reg_mirror = devm_kcalloc(dev->dev, num * mult, sizeof(u32), GFP_KERNEL);
+	dev->reg_mirror_valid = devm_kcalloc(dev->dev, BITS_TO_LONGS(num * mult),
+					     sizeof(long), GFP_KERNEL);
+	dev->reg_volatile = devm_kcalloc(dev->dev, BITS_TO_LONGS(num),
+					 sizeof(long), GFP_KERNEL);
+	if (!dev->reg_mirror || !dev->reg_mirror_valid || !dev->reg_volatile)
+		return -ENOMEM;
+	for (i = 0; i < ARRAY_SIZE(rkisp_hw_volatile_reg); i++)
+		set_bit(rkisp_hw_volatile_reg[i] / 4, dev->reg_volatile);
+	return 0;
+}
+
+void rkisp_hw_reg_mirror_clear(struct rkisp_hw_dev *dev)
+{
+	int mult = dev->unite == ISP_UNITE_TWO ? 2 : 1;
+
+	if (dev->reg_mirror_valid)
+		bitmap_zero(dev->reg_mirror_valid, RKISP_ISP_SW_REG_SIZE / 4 * mult);
+}
+
 void rkisp_hw_reg_save(struct rkisp_hw_dev *dev)
 {
 	void *buf = dev->sw_reg;
@@ -447,6 +498,12 @@ void rkisp_hw_reg_restore(struct rkisp_hw_dev *dev)
 		}
 	};
 
+	rkisp_hw_reg_mirror_clear(dev);
+	/* table SRAM is not part of the restore, rewrite the tables */
+	for (i = 0; i < dev->dev_num; i++) {
+		if (dev->isp[i])
+			rkisp_params_reset_shadow(&dev->isp[i]->params_vdev);
+	}
 	for (i = 0; i <= !!dev->unite; i++) {
 		if (dev->unite != ISP_UNITE_TWO && i)
 			break;
@@ -866,6 +923,7 @@ void rkisp_soft_reset(struct rkisp_hw_dev *dev, bool is_secure)
 	void __iomem *base = dev->base_addr;
 	u32 val, iccl0, iccl1, clk_ctrl0, clk_ctrl1;
 
+	rkisp_hw_reg_mirror_clear(dev);
 	/* record clk config and recover */
 	iccl0 = readl(base + CIF_ICCL);
 	clk_ctrl0 = readl(base + CTRL_VI_ISP_CLK_CTRL);
@@ -1095,6 +1153,9 @@ static int rkisp_hw_probe(struct platform_device *pdev)
 		return -ENOMEM;
 	dev_set_drvdata(dev, hw_dev);
 	hw_dev->dev = dev;
+	ret = rkisp_hw_reg_mirror_init(hw_dev, mult);
+	if (ret)
+		return ret;
 	hw_dev->is_thunderboot = IS_ENABLED(CONFIG_VIDEO_ROCKCHIP_THUNDER_BOOT_ISP);
 	dev_info(dev, "is_thunderboot: %d\n", hw_dev->is_thunderboot);
 
@@ -1309,6 +1370,7 @@ void rkisp_hw_enum_isp_size(struct rkisp_hw_dev *hw_dev)
 	hw_dev->is_single = true;
 	hw_dev->is_multi_overflow = false;
 	hw_dev->is_frm_buf = false;
+	rkisp_hw_reg_mirror_clear(hw_dev);
 	for (i = 0; i < hw_dev->dev_num; i++) {
 		isp = hw_dev->isp[i];
 		if (!isp || (isp && !isp->is_hw_link))
@@ -1355,6 +1417,7 @@ static int __maybe_unused rkisp_runtime_resume(struct device *dev)
 		return ret;
 
 	enable_sys_clk(hw_dev);
+	rkisp_hw_reg_mirror_clear(hw_dev);
 	if (dev->power.runtime_status) {
 		if (!hw_dev->is_assigned_clk) {
 			unsigned long rate = hw_dev->clk_rate_tbl[0].clk_rate * 1000000UL;
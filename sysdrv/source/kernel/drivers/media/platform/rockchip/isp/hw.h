@@ -90,6 +90,19 @@ struct rkisp_hw_dev {
 	u64 iq_feature;
 	int buf_init_cnt;
 	u32 unite;
+
+	/* readback scheduler for multi sensor */
+	u64 sched_vclock;
+	u64 sched_switch_cnt;
+	u32 sched_late_run;
+
+	/* hw register values written by rkisp_update_regs_diff() */
+	u32 *reg_mirror;
+	unsigned long *reg_mirror_valid;
+	unsigned long *reg_volatile;
+	u64 reg_diff_wr_cnt;
+	u64 reg_diff_skip_cnt;
+
 	bool is_feature_on;
 	bool is_dma_contig;
 	bool is_dma_sg_ops;
@@ -112,4 +125,17 @@ void rkisp_soft_reset(struct rkisp_hw_dev *dev, bool is_secure);
 void rkisp_hw_enum_isp_size(struct rkisp_hw_dev *hw_dev);
 void rkisp_hw_reg_save(struct rkisp_hw_dev *dev);
 void rkisp_hw_reg_restore(struct rkisp_hw_dev *dev);
+void rkisp_hw_reg_mirror_clear(struct rkisp_hw_dev *dev);
+
+static inline void
+rkisp_hw_reg_mirror_drop(struct rkisp_hw_dev *dev, u32 reg, bool is_next)
+{
+	u32 idx = reg / 4;
+
+	if (!dev->reg_mirror_valid || reg >= RKISP_ISP_SW_REG_SIZE)
+		return;
+	if (is_next)
+		idx += RKISP_ISP_SW_REG_SIZE / 4;
+	clear_bit(idx, dev->reg_mirror_valid);
+}
 #endif
@@ -467,6 +467,13 @@ void rkisp_params_stream_stop(struct rkisp_isp_params_vdev *params_vdev)
 	params_vdev->first_cfg_params = false;
 }
 
+/* hw registers and tables lost, configs must not be skipped as unchanged */
+void rkisp_params_reset_shadow(struct rkisp_isp_params_vdev *params_vdev)
+{
+	if (params_vdev->ops && params_vdev->ops->reset_shadow)
+		params_vdev->ops->reset_shadow(params_vdev);
+}
+
 bool rkisp_params_check_bigmode(struct rkisp_isp_params_vdev *params_vdev)
 {
 	if (params_vdev->ops->check_bigmode)
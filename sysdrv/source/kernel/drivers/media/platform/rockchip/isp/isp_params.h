@@ -44,6 +44,7 @@ struct rkisp_isp_params_ops {
 	int (*info2ddr_cfg)(struct rkisp_isp_params_vdev *params_vdev, void *arg);
 	void (*get_bay3d_buffd)(struct rkisp_isp_params_vdev *params_vdev,
 				struct rkisp_bay3dbuf_info *bay3dbuf);
+	void (*reset_shadow)(struct rkisp_isp_params_vdev *params_vdev);
 };
 
 /*
@@ -147,6 +148,7 @@ void rkisp_params_get_meshbuf_inf(struct rkisp_isp_params_vdev *params_vdev, voi
 int rkisp_params_set_meshbuf_size(struct rkisp_isp_params_vdev *params_vdev, void *meshsize);
 void rkisp_params_meshbuf_free(struct rkisp_isp_params_vdev *params_vdev, u64 id);
 void rkisp_params_stream_stop(struct rkisp_isp_params_vdev *params_vdev);
+void rkisp_params_reset_shadow(struct rkisp_isp_params_vdev *params_vdev);
 bool rkisp_params_check_bigmode(struct rkisp_isp_params_vdev *params_vdev);
 int rkisp_params_info2ddr_cfg(struct rkisp_isp_params_vdev *params_vdev, void *arg);
 void rkisp_params_get_bay3d_buffd(struct rkisp_isp_params_vdev *params_vdev,
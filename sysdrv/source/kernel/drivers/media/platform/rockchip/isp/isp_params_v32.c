@@ -45,10 +45,19 @@ isp3_param_write_direct(struct rkisp_isp_params_vdev *params_vdev,
 	rkisp_write(params_vdev->dev, addr, value, true);
 }
 
+static inline void
+isp3_param_wr_inc(struct rkisp_isp_params_vdev *params_vdev)
+{
+	struct rkisp_isp_params_val_v32 *priv_val = params_vdev->priv_val;
+
+	priv_val->reg_wr_cnt++;
+}
+
 static inline void
 isp3_param_write(struct rkisp_isp_params_vdev *params_vdev,
 		 u32 value, u32 addr, u32 id)
 {
+	isp3_param_wr_inc(params_vdev);
 	rkisp_idx_write(params_vdev->dev, addr, value, id, false);
 }
 
@@ -74,6 +83,7 @@ static inline void
 isp3_param_set_bits(struct rkisp_isp_params_vdev *params_vdev,
 		    u32 reg, u32 bit_mask, u32 id)
 {
+	isp3_param_wr_inc(params_vdev);
 	rkisp_idx_set_bits(params_vdev->dev, reg, 0, bit_mask, id, false);
 }
 
@@ -81,6 +91,7 @@ static inline void
 isp3_param_clear_bits(struct rkisp_isp_params_vdev *params_vdev,
 		      u32 reg, u32 bit_mask, u32 id)
 {
+	isp3_param_wr_inc(params_vdev);
 	rkisp_idx_clear_bits(params_vdev->dev, reg, bit_mask, id, false);
 }
 
@@ -4044,6 +4055,120 @@ struct rkisp_isp_params_ops_v32 isp_params_ops_v32 = {
 	.vsm_enable = isp_vsm_enable,
 };
 
+#define ISP32_SHADOW_OTHERS(m, f) \
+	{ ISP32_MODULE_##m, offsetof(struct isp32_isp_params_cfg, others.f), \
+	  sizeof_field(struct isp32_isp_params_cfg, others.f) }
+#define ISP32_SHADOW_MEAS(m, f) \
+	{ ISP32_MODULE_##m, offsetof(struct isp32_isp_params_cfg, meas.f), \
+	  sizeof_field(struct isp32_isp_params_cfg, meas.f) }
+
+/*
+ * Modules whose register programming depends only on their own config
+ * block, so an identical block can be skipped. Not listed: hdrmge/drc
+ * (also programmed at shadow time), gain (uses other module enables),
+ * ldch/cac (mesh buffer handoff) and rawae0/rawae3 (shared with af).
+ */
+static const struct {
+	u64 module;
+	u32 offset;
+	u32 size;
+} isp32_shadow_tbl[] = {
+	ISP32_SHADOW_OTHERS(LSC, lsc_cfg),
+	ISP32_SHADOW_OTHERS(DPCC, dpcc_cfg),
+	ISP32_SHADOW_OTHERS(BLS, bls_cfg),
+	ISP32_SHADOW_OTHERS(SDG, sdg_cfg),
+	ISP32_SHADOW_OTHERS(AWB_GAIN, awb_gain_cfg),
+	ISP32_SHADOW_OTHERS(DEBAYER, debayer_cfg),
+	ISP32_SHADOW_OTHERS(CCM, ccm_cfg),
+	ISP32_SHADOW_OTHERS(GOC, gammaout_cfg),
+	ISP32_SHADOW_OTHERS(CSM, csm_cfg),
+	ISP32_SHADOW_OTHERS(CGC, cgc_cfg),
+	ISP32_SHADOW_OTHERS(CPROC, cproc_cfg),
+	ISP32_SHADOW_OTHERS(IE, ie_cfg),
+	ISP32_SHADOW_OTHERS(GIC, gic_cfg),
+	ISP32_SHADOW_OTHERS(DHAZ, dhaz_cfg),
+	ISP32_SHADOW_OTHERS(3DLUT, isp3dlut_cfg),
+	ISP32_SHADOW_OTHERS(YNR, ynr_cfg),
+	ISP32_SHADOW_OTHERS(CNR, cnr_cfg),
+	ISP32_SHADOW_OTHERS(SHARP, sharp_cfg),
+	ISP32_SHADOW_OTHERS(BAYNR, baynr_cfg),
+	ISP32_SHADOW_OTHERS(BAY3D, bay3d_cfg),
+	ISP32_SHADOW_OTHERS(VSM, vsm_cfg),
+	ISP32_SHADOW_MEAS(RAWAF, rawaf),
+	ISP32_SHADOW_MEAS(RAWAE1, rawae1),
+	ISP32_SHADOW_MEAS(RAWAE2, rawae2),
+	ISP32_SHADOW_MEAS(RAWHIST0, rawhist0),
+	ISP32_SHADOW_MEAS(RAWHIST1, rawhist1),
+	ISP32_SHADOW_MEAS(RAWHIST2, rawhist2),
+	ISP32_SHADOW_MEAS(RAWHIST3, rawhist3),
+	ISP32_SHADOW_MEAS(RAWAWB, rawawb),
+};
+
+static void
+isp32_params_shadow_reset(struct rkisp_isp_params_vdev *params_vdev)
+{
+	struct rkisp_isp_params_val_v32 *priv_val = params_vdev->priv_val;
+
+	memset(priv_val->shadow_valid, 0, sizeof(priv_val->shadow_valid));
+}
+
+/*
+ * Drop the modules of @mask whose config is identical to the one last
+ * written to unite @id, and record the others as the new reference.
+ * Modules with an enable update in the same params are always written
+ * since some enable callbacks change state their config depends on.
+ */
+static u64
+isp32_params_shadow_check(struct rkisp_isp_params_vdev *params_vdev,
+			  const struct isp32_isp_params_cfg *new_params,
+			  u64 module_cfg_update, u64 mask, u32 id)
+{
+	struct rkisp_isp_params_val_v32 *priv_val = params_vdev->priv_val;
+	struct isp32_isp_params_cfg *shadow;
+	u64 *valid = &priv_val->shadow_valid[id];
+	const u8 *src, *dst;
+	u64 module;
+	u32 i;
+
+	if (!priv_val->shadow)
+		return module_cfg_update;
+	shadow = priv_val->shadow + id;
+	if (module_cfg_update & ISP32_MODULE_FORCE)
+		*valid &= ~mask;
+	*valid &= ~new_params->module_en_update;
+
+	for (i = 0; i < ARRAY_SIZE(isp32_shadow_tbl); i++) {
+		module = isp32_shadow_tbl[i].module;
+		if (!(module & mask & module_cfg_update))
+			continue;
+		src = (const u8 *)new_params + isp32_shadow_tbl[i].offset;
+		dst = (u8 *)shadow + isp32_shadow_tbl[i].offset;
+		if ((*valid & module) &&
+		    !memcmp(src, dst, isp32_shadow_tbl[i].size)) {
+			module_cfg_update &= ~module;
+			priv_val->mod_skip_cnt++;
+			continue;
+		}
+		memcpy((u8 *)dst, src, isp32_shadow_tbl[i].size);
+		*valid |= module;
+		priv_val->mod_wr_cnt++;
+	}
+	return module_cfg_update;
+}
+
+#define ISP32_SHADOW_OTHERS_MASK \
+	(ISP32_MODULE_LSC | ISP32_MODULE_DPCC | ISP32_MODULE_BLS | \
+	 ISP32_MODULE_SDG | ISP32_MODULE_AWB_GAIN | ISP32_MODULE_DEBAYER | \
+	 ISP32_MODULE_CCM | ISP32_MODULE_GOC | ISP32_MODULE_CSM | \
+	 ISP32_MODULE_CGC | ISP32_MODULE_CPROC | ISP32_MODULE_IE | \
+	 ISP32_MODULE_GIC | ISP32_MODULE_DHAZ | ISP32_MODULE_3DLUT | \
+	 ISP32_MODULE_YNR | ISP32_MODULE_CNR | ISP32_MODULE_SHARP | \
+	 ISP32_MODULE_BAYNR | ISP32_MODULE_BAY3D | ISP32_MODULE_VSM)
+#define ISP32_SHADOW_MEAS_MASK \
+	(ISP32_MODULE_RAWAF | ISP32_MODULE_RAWAE1 | ISP32_MODULE_RAWAE2 | \
+	 ISP32_MODULE_RAWHIST0 | ISP32_MODULE_RAWHIST1 | \
+	 ISP32_MODULE_RAWHIST2 | ISP32_MODULE_RAWHIST3 | ISP32_MODULE_RAWAWB)
+
 static __maybe_unused
 void __isp_isr_other_config(struct rkisp_isp_params_vdev *params_vdev,
 			    const struct isp32_isp_params_cfg *new_params,
@@ -4066,6 +4191,10 @@ void __isp_isr_other_config(struct rkisp_isp_params_vdev *params_vdev,
 		return;
 	}
 
+	module_cfg_update = isp32_params_shadow_check(params_vdev, new_params,
+						      module_cfg_update,
+						      ISP32_SHADOW_OTHERS_MASK, id);
+
 	v4l2_dbg(4, rkisp_debug, &params_vdev->dev->v4l2_dev,
 		 "%s id:%d seq:%d module_cfg_update:0x%llx\n",
 		 __func__, id, new_params->frame_id, module_cfg_update);
@@ -4288,6 +4417,10 @@ void __isp_isr_meas_config(struct rkisp_isp_params_vdev *params_vdev,
 	if (type == RKISP_PARAMS_SHD)
 		return;
 
+	module_cfg_update = isp32_params_shadow_check(params_vdev, new_params,
+						      module_cfg_update,
+						      ISP32_SHADOW_MEAS_MASK, id);
+
 	v4l2_dbg(4, rkisp_debug, &params_vdev->dev->v4l2_dev,
 		 "%s id:%d seq:%d module_cfg_update:0x%llx\n",
 		 __func__, id, new_params->frame_id, module_cfg_update);
@@ -4954,6 +5087,7 @@ rkisp_params_first_cfg_v32(struct rkisp_isp_params_vdev *params_vdev)
 	priv_val->lsc_en = 0;
 	priv_val->mge_en = 0;
 	priv_val->lut3d_en = 0;
+	isp32_params_shadow_reset(params_vdev);
 	if (dev->is_bigmode)
 		rkisp_unite_set_bits(dev, ISP3X_ISP_CTRL1, 0,
 				     ISP3X_BIGMODE_MANUAL | ISP3X_BIGMODE_FORCE_EN, false);
@@ -5326,6 +5460,7 @@ rkisp_params_stream_stop_v32(struct rkisp_isp_params_vdev *params_vdev)
 	priv_val->buf_info_idx = -1;
 	for (i = 0; i < RKISP_INFO2DDR_BUF_MAX; i++)
 		rkisp_free_buffer(ispdev, &priv_val->buf_info[i]);
+	isp32_params_shadow_reset(params_vdev);
 }
 
 static void
@@ -5348,6 +5483,7 @@ rkisp_params_disable_isp_v32(struct rkisp_isp_params_vdev *params_vdev)
 	params_vdev->isp32_params->module_ens = 0;
 	params_vdev->isp32_params->module_en_update = 0x7ffffffffff;
 
+	isp32_params_shadow_reset(params_vdev);
 	for (i = 0; i < params_vdev->dev->unite_div; i++) {
 		__isp_isr_other_en(params_vdev, params_vdev->isp32_params, RKISP_PARAMS_ALL, i);
 		__isp_isr_meas_en(params_vdev, params_vdev->isp32_params, RKISP_PARAMS_ALL, i);
@@ -5395,6 +5531,7 @@ rkisp_params_cfg_v32(struct rkisp_isp_params_vdev *params_vdev,
 		     u32 frame_id, enum rkisp_params_type type)
 {
 	struct rkisp_device *dev = params_vdev->dev;
+	struct rkisp_isp_params_val_v32 *priv_val = params_vdev->priv_val;
 	struct isp32_isp_params_cfg *new_params = NULL;
 	struct rkisp_buffer *cur_buf = params_vdev->cur_buf;
 	int i;
@@ -5447,6 +5584,9 @@ rkisp_params_cfg_v32(struct rkisp_isp_params_vdev *params_vdev,
 		goto unlock;
 
 	new_params = (struct isp32_isp_params_cfg *)(cur_buf->vaddr[0]);
+	priv_val->reg_wr_cnt = 0;
+	priv_val->mod_wr_cnt = 0;
+	priv_val->mod_skip_cnt = 0;
 	for (i = 0; i < dev->unite_div; i++) {
 		__isp_isr_meas_config(params_vdev, new_params, type, i);
 		__isp_isr_other_config(params_vdev, new_params, type, i);
@@ -5456,6 +5596,13 @@ rkisp_params_cfg_v32(struct rkisp_isp_params_vdev *params_vdev,
 			new_params->module_cfg_update = 0;
 		new_params++;
 	}
+	if (type != RKISP_PARAMS_SHD) {
+		priv_val->frm_reg_wr_cnt = priv_val->reg_wr_cnt;
+		priv_val->frm_mod_wr_cnt = priv_val->mod_wr_cnt;
+		priv_val->frm_mod_skip_cnt = priv_val->mod_skip_cnt;
+		priv_val->total_mod_wr_cnt += priv_val->mod_wr_cnt;
+		priv_val->total_mod_skip_cnt += priv_val->mod_skip_cnt;
+	}
 	if (type != RKISP_PARAMS_IMD) {
 		vb2_buffer_done(&cur_buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
 		cur_buf = NULL;
@@ -5523,6 +5670,7 @@ static struct rkisp_isp_params_ops rkisp_isp_params_ops_tbl = {
 	.check_bigmode = rkisp_params_check_bigmode_v32,
 	.info2ddr_cfg = rkisp_params_info2ddr_cfg_v32,
 	.get_bay3d_buffd = rkisp_params_get_bay3d_buffd_v32,
+	.reset_shadow = isp32_params_shadow_reset,
 };
 
 int rkisp_init_params_vdev_v32(struct rkisp_isp_params_vdev *params_vdev)
@@ -5542,6 +5690,8 @@ int rkisp_init_params_vdev_v32(struct rkisp_isp_params_vdev *params_vdev)
 		kfree(priv_val);
 		return -ENOMEM;
 	}
+	/* no delta filtering without the shadow, not fatal */
+	priv_val->shadow = vzalloc(size);
 
 	params_vdev->priv_val = (void *)priv_val;
 	params_vdev->ops = &rkisp_isp_params_ops_tbl;
@@ -5564,6 +5714,7 @@ void rkisp_uninit_params_vdev_v32(struct rkisp_isp_params_vdev *params_vdev)
 		vfree(params_vdev->isp32_params);
 	if (priv_val) {
 		tasklet_kill(&priv_val->lsc_tasklet);
+		vfree(priv_val->shadow);
 		kfree(priv_val);
 		params_vdev->priv_val = NULL;
 	}
@@ -209,6 +209,19 @@ struct rkisp_isp_params_val_v32 {
 	bool mge_en;
 	bool lut3d_en;
 	bool bay3d_en;
+	/* last applied config of each module, see isp32_params_shadow_check() */
+	struct isp32_isp_params_cfg *shadow;
+	u64 shadow_valid[ISP_UNITE_MAX];
+
+	u32 reg_wr_cnt;
+	u32 mod_wr_cnt;
+	u32 mod_skip_cnt;
+	u32 frm_reg_wr_cnt;
+	u32 frm_mod_wr_cnt;
+	u32 frm_mod_skip_cnt;
+	u64 total_mod_wr_cnt;
+	u64 total_mod_skip_cnt;
+
 	bool is_bigmode;
 	bool is_lo8x8;
 	bool is_sram;
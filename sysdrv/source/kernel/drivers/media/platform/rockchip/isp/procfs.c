@@ -826,6 +826,10 @@ static void isp32_show(struct rkisp_device *dev, struct seq_file *p)
 		   "\t   expd(%d %d) ynr(%d %d)\n",
 		   "DEBUG4", val,
 		   !!(val & BIT(3)), !!(val & BIT(2)), !!(val & BIT(1)), !!(val & BIT(0)));
+	seq_printf(p, "%-10s frame(cfg:%d skip:%d reg:%d) total(cfg:%llu skip:%llu)\n",
+		   "PARAMS", priv->frm_mod_wr_cnt, priv->frm_mod_skip_cnt,
+		   priv->frm_reg_wr_cnt, priv->total_mod_wr_cnt,
+		   priv->total_mod_skip_cnt);
 }
 
 static int isp_show(struct seq_file *p, void *v)
@@ -883,6 +887,19 @@ static int isp_show(struct seq_file *p, void *v)
 		seq_printf(p, "\t   hw link:%d idle:%d vir(mode:%d index:%d)\n",
 			   dev->hw_dev->dev_link_num, dev->hw_dev->is_idle,
 			   dev->multi_mode, dev->multi_index);
+		if (!dev->hw_dev->is_single) {
+			struct rkisp_sched *sched = &dev->sched;
+
+			seq_printf(p, "\t   sched(run:%llu late:%llu wait avg:%lluus max:%lluus)"
+				   " switch:%llu reg(wr:%llu skip:%llu)\n",
+				   sched->run_cnt, sched->late_cnt,
+				   sched->run_cnt ?
+				   div_u64(sched->wait_sum, sched->run_cnt) / 1000 : 0,
+				   div_u64(sched->wait_max, 1000),
+				   dev->hw_dev->sched_switch_cnt,
+				   dev->hw_dev->reg_diff_wr_cnt,
+				   dev->hw_dev->reg_diff_skip_cnt);
+		}
 	} else {
 		seq_printf(p, "%-10s frame:%d state:%s time:%dms v-blank:%dus\n",
 			   "Isp online",
@@ -1110,10 +1127,12 @@ static ssize_t rkisp_proc_write(struct file *file,
 			ret = kstrtou32(p_val, 16, &val);
 			if (ret)
 				goto end;
-			if (dev->procfs.mode & RKISP_PROCFS_FIL_SW)
+			if (dev->procfs.mode & RKISP_PROCFS_FIL_SW) {
 				writel(val, dev->hw_dev->base_addr + reg);
-			else
+				rkisp_hw_reg_mirror_drop(dev->hw_dev, reg, false);
+			} else {
 				rkisp_write(dev, reg, val, false);
+			}
 
 			tmp = strstr(p_reg, "=");
 		}
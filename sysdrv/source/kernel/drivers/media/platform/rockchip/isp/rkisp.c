@@ -680,7 +680,7 @@ void rkisp_trigger_read_back(struct rkisp_device *dev, u8 dma2frm, u32 mode, boo
 		rkisp_update_regs(dev, ISP_GAMMA_OUT_CTRL, MAIN_RESIZE_CTRL);
 		rkisp_update_regs(dev, MI_RD_CTRL2, ISP_LSC_CTRL);
 		rkisp_update_regs(dev, MI_MP_WR_Y_BASE, MI_WR_CTRL2 - 4);
-		rkisp_update_regs(dev, ISP_LSC_XGRAD_01, ISP_RAWAWB_RAM_DATA);
+		rkisp_update_regs_diff(dev, ISP_LSC_XGRAD_01, ISP_RAWAWB_RAM_DATA);
 		if (dev->isp_ver == ISP_V20 &&
 		    (rkisp_read(dev, ISP_DHAZ_CTRL, false) & ISP_DHAZ_ENMUX ||
 		     rkisp_read(dev, ISP_HDRTMO_CTRL, false) & ISP_HDRTMO_EN)) {
@@ -908,6 +908,125 @@ static void rkisp_fast_switch_rx_buf(struct rkisp_device *dev, bool is_current)
 	}
 }
 
+#define RKISP_SCHED_SCALE	(1000ULL << 10)
+#define RKISP_SCHED_DEF_FPS	30
+/* consecutive picks a late frame may take from the fair choice */
+#define RKISP_SCHED_LATE_MAX	2
+
+static u32 rkisp_sched_fps_get(struct rkisp_device *isp)
+{
+	u32 fps = 0;
+
+	if (isp->dev_id < DEV_MAX)
+		fps = rkisp_sched_fps[isp->dev_id];
+	if (!fps)
+		fps = isp->hw_dev->isp_size[isp->dev_id].fps;
+	return fps;
+}
+
+/* vtime cost of one frame, inverse of the fps target as weight */
+static u64 rkisp_sched_quantum(struct rkisp_device *isp)
+{
+	u32 fps = rkisp_sched_fps_get(isp);
+
+	return div_u64(RKISP_SCHED_SCALE, fps ? fps : RKISP_SCHED_DEF_FPS);
+}
+
+/*
+ * latest start of the oldest queued frame to keep up with its fps target.
+ * Readback frames are only queued at frame end, about one period after
+ * sof, so the budget is one more period from there.
+ */
+static u64 rkisp_sched_deadline(struct rkisp_device *isp)
+{
+	struct isp2x_csi_trigger t;
+	unsigned long lock_flags = 0;
+	u32 fps = rkisp_sched_fps_get(isp);
+	int ret;
+
+	if (!fps)
+		return 0;
+	spin_lock_irqsave(&isp->rdbk_lock, lock_flags);
+	ret = kfifo_out_peek(&isp->rdbk_kfifo, &t, sizeof(t));
+	spin_unlock_irqrestore(&isp->rdbk_lock, lock_flags);
+	if (ret != sizeof(t) || !t.sof_timestamp)
+		return 0;
+	return t.sof_timestamp + 2 * div_u64(NSEC_PER_SEC, fps);
+}
+
+/*
+ * Pick the virtual isp to read back next for multi sensor, with rdbk_lock
+ * of hw held. A frame past its latency target goes first, earliest one
+ * first, but only for RKISP_SCHED_LATE_MAX picks in a row so that an
+ * overload can't starve the others. Otherwise the lowest vtime goes, which
+ * shares the hardware by fps target. The previous isp keeps running while
+ * at most one frame ahead, to save the context switch.
+ */
+static int rkisp_sched_pick(struct rkisp_hw_dev *hw, const int *len)
+{
+	struct rkisp_device *isp;
+	u64 now, deadline, min_deadline = U64_MAX;
+	u64 min_vtime = U64_MAX;
+	int i, id = -1, late_id = -1, pre = hw->pre_dev_id;
+
+	for (i = 0; i < hw->dev_num; i++) {
+		isp = hw->isp[i];
+		if (!len[i]) {
+			if (isp)
+				isp->sched.is_wait = false;
+			continue;
+		}
+		/* no credit saved while idle */
+		if (!isp->sched.is_wait && isp->sched.vtime < hw->sched_vclock)
+			isp->sched.vtime = hw->sched_vclock;
+		isp->sched.is_wait = true;
+		if (isp->sched.vtime < min_vtime) {
+			min_vtime = isp->sched.vtime;
+			id = i;
+		}
+		/* same clock as the sof timestamp of the frames */
+		now = rkisp_time_get_ns(isp);
+		deadline = rkisp_sched_deadline(isp);
+		if (deadline && deadline < now && deadline < min_deadline) {
+			min_deadline = deadline;
+			late_id = i;
+		}
+	}
+
+	if (late_id >= 0 && late_id != id &&
+	    hw->sched_late_run < RKISP_SCHED_LATE_MAX) {
+		hw->sched_late_run++;
+		hw->isp[late_id]->sched.late_cnt++;
+		return late_id;
+	}
+	hw->sched_late_run = 0;
+	if (late_id >= 0 && late_id == id)
+		return id;
+	if (pre >= 0 && pre < hw->dev_num && len[pre] && pre != id &&
+	    hw->isp[pre]->sched.vtime <= min_vtime + rkisp_sched_quantum(hw->isp[pre]))
+		id = pre;
+	return id;
+}
+
+static void rkisp_sched_run(struct rkisp_device *isp, u64 sof_timestamp)
+{
+	struct rkisp_hw_dev *hw = isp->hw_dev;
+	u64 now = rkisp_time_get_ns(isp), wait;
+
+	if (hw->pre_dev_id != isp->dev_id)
+		hw->sched_switch_cnt++;
+	hw->sched_vclock = max(hw->sched_vclock, isp->sched.vtime);
+	isp->sched.vtime += rkisp_sched_quantum(isp);
+	isp->sched.is_wait = false;
+	isp->sched.run_cnt++;
+	if (sof_timestamp && now > sof_timestamp) {
+		wait = now - sof_timestamp;
+		isp->sched.wait_sum += wait;
+		if (isp->sched.wait_max < wait)
+			isp->sched.wait_max = wait;
+	}
+}
+
 static void rkisp_rdbk_trigger_handle(struct rkisp_device *dev, u32 cmd)
 {
 	struct rkisp_hw_dev *hw = dev->hw_dev;
@@ -959,21 +1078,22 @@ static void rkisp_rdbk_trigger_handle(struct rkisp_device *dev, u32 cmd)
 		    (isp && (!(isp->isp_state & ISP_START) || isp->is_suspend)))
 			continue;
 		rkisp_rdbk_trigger_event(isp, T_CMD_LEN, &len[i]);
-		if (max < len[i]) {
+		if (max < len[i])
 			max = len[i];
-			id = i;
-		}
 	}
 
 	/* wait 2 frame to start isp for fast */
 	if (dev->is_rtt_first && max == 1 && !atomic_read(&dev->isp_sdev.frm_sync_seq))
 		goto end;
 
-	if (max) {
+	if (max)
+		id = rkisp_sched_pick(hw, len);
+	if (max && id >= 0) {
 		isp = hw->isp[id];
 		v4l2_dbg(2, rkisp_debug, &isp->v4l2_dev,
-			 "trigger fifo len:%d\n", max);
+			 "trigger fifo len:%d\n", len[id]);
 		rkisp_rdbk_trigger_event(isp, T_CMD_DEQUEUE, &t);
+		rkisp_sched_run(isp, t.sof_timestamp);
 		isp->dmarx_dev.pre_frame = isp->dmarx_dev.cur_frame;
 		if (t.frame_id > isp->dmarx_dev.pre_frame.id &&
 		    t.frame_id - isp->dmarx_dev.pre_frame.id > 1)
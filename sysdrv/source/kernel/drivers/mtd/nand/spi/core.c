@@ -12,6 +12,7 @@
 #include <linux/device.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mtd/bbt_store.h>
 #include <linux/mtd/spinand.h>
@@ -21,6 +22,70 @@
 #include <linux/spi/spi.h>
 #include <linux/spi/spi-mem.h>
 
+/*
+ * Parts that implement the cache read command set: READ CACHE SEQUENTIAL
+ * moves the page in the data register to the cache and starts loading the
+ * next page, READ CACHE END moves the last page without loading another.
+ * The cache can then be read out while the array read of the following
+ * page (tR) is in progress.
+ *
+ * A part without these commands ignores them and keeps returning the old
+ * cache contents, so only list parts whose datasheet documents them.
+ */
+struct spinand_cache_read {
+	u8 mfr_id;
+	u8 dev_id;
+	u8 seq_opcode;
+	u8 end_opcode;
+};
+
+static const struct spinand_cache_read spinand_cache_read_table[] = {
+	{ 0x2c, 0x14, 0x31, 0x3f },	/* Micron MT29F1G01ABAFD */
+	{ 0x2c, 0x24, 0x31, 0x3f },	/* Micron MT29F2G01ABAGD */
+	{ 0x2c, 0x25, 0x31, 0x3f },	/* Micron MT29F2G01ABBGD */
+	{ 0x2c, 0x34, 0x31, 0x3f },	/* Micron MT29F4G01ABAFD */
+	{ 0x2c, 0x35, 0x31, 0x3f },	/* Micron MT29F4G01ABBFD */
+};
+
+static bool cache_read = true;
+module_param(cache_read, bool, 0644);
+MODULE_PARM_DESC(cache_read, "Use sequential cache read for multi-page reads when supported");
+
+static atomic64_t spinand_stat_pages;
+static atomic64_t spinand_stat_cache_pages;
+static atomic64_t spinand_stat_bytes;
+static atomic64_t spinand_stat_ns;
+
+static int spinand_read_stats_get(char *buffer, const struct kernel_param *kp)
+{
+	u64 bytes = atomic64_read(&spinand_stat_bytes);
+	u64 ns = atomic64_read(&spinand_stat_ns);
+
+	return scnprintf(buffer, PAGE_SIZE,
+			 "pages %lld cache_read_pages %lld bytes %llu time_us %llu speed %lluKB/s\n",
+			 atomic64_read(&spinand_stat_pages),
+			 atomic64_read(&spinand_stat_cache_pages),
+			 bytes, div_u64(ns, NSEC_PER_USEC),
+			 ns ? div64_u64(bytes * 1000000ULL, ns) : 0);
+}
+
+static int spinand_read_stats_set(const char *val, const struct kernel_param *kp)
+{
+	atomic64_set(&spinand_stat_pages, 0);
+	atomic64_set(&spinand_stat_cache_pages, 0);
+	atomic64_set(&spinand_stat_bytes, 0);
+	atomic64_set(&spinand_stat_ns, 0);
+
+	return 0;
+}
+
+static const struct kernel_param_ops spinand_read_stats_ops = {
+	.set = spinand_read_stats_set,
+	.get = spinand_read_stats_get,
+};
+module_param_cb(read_stats, &spinand_read_stats_ops, NULL, 0644);
+MODULE_PARM_DESC(read_stats, "mtd read statistics, write to reset");
+
 static int spinand_read_reg_op(struct spinand_device *spinand, u8 reg, u8 *val)
 {
 	struct spi_mem_op op = SPINAND_GET_FEATURE_OP(reg,
@@ -555,6 +620,86 @@ static int spinand_read_page(struct spinand_device *spinand,
 	return spinand_check_ecc_status(spinand, status);
 }
 
+static const struct spinand_cache_read *
+spinand_get_cache_read(struct spinand_device *spinand)
+{
+	unsigned int i;
+
+	if (!cache_read)
+		return NULL;
+
+	for (i = 0; i < ARRAY_SIZE(spinand_cache_read_table); i++) {
+		if (spinand_cache_read_table[i].mfr_id == spinand->id.data[0] &&
+		    spinand_cache_read_table[i].dev_id == spinand->id.data[1])
+			return &spinand_cache_read_table[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Read one page of a cache read sequence.  The first page is loaded into
+ * the data register with PAGE READ, then each page is moved to the cache
+ * with READ CACHE SEQUENTIAL (which starts loading the next page) or, for
+ * the last page of the sequence, READ CACHE END.  The status polled after
+ * the move carries the ECC result of the page now in the cache.  @in_seq
+ * tracks whether the chip is left in a sequence that needs READ CACHE END.
+ */
+static int spinand_read_page_cached(struct spinand_device *spinand,
+				    const struct spinand_cache_read *cr,
+				    const struct nand_page_io_req *req,
+				    bool ecc_enabled, bool *in_seq, bool last)
+{
+	struct spi_mem_op op = SPI_MEM_OP(SPI_MEM_OP_CMD(last ? cr->end_opcode :
+								cr->seq_opcode,
+							 1),
+					  SPI_MEM_OP_NO_ADDR,
+					  SPI_MEM_OP_NO_DUMMY,
+					  SPI_MEM_OP_NO_DATA);
+	u8 status;
+	int ret;
+
+	if (!*in_seq) {
+		ret = spinand_load_page_op(spinand, req);
+		if (ret)
+			return ret;
+
+		ret = spinand_wait(spinand, NULL);
+		if (ret)
+			return ret;
+	}
+
+	ret = spi_mem_exec_op(spinand->spimem, &op);
+	if (ret)
+		return ret;
+	*in_seq = !last;
+
+	ret = spinand_wait(spinand, &status);
+	if (ret)
+		return ret;
+
+	ret = spinand_read_from_cache_op(spinand, req);
+	if (ret)
+		return ret;
+
+	if (!ecc_enabled)
+		return 0;
+
+	return spinand_check_ecc_status(spinand, status);
+}
+
+static void spinand_cache_read_end(struct spinand_device *spinand,
+				   const struct spinand_cache_read *cr)
+{
+	struct spi_mem_op op = SPI_MEM_OP(SPI_MEM_OP_CMD(cr->end_opcode, 1),
+					  SPI_MEM_OP_NO_ADDR,
+					  SPI_MEM_OP_NO_DUMMY,
+					  SPI_MEM_OP_NO_DATA);
+
+	if (!spi_mem_exec_op(spinand->spimem, &op))
+		spinand_wait(spinand, NULL);
+}
+
 static int spinand_write_page(struct spinand_device *spinand,
 			      const struct nand_page_io_req *req)
 {
@@ -585,10 +730,14 @@ static int spinand_mtd_read(struct mtd_info *mtd, loff_t from,
 {
 	struct spinand_device *spinand = mtd_to_spinand(mtd);
 	struct nand_device *nand = mtd_to_nanddev(mtd);
-	unsigned int max_bitflips = 0;
+	const struct spinand_cache_read *cr = spinand_get_cache_read(spinand);
+	unsigned int pages_per_block = nanddev_pages_per_eraseblock(nand);
+	unsigned int max_bitflips = 0, npages = 0, ncached = 0;
 	struct nand_io_iter iter;
 	bool enable_ecc = false;
 	bool ecc_failed = false;
+	bool in_seq = false;
+	ktime_t start;
 	int ret = 0;
 
 	if (ops->mode != MTD_OPS_RAW && spinand->eccinfo.ooblayout)
@@ -596,16 +745,38 @@ static int spinand_mtd_read(struct mtd_info *mtd, loff_t from,
 
 	mutex_lock(&spinand->lock);
 
+	start = ktime_get();
 	nanddev_io_for_each_page(nand, NAND_PAGE_READ, from, ops, &iter) {
-		ret = spinand_select_target(spinand, iter.req.pos.target);
-		if (ret)
-			break;
+		/*
+		 * A cache read sequence runs until the last page of the
+		 * request or of the eraseblock, whichever comes first.
+		 */
+		bool more = iter.dataleft > iter.req.datalen ||
+			    iter.oobleft > iter.req.ooblen;
+		bool last = !more ||
+			    iter.req.pos.page + 1 >= pages_per_block;
+
+		if (!in_seq) {
+			ret = spinand_select_target(spinand,
+						    iter.req.pos.target);
+			if (ret)
+				break;
 
-		ret = spinand_ecc_enable(spinand, enable_ecc);
-		if (ret)
-			break;
+			ret = spinand_ecc_enable(spinand, enable_ecc);
+			if (ret)
+				break;
+		}
 
-		ret = spinand_read_page(spinand, &iter.req, enable_ecc);
+		if (cr && (in_seq || !last)) {
+			ret = spinand_read_page_cached(spinand, cr, &iter.req,
+						       enable_ecc, &in_seq,
+						       last);
+			ncached++;
+		} else {
+			ret = spinand_read_page(spinand, &iter.req,
+						enable_ecc);
+		}
+		npages++;
 		if (ret < 0 && ret != -EBADMSG)
 			break;
 
@@ -622,8 +793,19 @@ static int spinand_mtd_read(struct mtd_info *mtd, loff_t from,
 		ops->oobretlen += iter.req.ooblen;
 	}
 
+	/* Don't leave the chip in cache read mode after a failure */
+	if (in_seq && ret)
+		spinand_cache_read_end(spinand, cr);
+
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		     &spinand_stat_ns);
+
 	mutex_unlock(&spinand->lock);
 
+	atomic64_add(npages, &spinand_stat_pages);
+	atomic64_add(ncached, &spinand_stat_cache_pages);
+	atomic64_add(ops->retlen + ops->oobretlen, &spinand_stat_bytes);
+
 	if (ecc_failed && !ret)
 		ret = -EBADMSG;
 
@@ -74,6 +74,8 @@
 #include <linux/crc32.h>
 #include <linux/math64.h>
 #include <linux/random.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include "ubi.h"
 
 static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
@@ -927,30 +929,79 @@ static bool vol_ignored(int vol_id)
 }
 
 /**
- * scan_peb - scan and process UBI headers of a PEB.
+ * struct ubi_scan_peb - UBI headers of a PEB as read by the scan.
+ * @bad: return code of ubi_io_is_bad()
+ * @ec_ret: return code of ubi_io_read_ec_hdr()
+ * @vid_ret: return code of ubi_io_read_vid_hdr()
+ * @ech: the EC header, valid unless @ec_ret is an error or %UBI_IO_FF*
+ * @vidh: the VID header, valid if it was read
+ *
+ * Reading the headers has no side effects on the attaching information, so
+ * it can be done ahead and in parallel, see scan_read_window().
+ */
+struct ubi_scan_peb {
+	int bad;
+	int ec_ret;
+	int vid_ret;
+	struct ubi_ec_hdr ech;
+	struct ubi_vid_hdr vidh;
+};
+
+/**
+ * scan_read_peb - read the UBI headers of a PEB.
+ * @ubi: UBI device description object
+ * @ech: buffer of @ubi->ec_hdr_alsize bytes to read the EC header into
+ * @vidb: buffer to read the VID header into
+ * @pnum: the physical eraseblock number
+ * @sp: where to store the headers and read results
+ */
+static void scan_read_peb(struct ubi_device *ubi, struct ubi_ec_hdr *ech,
+			  struct ubi_vid_io_buf *vidb, int pnum,
+			  struct ubi_scan_peb *sp)
+{
+	sp->ec_ret = 0;
+	sp->vid_ret = 0;
+
+	sp->bad = ubi_io_is_bad(ubi, pnum);
+	if (sp->bad)
+		return;
+
+	sp->ec_ret = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	if (sp->ec_ret < 0 || sp->ec_ret == UBI_IO_FF ||
+	    sp->ec_ret == UBI_IO_FF_BITFLIPS)
+		return;
+	memcpy(&sp->ech, ech, sizeof(sp->ech));
+
+	sp->vid_ret = ubi_io_read_vid_hdr(ubi, pnum, vidb, 0);
+	if (sp->vid_ret >= 0)
+		memcpy(&sp->vidh, ubi_get_vid_hdr(vidb), sizeof(sp->vidh));
+}
+
+/**
+ * scan_process_peb - process the UBI headers of a PEB.
  * @ubi: UBI device description object
  * @ai: attaching information
  * @pnum: the physical eraseblock number
+ * @sp: headers of @pnum read by scan_read_peb()
  * @fast: true if we're scanning for a Fastmap
  *
- * This function reads UBI headers of PEB @pnum, checks them, and adds
- * information about this PEB to the corresponding list or RB-tree in the
- * "attaching info" structure. Returns zero if the physical eraseblock was
- * successfully handled and a negative error code in case of failure.
+ * This function checks the headers of PEB @pnum and adds information about
+ * this PEB to the corresponding list or RB-tree in the "attaching info"
+ * structure. Returns zero if the physical eraseblock was successfully handled
+ * and a negative error code in case of failure.
  */
-static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
-		    int pnum, bool fast)
+static int scan_process_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
+			    int pnum, struct ubi_scan_peb *sp, bool fast)
 {
-	struct ubi_ec_hdr *ech = ai->ech;
-	struct ubi_vid_io_buf *vidb = ai->vidb;
-	struct ubi_vid_hdr *vidh = ubi_get_vid_hdr(vidb);
+	struct ubi_ec_hdr *ech = &sp->ech;
+	struct ubi_vid_hdr *vidh = &sp->vidh;
 	long long ec;
 	int err, bitflips = 0, vol_id = -1, ec_err = 0;
 
 	dbg_bld("scan PEB %d", pnum);
 
 	/* Skip bad physical eraseblocks */
-	err = ubi_io_is_bad(ubi, pnum);
+	err = sp->bad;
 	if (err < 0)
 		return err;
 	else if (err) {
@@ -958,7 +1009,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
-	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	err = sp->ec_ret;
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -1041,7 +1092,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	/* OK, we've done with the EC header, let's look at the VID header */
 
-	err = ubi_io_read_vid_hdr(ubi, pnum, vidb, 0);
+	err = sp->vid_ret;
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -1193,6 +1244,187 @@ adjust_mean_ec:
 	return 0;
 }
 
+/**
+ * scan_peb - scan and process UBI headers of a PEB.
+ * @ubi: UBI device description object
+ * @ai: attaching information
+ * @pnum: the physical eraseblock number
+ * @fast: true if we're scanning for a Fastmap
+ *
+ * This function reads UBI headers of PEB @pnum and processes them with
+ * scan_process_peb(). Returns zero if the physical eraseblock was
+ * successfully handled and a negative error code in case of failure.
+ */
+static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
+		    int pnum, bool fast)
+{
+	struct ubi_scan_peb sp;
+
+	scan_read_peb(ubi, ai->ech, ai->vidb, pnum, &sp);
+
+	return scan_process_peb(ubi, ai, pnum, &sp, fast);
+}
+
+/*
+ * PEBs whose headers are read in parallel before being processed in order.
+ * This bounds the memory used for the headers read ahead.
+ */
+#define UBI_SCAN_WINDOW		1024
+/* PEBs a scan thread claims at a time */
+#define UBI_SCAN_BATCH		16
+#define UBI_SCAN_MAX_THREADS	16
+/*
+ * Default minimum of scan threads. Even on a single CPU a second thread
+ * checks the headers it read while the other one sleeps waiting for the
+ * flash, so single-core parts gain from the parallel scan too.
+ */
+#define UBI_SCAN_MIN_THREADS	2
+
+/**
+ * struct ubi_scan_window - PEB headers read in parallel.
+ * @ubi: UBI device description object
+ * @peb: headers of PEBs @start to @end - 1
+ * @start: first PEB of the window
+ * @end: PEB after the last one of the window
+ * @next: next PEB to be claimed by a scan thread
+ * @running: number of scan threads still reading
+ * @done: completed when the last scan thread is done
+ */
+struct ubi_scan_window {
+	struct ubi_device *ubi;
+	struct ubi_scan_peb *peb;
+	int start;
+	int end;
+	atomic_t next;
+	atomic_t running;
+	struct completion done;
+};
+
+/**
+ * struct ubi_scan_thread - a thread reading PEB headers.
+ * @work: the work running the thread
+ * @win: the window being read
+ * @ech: EC header read buffer
+ * @vidb: VID header read buffer
+ */
+struct ubi_scan_thread {
+	struct work_struct work;
+	struct ubi_scan_window *win;
+	struct ubi_ec_hdr *ech;
+	struct ubi_vid_io_buf *vidb;
+};
+
+static void scan_thread_work(struct work_struct *work)
+{
+	struct ubi_scan_thread *st = container_of(work, struct ubi_scan_thread,
+						  work);
+	struct ubi_scan_window *win = st->win;
+	int pnum, end;
+
+	/* Claim batches of consecutive PEBs, which keeps reads sequential */
+	while ((pnum = atomic_fetch_add(UBI_SCAN_BATCH, &win->next)) <
+	       win->end) {
+		end = min(pnum + UBI_SCAN_BATCH, win->end);
+		for (; pnum < end; pnum++) {
+			scan_read_peb(win->ubi, st->ech, st->vidb, pnum,
+				      &win->peb[pnum - win->start]);
+			cond_resched();
+		}
+	}
+
+	if (atomic_dec_and_test(&win->running))
+		complete(&win->done);
+}
+
+/**
+ * scan_read_window - read the headers of a window of PEBs in parallel.
+ * @win: the window to read
+ * @st: the scan threads
+ * @nthreads: number of scan threads
+ */
+static void scan_read_window(struct ubi_scan_window *win,
+			     struct ubi_scan_thread *st, int nthreads)
+{
+	int i;
+
+	atomic_set(&win->next, win->start);
+	atomic_set(&win->running, nthreads);
+	reinit_completion(&win->done);
+
+	for (i = 0; i < nthreads; i++)
+		queue_work(system_unbound_wq, &st[i].work);
+
+	wait_for_completion(&win->done);
+}
+
+/**
+ * scan_all_parallel - scan PEBs with several threads.
+ * @ubi: UBI device description object
+ * @ai: attach info object
+ * @start: start scanning at this PEB
+ * @nthreads: number of threads reading PEB headers
+ *
+ * The headers are read by @nthreads threads, a window of PEBs at a time, and
+ * then processed in PEB order by the caller. The resulting attaching
+ * information is the same as the one of a serial scan. Returns zero in case
+ * of success and a negative error code in case of failure.
+ */
+static int scan_all_parallel(struct ubi_device *ubi,
+			     struct ubi_attach_info *ai, int start,
+			     int nthreads)
+{
+	struct ubi_scan_window win = {};
+	struct ubi_scan_thread *st;
+	int err = -ENOMEM, i, pnum;
+
+	st = kcalloc(nthreads, sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return err;
+
+	for (i = 0; i < nthreads; i++) {
+		INIT_WORK(&st[i].work, scan_thread_work);
+		st[i].win = &win;
+		st[i].ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+		st[i].vidb = ubi_alloc_vid_buf(ubi, GFP_KERNEL);
+		if (!st[i].ech || !st[i].vidb)
+			goto out_free;
+	}
+
+	win.peb = vmalloc(array_size(UBI_SCAN_WINDOW, sizeof(*win.peb)));
+	if (!win.peb)
+		goto out_free;
+
+	win.ubi = ubi;
+	init_completion(&win.done);
+
+	err = 0;
+	for (win.start = start; win.start < ubi->peb_count && !err;
+	     win.start = win.end) {
+		win.end = min(win.start + UBI_SCAN_WINDOW, ubi->peb_count);
+		scan_read_window(&win, st, nthreads);
+
+		for (pnum = win.start; pnum < win.end; pnum++) {
+			cond_resched();
+
+			dbg_gen("process PEB %d", pnum);
+			err = scan_process_peb(ubi, ai, pnum,
+					       &win.peb[pnum - win.start],
+					       false);
+			if (err < 0)
+				break;
+		}
+	}
+
+	vfree(win.peb);
+out_free:
+	for (i = 0; i < nthreads; i++) {
+		ubi_free_vid_buf(st[i].vidb);
+		kfree(st[i].ech);
+	}
+	kfree(st);
+	return err;
+}
+
 /**
  * late_analysis - analyze the overall situation with PEB.
  * @ubi: UBI device description object
@@ -1374,10 +1606,11 @@ static void destroy_ai(struct ubi_attach_info *ai)
 static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		    int start)
 {
-	int err, pnum;
+	int err, pnum, nthreads;
 	struct rb_node *rb1, *rb2;
 	struct ubi_ainf_volume *av;
 	struct ubi_ainf_peb *aeb;
+	ktime_t scan_start;
 
 	err = -ENOMEM;
 
@@ -1389,16 +1622,36 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	if (!ai->vidb)
 		goto out_ech;
 
-	for (pnum = start; pnum < ubi->peb_count; pnum++) {
-		cond_resched();
-
-		dbg_gen("process PEB %d", pnum);
-		err = scan_peb(ubi, ai, pnum, false);
+	/*
+	 * The EC and VID headers of a PEB are still read with two separate
+	 * I/Os: merging them would bypass the bit-flip and corruption
+	 * handling of ubi_io_read_ec_hdr() and ubi_io_read_vid_hdr(). The
+	 * threads overlap those I/Os instead.
+	 */
+	nthreads = ubi->scan_threads;
+	if (!nthreads)
+		nthreads = max_t(int, num_online_cpus(), UBI_SCAN_MIN_THREADS);
+	nthreads = clamp(nthreads, 1, UBI_SCAN_MAX_THREADS);
+	scan_start = ktime_get();
+
+	if (nthreads > 1) {
+		err = scan_all_parallel(ubi, ai, start, nthreads);
 		if (err < 0)
 			goto out_vidh;
+	} else {
+		for (pnum = start; pnum < ubi->peb_count; pnum++) {
+			cond_resched();
+
+			dbg_gen("process PEB %d", pnum);
+			err = scan_peb(ubi, ai, pnum, false);
+			if (err < 0)
+				goto out_vidh;
+		}
 	}
 
-	ubi_msg(ubi, "scanning is finished");
+	ubi_msg(ubi, "scanning is finished, %d PEBs in %lld ms, %d thread(s)",
+		ubi->peb_count - start,
+		ktime_ms_delta(ktime_get(), scan_start), nthreads);
 
 	/* Calculate mean erase counter */
 	if (ai->ec_count)
@@ -25,6 +25,13 @@
  * to allow early creation of block devices on top of UBI volumes. Runtime
  * block creation/removal for UBI volumes is provided through two UBI ioctls:
  * UBI_IOCVOLCRBLK and UBI_IOCVOLRMBLK.
+ *
+ * Requests are served concurrently from an unbound workqueue. Each device
+ * keeps a few whole LEBs cached, so that the many small reads a compressed
+ * filesystem issues inside one LEB only hit the flash once, and the next LEB
+ * is read ahead when a reader moves through the second half of a cached one.
+ * Like the page cache above it, the LEB cache does not notice writes done to
+ * the volume through other UBI volume descriptors.
  */
 
 #include <linux/module.h>
@@ -41,6 +48,8 @@
 #include <linux/hdreg.h>
 #include <linux/scatterlist.h>
 #include <linux/idr.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
 #include <asm/div64.h>
 
 #include "ubi-media.h"
@@ -55,6 +64,10 @@
 /* Maximum number of comma-separated items in the 'block=' parameter */
 #define UBIBLOCK_PARAM_COUNT 2
 
+/* Default and maximum number of LEBs cached per device */
+#define UBIBLOCK_CACHE_LEBS 4
+#define UBIBLOCK_CACHE_MAX_LEBS 64
+
 struct ubiblock_param {
 	int ubi_num;
 	int vol_id;
@@ -66,6 +79,35 @@ struct ubiblock_pdu {
 	struct ubi_sgl usgl;
 };
 
+enum {
+	UBIBLOCK_CACHE_EMPTY,
+	UBIBLOCK_CACHE_FILLING,
+	UBIBLOCK_CACHE_VALID,
+};
+
+/**
+ * struct ubiblock_cache_entry - a cached LEB.
+ * @buf: LEB contents
+ * @lnum: cached logical eraseblock number
+ * @len: number of valid bytes in @buf
+ * @state: %UBIBLOCK_CACHE_EMPTY, %UBIBLOCK_CACHE_FILLING or
+ *         %UBIBLOCK_CACHE_VALID
+ * @users: number of readers using @buf, the entry is not reused while non-zero
+ * @gen: cache generation the entry was filled in
+ * @stamp: last access time, for LRU replacement
+ *
+ * Everything but @buf is protected by the device's @cache_lock.
+ */
+struct ubiblock_cache_entry {
+	void *buf;
+	int lnum;
+	int len;
+	int state;
+	int users;
+	unsigned int gen;
+	unsigned long stamp;
+};
+
 /* Numbers of elements set in the @ubiblock_param array */
 static int ubiblock_devs __initdata;
 
@@ -87,6 +129,20 @@ struct ubiblock {
 	struct mutex dev_mutex;
 	struct list_head list;
 	struct blk_mq_tag_set tag_set;
+
+	u64 used_bytes;
+	struct ubiblock_cache_entry *cache;
+	int cache_count;
+	unsigned int cache_gen;
+	unsigned long cache_clock;
+	spinlock_t cache_lock;
+	wait_queue_head_t cache_wait;
+	struct work_struct ra_work;
+	int ra_lnum;
+
+	atomic_long_t cache_hits;
+	atomic_long_t cache_misses;
+	atomic_long_t cache_readahead;
 };
 
 /* Linked list of all ubiblock instances */
@@ -96,6 +152,14 @@ static DEFINE_IDR(ubiblock_minor_idr);
 static DEFINE_MUTEX(devices_mutex);
 static int ubiblock_major;
 
+static int ubiblock_cache_lebs = UBIBLOCK_CACHE_LEBS;
+module_param_named(block_cache_lebs, ubiblock_cache_lebs, int, 0444);
+MODULE_PARM_DESC(block_cache_lebs, "Number of LEBs cached by each UBI block device, 0 disables the cache (default: 4, max: 64)");
+
+static bool ubiblock_readahead = true;
+module_param_named(block_readahead, ubiblock_readahead, bool, 0644);
+MODULE_PARM_DESC(block_readahead, "Read the next LEB ahead on sequential UBI block device reads (default: true)");
+
 static int __init ubiblock_set_param(const char *val,
 				     const struct kernel_param *kp)
 {
@@ -181,6 +245,209 @@ static struct ubiblock *find_dev_nolock(int ubi_num, int vol_id)
 	return NULL;
 }
 
+static struct ubiblock_cache_entry *
+ubiblock_cache_find(struct ubiblock *dev, int lnum)
+{
+	struct ubiblock_cache_entry *e;
+	int i;
+
+	for (i = 0; i < dev->cache_count; i++) {
+		e = &dev->cache[i];
+		if (e->state != UBIBLOCK_CACHE_EMPTY && e->lnum == lnum &&
+		    e->gen == dev->cache_gen)
+			return e;
+	}
+	return NULL;
+}
+
+static void ubiblock_cache_put(struct ubiblock *dev,
+			       struct ubiblock_cache_entry *e)
+{
+	spin_lock(&dev->cache_lock);
+	e->users--;
+	spin_unlock(&dev->cache_lock);
+}
+
+/**
+ * ubiblock_cache_get - get a cached copy of a LEB.
+ * @dev: ubiblock device
+ * @lnum: logical eraseblock number
+ * @hit: set to %true if the LEB was already cached (or being read)
+ *
+ * On a miss the least recently used idle entry is reused and filled from
+ * flash. Readers of a LEB which is being filled wait for it instead of
+ * reading it again. Returns %NULL if all entries are busy or the LEB could
+ * not be read, in which case the caller has to read from flash directly.
+ * The returned entry has to be released with ubiblock_cache_put().
+ */
+static struct ubiblock_cache_entry *
+ubiblock_cache_get(struct ubiblock *dev, int lnum, bool *hit)
+{
+	struct ubiblock_cache_entry *e, *victim = NULL;
+	int i, len, ret;
+
+	spin_lock(&dev->cache_lock);
+	e = ubiblock_cache_find(dev, lnum);
+	if (e) {
+		e->users++;
+		e->stamp = ++dev->cache_clock;
+		spin_unlock(&dev->cache_lock);
+
+		*hit = true;
+		wait_event(dev->cache_wait,
+			   READ_ONCE(e->state) != UBIBLOCK_CACHE_FILLING);
+		if (READ_ONCE(e->state) != UBIBLOCK_CACHE_VALID) {
+			ubiblock_cache_put(dev, e);
+			return NULL;
+		}
+		return e;
+	}
+
+	for (i = 0; i < dev->cache_count; i++) {
+		e = &dev->cache[i];
+		if (e->users)
+			continue;
+		if (!victim || e->stamp < victim->stamp)
+			victim = e;
+	}
+
+	*hit = false;
+	if (!victim) {
+		spin_unlock(&dev->cache_lock);
+		return NULL;
+	}
+
+	e = victim;
+	e->lnum = lnum;
+	e->gen = dev->cache_gen;
+	e->state = UBIBLOCK_CACHE_FILLING;
+	e->users = 1;
+	e->stamp = ++dev->cache_clock;
+	spin_unlock(&dev->cache_lock);
+
+	/* The last LEB of a static volume is only partially used */
+	len = min_t(u64, dev->leb_size,
+		    dev->used_bytes - (u64)lnum * dev->leb_size);
+	ret = ubi_leb_read(dev->desc, lnum, e->buf, 0, len, 0);
+
+	spin_lock(&dev->cache_lock);
+	e->len = len;
+	if (ret) {
+		e->state = UBIBLOCK_CACHE_EMPTY;
+		e->stamp = 0;
+	} else {
+		e->state = UBIBLOCK_CACHE_VALID;
+	}
+	spin_unlock(&dev->cache_lock);
+	wake_up_all(&dev->cache_wait);
+
+	if (ret) {
+		ubiblock_cache_put(dev, e);
+		return NULL;
+	}
+	return e;
+}
+
+/* Drop all cached LEBs, entries still in use are dropped once released */
+static void ubiblock_cache_invalidate(struct ubiblock *dev)
+{
+	struct ubiblock_cache_entry *e;
+	int i;
+
+	spin_lock(&dev->cache_lock);
+	dev->cache_gen++;
+	for (i = 0; i < dev->cache_count; i++) {
+		e = &dev->cache[i];
+		if (!e->users) {
+			e->state = UBIBLOCK_CACHE_EMPTY;
+			e->stamp = 0;
+		}
+	}
+	spin_unlock(&dev->cache_lock);
+}
+
+static void ubiblock_readahead_work(struct work_struct *work)
+{
+	struct ubiblock *dev = container_of(work, struct ubiblock, ra_work);
+	struct ubiblock_cache_entry *e;
+	bool hit;
+
+	e = ubiblock_cache_get(dev, dev->ra_lnum, &hit);
+	if (e) {
+		if (!hit)
+			atomic_long_inc(&dev->cache_readahead);
+		ubiblock_cache_put(dev, e);
+	}
+
+	spin_lock(&dev->cache_lock);
+	dev->ra_lnum = -1;
+	spin_unlock(&dev->cache_lock);
+}
+
+/* Queue a read of @lnum into the cache, unless one is already in flight */
+static void ubiblock_start_readahead(struct ubiblock *dev, int lnum)
+{
+	if ((u64)lnum * dev->leb_size >= dev->used_bytes)
+		return;
+
+	spin_lock(&dev->cache_lock);
+	if (dev->ra_lnum < 0 && !ubiblock_cache_find(dev, lnum)) {
+		dev->ra_lnum = lnum;
+		queue_work(dev->wq, &dev->ra_work);
+	}
+	spin_unlock(&dev->cache_lock);
+}
+
+/* Copy @len bytes to the current position of @usgl, like ubi_read_sg() */
+static void ubiblock_copy_to_sgl(struct ubi_sgl *usgl, const void *buf,
+				 int len)
+{
+	struct scatterlist *sg;
+	int to_copy;
+
+	while (len) {
+		sg = &usgl->sg[usgl->list_pos];
+		to_copy = min_t(int, len, sg->length - usgl->page_pos);
+		memcpy(sg_virt(sg) + usgl->page_pos, buf, to_copy);
+
+		buf += to_copy;
+		len -= to_copy;
+		usgl->page_pos += to_copy;
+		if (usgl->page_pos == sg->length) {
+			usgl->list_pos++;
+			usgl->page_pos = 0;
+		}
+	}
+}
+
+static int ubiblock_read_leb(struct ubiblock *dev, struct ubi_sgl *usgl,
+			     int leb, int offset, int len)
+{
+	struct ubiblock_cache_entry *e;
+	bool hit;
+
+	if (!dev->cache_count)
+		return ubi_read_sg(dev->desc, leb, usgl, offset, len);
+
+	e = ubiblock_cache_get(dev, leb, &hit);
+	atomic_long_inc(hit ? &dev->cache_hits : &dev->cache_misses);
+	if (!e)
+		return ubi_read_sg(dev->desc, leb, usgl, offset, len);
+
+	if (offset + len > e->len) {
+		ubiblock_cache_put(dev, e);
+		return ubi_read_sg(dev->desc, leb, usgl, offset, len);
+	}
+
+	ubiblock_copy_to_sgl(usgl, e->buf + offset, len);
+	ubiblock_cache_put(dev, e);
+
+	if (ubiblock_readahead && offset + len > dev->leb_size / 2)
+		ubiblock_start_readahead(dev, leb + 1);
+
+	return 0;
+}
+
 static int ubiblock_read(struct ubiblock_pdu *pdu)
 {
 	int ret, leb, offset, bytes_left, to_read;
@@ -204,7 +471,7 @@ static int ubiblock_read(struct ubiblock_pdu *pdu)
 		if (offset + to_read > dev->leb_size)
 			to_read = dev->leb_size - offset;
 
-		ret = ubi_read_sg(dev->desc, leb, &pdu->usgl, offset, to_read);
+		ret = ubiblock_read_leb(dev, &pdu->usgl, leb, offset, to_read);
 		if (ret < 0)
 			return ret;
 
@@ -266,6 +533,10 @@ static void ubiblock_release(struct gendisk *gd, fmode_t mode)
 	mutex_lock(&dev->dev_mutex);
 	dev->refcnt--;
 	if (dev->refcnt == 0) {
+		/* The volume may change while nobody has it open */
+		cancel_work_sync(&dev->ra_work);
+		dev->ra_lnum = -1;
+		ubiblock_cache_invalidate(dev);
 		ubi_close_volume(dev->desc);
 		dev->desc = NULL;
 	}
@@ -363,6 +634,93 @@ static int calc_disk_capacity(struct ubi_volume_info *vi, u64 *disk_capacity)
 	return 0;
 }
 
+static ssize_t cache_hits_show(struct device *d,
+			       struct device_attribute *attr, char *buf)
+{
+	struct ubiblock *dev = dev_to_disk(d)->private_data;
+
+	return sprintf(buf, "%lu\n", atomic_long_read(&dev->cache_hits));
+}
+static DEVICE_ATTR_RO(cache_hits);
+
+static ssize_t cache_misses_show(struct device *d,
+				 struct device_attribute *attr, char *buf)
+{
+	struct ubiblock *dev = dev_to_disk(d)->private_data;
+
+	return sprintf(buf, "%lu\n", atomic_long_read(&dev->cache_misses));
+}
+static DEVICE_ATTR_RO(cache_misses);
+
+static ssize_t cache_readahead_show(struct device *d,
+				    struct device_attribute *attr, char *buf)
+{
+	struct ubiblock *dev = dev_to_disk(d)->private_data;
+
+	return sprintf(buf, "%lu\n", atomic_long_read(&dev->cache_readahead));
+}
+static DEVICE_ATTR_RO(cache_readahead);
+
+static struct attribute *ubiblock_attrs[] = {
+	&dev_attr_cache_hits.attr,
+	&dev_attr_cache_misses.attr,
+	&dev_attr_cache_readahead.attr,
+	NULL,
+};
+
+static const struct attribute_group ubiblock_attr_group = {
+	.attrs = ubiblock_attrs,
+};
+
+static const struct attribute_group *ubiblock_attr_groups[] = {
+	&ubiblock_attr_group,
+	NULL,
+};
+
+static int ubiblock_cache_init(struct ubiblock *dev)
+{
+	int i, count;
+
+	spin_lock_init(&dev->cache_lock);
+	init_waitqueue_head(&dev->cache_wait);
+	INIT_WORK(&dev->ra_work, ubiblock_readahead_work);
+	dev->ra_lnum = -1;
+
+	count = clamp(ubiblock_cache_lebs, 0, UBIBLOCK_CACHE_MAX_LEBS);
+	if (!count)
+		return 0;
+
+	dev->cache = kcalloc(count, sizeof(*dev->cache), GFP_KERNEL);
+	if (!dev->cache)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		dev->cache[i].buf = vmalloc(dev->leb_size);
+		if (!dev->cache[i].buf)
+			goto out_free;
+	}
+	dev->cache_count = count;
+	return 0;
+
+out_free:
+	while (--i >= 0)
+		vfree(dev->cache[i].buf);
+	kfree(dev->cache);
+	dev->cache = NULL;
+	return -ENOMEM;
+}
+
+static void ubiblock_cache_free(struct ubiblock *dev)
+{
+	int i;
+
+	for (i = 0; i < dev->cache_count; i++)
+		vfree(dev->cache[i].buf);
+	kfree(dev->cache);
+	dev->cache = NULL;
+	dev->cache_count = 0;
+}
+
 int ubiblock_create(struct ubi_volume_info *vi)
 {
 	struct ubiblock *dev;
@@ -393,6 +751,11 @@ int ubiblock_create(struct ubi_volume_info *vi)
 	dev->ubi_num = vi->ubi_num;
 	dev->vol_id = vi->vol_id;
 	dev->leb_size = vi->usable_leb_size;
+	dev->used_bytes = vi->used_bytes;
+
+	ret = ubiblock_cache_init(dev);
+	if (ret)
+		goto out_free_dev;
 
 	/* Initialize the gendisk of this ubiblock device */
 	gd = alloc_disk(1);
@@ -443,9 +806,10 @@ int ubiblock_create(struct ubi_volume_info *vi)
 
 	/*
 	 * Create one workqueue per volume (per registered block device).
-	 * Rembember workqueues are cheap, they're not threads.
+	 * Rembember workqueues are cheap, they're not threads. It is unbound
+	 * so that requests are not serialized behind each other on one CPU.
 	 */
-	dev->wq = alloc_workqueue("%s", 0, 0, gd->disk_name);
+	dev->wq = alloc_workqueue("%s", WQ_UNBOUND, 0, gd->disk_name);
 	if (!dev->wq) {
 		ret = -ENOMEM;
 		goto out_free_queue;
@@ -454,7 +818,7 @@ int ubiblock_create(struct ubi_volume_info *vi)
 	list_add_tail(&dev->list, &ubiblock_devices);
 
 	/* Must be the last step: anyone can call file ops from now on */
-	add_disk(dev->gd);
+	device_add_disk(NULL, dev->gd, ubiblock_attr_groups);
 	dev_info(disk_to_dev(dev->gd), "created from ubi%d:%d(%s)",
 		 dev->ubi_num, dev->vol_id, vi->name);
 	mutex_unlock(&devices_mutex);
@@ -469,6 +833,7 @@ out_remove_minor:
 out_put_disk:
 	put_disk(dev->gd);
 out_free_dev:
+	ubiblock_cache_free(dev);
 	kfree(dev);
 out_unlock:
 	mutex_unlock(&devices_mutex);
@@ -485,6 +850,7 @@ static void ubiblock_cleanup(struct ubiblock *dev)
 	/* Finally destroy the blk queue */
 	blk_cleanup_queue(dev->rq);
 	blk_mq_free_tag_set(&dev->tag_set);
+	ubiblock_cache_free(dev);
 	dev_info(disk_to_dev(dev->gd), "released");
 	idr_remove(&ubiblock_minor_idr, dev->gd->first_minor);
 	put_disk(dev->gd);
@@ -556,6 +922,9 @@ static int ubiblock_resize(struct ubi_volume_info *vi)
 
 	mutex_lock(&dev->dev_mutex);
 
+	dev->used_bytes = vi->used_bytes;
+	ubiblock_cache_invalidate(dev);
+
 	if (get_capacity(dev->gd) != disk_capacity) {
 		set_capacity(dev->gd, disk_capacity);
 		dev_info(disk_to_dev(dev->gd), "resized to %lld bytes",
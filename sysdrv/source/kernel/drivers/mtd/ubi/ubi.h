@@ -454,6 +454,8 @@ struct ubi_debug_info {
  *                @vol->eba_tbl.
  * @ref_count: count of references on the UBI device
  * @image_seq: image sequence number recorded on EC headers
+ * @scan_threads: number of threads reading PEB headers when attaching by
+ *                scanning, %0 for the default (see scan_all())
  *
  * @rsvd_pebs: count of reserved physical eraseblocks
  * @avail_pebs: count of available physical eraseblocks
@@ -566,6 +568,7 @@ struct ubi_device {
 	spinlock_t volumes_lock;
 	int ref_count;
 	int image_seq;
+	int scan_threads;
 
 	int rsvd_pebs;
 	int avail_pebs;
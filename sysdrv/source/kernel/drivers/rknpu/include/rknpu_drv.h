@@ -161,6 +161,8 @@ struct rknpu_device {
 	void __iomem *nbuf_base_io;
 	struct rknpu_mm *sram_mm;
 	unsigned long power_put_delay;
+	unsigned long starve_ms;
+	struct rknpu_sched_stats sched_stats[RKNPU_JOB_PRIORITY_NUM];
 };
 
 struct rknpu_session {
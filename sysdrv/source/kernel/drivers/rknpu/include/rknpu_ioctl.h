@@ -103,9 +103,19 @@ enum e_rknpu_job_mode {
 	RKNPU_JOB_PINGPONG = 1 << 2,
 	RKNPU_JOB_FENCE_IN = 1 << 3,
 	RKNPU_JOB_FENCE_OUT = 1 << 4,
+	/* order the job by its deadline: submit time + timeout */
+	RKNPU_JOB_DEADLINE = 1 << 5,
 	RKNPU_JOB_MASK = RKNPU_JOB_PC | RKNPU_JOB_NONBLOCK |
 			 RKNPU_JOB_PINGPONG | RKNPU_JOB_FENCE_IN |
-			 RKNPU_JOB_FENCE_OUT
+			 RKNPU_JOB_FENCE_OUT | RKNPU_JOB_DEADLINE
+};
+
+/* job priority definitions, a smaller value is scheduled first */
+enum e_rknpu_job_priority {
+	RKNPU_JOB_PRIORITY_HIGH = 0,
+	RKNPU_JOB_PRIORITY_MEDIUM = 1,
+	RKNPU_JOB_PRIORITY_LOW = 2,
+	RKNPU_JOB_PRIORITY_NUM
 };
 
 /* action definitions */
@@ -247,7 +257,7 @@ struct rknpu_subcore_task {
  * @task_start: task start index
  * @task_number: task number
  * @task_counter: task counter
- * @priority: submit priority
+ * @priority: submit priority, see e_rknpu_job_priority
  * @task_obj_addr: address of task object
  * @regcfg_obj_addr: address of register config object
  * @task_base_addr: task base address
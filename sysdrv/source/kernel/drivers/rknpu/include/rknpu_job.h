@@ -26,6 +26,38 @@
 #define RKNPU_CORE1_MASK 0x02
 #define RKNPU_CORE2_MASK 0x04
 
+/* default time a queued job may be overtaken before it is boosted */
+#define RKNPU_JOB_STARVE_MS 100
+
+/**
+ * struct rknpu_sched_stats - per priority scheduling statistics
+ *
+ * @queued: jobs waiting in the todo lists
+ * @max_queued: high watermark of @queued
+ * @submitted: jobs submitted
+ * @completed: jobs completed
+ * @deadline_missed: jobs completed after their deadline
+ * @starve_boosted: jobs dispatched ahead of their order by starvation boost
+ * @total_wait_us: accumulated time from submit to first dispatch
+ * @max_wait_us: maximum time from submit to first dispatch
+ * @total_latency_us: accumulated time from submit to completion
+ * @max_latency_us: maximum time from submit to completion
+ *
+ * All fields are protected by &rknpu_device.irq_lock.
+ */
+struct rknpu_sched_stats {
+	uint32_t queued;
+	uint32_t max_queued;
+	uint64_t submitted;
+	uint64_t completed;
+	uint64_t deadline_missed;
+	uint64_t starve_boosted;
+	uint64_t total_wait_us;
+	uint64_t max_wait_us;
+	uint64_t total_latency_us;
+	uint64_t max_latency_us;
+};
+
 struct rknpu_job {
 	struct rknpu_device *rknpu_dev;
 	struct list_head head[RKNPU_MAX_CORES];
@@ -47,6 +79,11 @@ struct rknpu_job {
 	ktime_t hw_recoder_time;
 	ktime_t commit_pc_time;
 	atomic_t submit_count[RKNPU_MAX_CORES];
+	int priority;
+	ktime_t deadline;
+	/* protected by rknpu_device.irq_lock */
+	bool queued;
+	int dispatched;
 };
 
 irqreturn_t rknpu_core0_irq_handler(int irq, void *data);
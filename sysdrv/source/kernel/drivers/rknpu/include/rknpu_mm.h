@@ -8,23 +8,39 @@
 #define __LINUX_RKNPU_MM_H
 
 #include <linux/mutex.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
 #include <linux/seq_file.h>
 #include <linux/iommu.h>
 #include <linux/iova.h>
 
 #include "rknpu_drv.h"
 
+/*
+ * Free space is kept as extents of contiguous chunks in two rbtrees: one
+ * ordered by address to coalesce neighbours on free, and one ordered by
+ * size to find the best fit on alloc.
+ */
 struct rknpu_mm {
-	void *bitmap;
+	struct rb_root free_by_addr;
+	struct rb_root free_by_size;
+	struct kmem_cache *obj_cache;
 	struct mutex lock;
 	unsigned int chunk_size;
 	unsigned int total_chunks;
 	unsigned int free_chunks;
+	unsigned int free_extents;
 };
 
+/*
+ * An allocated range, or a free extent once it is returned to the mm.
+ * range_start and range_end are inclusive chunk indexes.
+ */
 struct rknpu_mm_obj {
 	uint32_t range_start;
 	uint32_t range_end;
+	struct rb_node addr_node;
+	struct rb_node size_node;
 };
 
 int rknpu_mm_create(unsigned int mem_size, unsigned int chunk_size,
@@ -301,6 +301,92 @@ static ssize_t rknpu_reset_set(struct file *file, const char __user *ubuf,
 	return len;
 }
 
+static int rknpu_sched_show(struct seq_file *m, void *data)
+{
+	struct rknpu_debugger_node *node = m->private;
+	struct rknpu_debugger *debugger = node->debugger;
+	struct rknpu_device *rknpu_dev =
+		container_of(debugger, struct rknpu_device, debugger);
+	static const char *const prio_names[RKNPU_JOB_PRIORITY_NUM] = {
+		"high", "medium", "low"
+	};
+	struct rknpu_sched_stats stats[RKNPU_JOB_PRIORITY_NUM];
+	uint64_t avg_wait_us, avg_latency_us;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&rknpu_dev->irq_lock, flags);
+	memcpy(stats, rknpu_dev->sched_stats, sizeof(stats));
+	spin_unlock_irqrestore(&rknpu_dev->irq_lock, flags);
+
+	seq_printf(m, "starve_ms: %lu\n", rknpu_dev->starve_ms);
+	seq_printf(m, "%-8s %6s %9s %10s %10s %8s %8s %12s %12s %12s %12s\n",
+		   "priority", "queued", "max_queue", "submitted", "completed",
+		   "missed", "boosted", "avg_wait_us", "max_wait_us",
+		   "avg_lat_us", "max_lat_us");
+
+	for (i = 0; i < RKNPU_JOB_PRIORITY_NUM; i++) {
+		avg_wait_us = stats[i].total_wait_us;
+		if (stats[i].submitted > stats[i].queued)
+			do_div(avg_wait_us,
+			       stats[i].submitted - stats[i].queued);
+		avg_latency_us = stats[i].total_latency_us;
+		if (stats[i].completed)
+			do_div(avg_latency_us, stats[i].completed);
+
+		seq_printf(m,
+			   "%-8s %6u %9u %10llu %10llu %8llu %8llu %12llu %12llu %12llu %12llu\n",
+			   prio_names[i], stats[i].queued, stats[i].max_queued,
+			   stats[i].submitted, stats[i].completed,
+			   stats[i].deadline_missed, stats[i].starve_boosted,
+			   avg_wait_us, stats[i].max_wait_us, avg_latency_us,
+			   stats[i].max_latency_us);
+	}
+
+	return 0;
+}
+
+static ssize_t rknpu_sched_set(struct file *file, const char __user *ubuf,
+			       size_t len, loff_t *offp)
+{
+	struct seq_file *priv = file->private_data;
+	struct rknpu_debugger_node *node = priv->private;
+	struct rknpu_debugger *debugger = node->debugger;
+	struct rknpu_device *rknpu_dev =
+		container_of(debugger, struct rknpu_device, debugger);
+	unsigned long starve_ms = 0;
+	unsigned long flags;
+	char buf[16];
+	int i;
+
+	if (len > sizeof(buf) - 1)
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, len))
+		return -EFAULT;
+	buf[len - 1] = '\0';
+
+	if (strcmp(buf, "reset") == 0) {
+		spin_lock_irqsave(&rknpu_dev->irq_lock, flags);
+		for (i = 0; i < RKNPU_JOB_PRIORITY_NUM; i++) {
+			uint32_t queued = rknpu_dev->sched_stats[i].queued;
+
+			memset(&rknpu_dev->sched_stats[i], 0,
+			       sizeof(rknpu_dev->sched_stats[i]));
+			rknpu_dev->sched_stats[i].queued = queued;
+			rknpu_dev->sched_stats[i].max_queued = queued;
+			rknpu_dev->sched_stats[i].submitted = queued;
+		}
+		spin_unlock_irqrestore(&rknpu_dev->irq_lock, flags);
+	} else if (kstrtoul(buf, 10, &starve_ms) == 0) {
+		rknpu_dev->starve_ms = starve_ms;
+		LOG_INFO("set rknpu starve time %lums\n", starve_ms);
+	} else {
+		LOG_ERROR("rknpu sched node params is invalid!");
+	}
+
+	return len;
+}
+
 static struct rknpu_debugger_list rknpu_debugger_root_list[] = {
 	{ "version", rknpu_version_show, NULL, NULL },
 	{ "load", rknpu_load_show, NULL, NULL },
@@ -310,6 +396,7 @@ static struct rknpu_debugger_list rknpu_debugger_root_list[] = {
 	{ "delayms", rknpu_power_put_delay_show, rknpu_power_put_delay_set,
 	  NULL },
 	{ "reset", rknpu_reset_show, rknpu_reset_set, NULL },
+	{ "sched", rknpu_sched_show, rknpu_sched_set, NULL },
 #ifdef CONFIG_ROCKCHIP_RKNPU_SRAM
 	{ "mm", rknpu_mm_dump, NULL, NULL },
 #endif
@@ -140,6 +140,10 @@ static inline struct rknpu_job *rknpu_job_alloc(struct rknpu_device *rknpu_dev,
 
 	job->timestamp = ktime_get();
 	job->rknpu_dev = rknpu_dev;
+	job->priority = args->priority;
+	job->deadline = (args->flags & RKNPU_JOB_DEADLINE) ?
+				ktime_add_ms(job->timestamp, args->timeout) :
+				KTIME_MAX;
 	job->use_core_num = (args->core_mask & RKNPU_CORE0_MASK) +
 			    ((args->core_mask & RKNPU_CORE1_MASK) >> 1) +
 			    ((args->core_mask & RKNPU_CORE2_MASK) >> 2);
@@ -170,6 +174,119 @@ static inline struct rknpu_job *rknpu_job_alloc(struct rknpu_device *rknpu_dev,
 	return job;
 }
 
+static inline bool rknpu_job_before(struct rknpu_job *a, struct rknpu_job *b)
+{
+	if (a->priority != b->priority)
+		return a->priority < b->priority;
+
+	return ktime_before(a->deadline, b->deadline);
+}
+
+/* Keep the todo list ordered by priority, then deadline, then submit order */
+static void rknpu_job_enqueue(struct rknpu_subcore_data *subcore_data,
+			      struct rknpu_job *job, int core_index)
+{
+	struct rknpu_job *entry = NULL;
+
+	list_for_each_entry_reverse(entry, &subcore_data->todo_list,
+				    head[core_index]) {
+		if (!rknpu_job_before(job, entry)) {
+			list_add(&job->head[core_index],
+				 &entry->head[core_index]);
+			return;
+		}
+	}
+
+	list_add(&job->head[core_index], &subcore_data->todo_list);
+}
+
+/* Must be called with irq_lock held */
+static void rknpu_job_sched_submit(struct rknpu_device *rknpu_dev,
+				   struct rknpu_job *job)
+{
+	struct rknpu_sched_stats *stats = &rknpu_dev->sched_stats[job->priority];
+
+	job->queued = true;
+	stats->submitted++;
+	if (++stats->queued > stats->max_queued)
+		stats->max_queued = stats->queued;
+}
+
+/* Must be called with irq_lock held */
+static void rknpu_job_sched_dequeue(struct rknpu_device *rknpu_dev,
+				    struct rknpu_job *job)
+{
+	struct rknpu_sched_stats *stats = &rknpu_dev->sched_stats[job->priority];
+	uint64_t wait_us = 0;
+
+	if (!job->queued)
+		return;
+
+	job->queued = false;
+	stats->queued--;
+	wait_us = ktime_us_delta(ktime_get(), job->timestamp);
+	stats->total_wait_us += wait_us;
+	if (wait_us > stats->max_wait_us)
+		stats->max_wait_us = wait_us;
+}
+
+/* Must be called with irq_lock held */
+static void rknpu_job_sched_done(struct rknpu_device *rknpu_dev,
+				 struct rknpu_job *job)
+{
+	struct rknpu_sched_stats *stats = &rknpu_dev->sched_stats[job->priority];
+	ktime_t now = ktime_get();
+	uint64_t latency_us = ktime_us_delta(now, job->timestamp);
+
+	stats->completed++;
+	stats->total_latency_us += latency_us;
+	if (latency_us > stats->max_latency_us)
+		stats->max_latency_us = latency_us;
+	if (ktime_after(now, job->deadline))
+		stats->deadline_missed++;
+}
+
+/*
+ * Select the next job of the core, must be called with irq_lock held.
+ *
+ * The head of the todo list is the most urgent job. A multi-core job that
+ * has already been dispatched on another core always goes first, otherwise
+ * the cores would wait for each other. A job overtaken for longer than
+ * starve_ms is dispatched ahead of the order, oldest first.
+ */
+static struct rknpu_job *rknpu_job_pick(struct rknpu_device *rknpu_dev,
+					int core_index)
+{
+	struct rknpu_subcore_data *subcore_data =
+		&rknpu_dev->subcore_datas[core_index];
+	struct rknpu_job *entry = NULL, *job = NULL, *starved = NULL;
+	int64_t starve_us = rknpu_dev->starve_ms * 1000;
+	ktime_t now = ktime_get();
+
+	list_for_each_entry(entry, &subcore_data->todo_list, head[core_index]) {
+		if (entry->dispatched)
+			return entry;
+
+		if (!job) {
+			job = entry;
+			continue;
+		}
+
+		if (starve_us && ktime_us_delta(now, entry->timestamp) >=
+					 starve_us &&
+		    (!starved ||
+		     ktime_before(entry->timestamp, starved->timestamp)))
+			starved = entry;
+	}
+
+	if (starved && ktime_before(starved->timestamp, job->timestamp)) {
+		rknpu_dev->sched_stats[starved->priority].starve_boosted++;
+		return starved;
+	}
+
+	return job;
+}
+
 static inline int rknpu_job_wait(struct rknpu_job *job)
 {
 	struct rknpu_device *rknpu_dev = job->rknpu_dev;
@@ -217,7 +334,8 @@ static inline int rknpu_job_wait(struct rknpu_job *job)
 
 	last_task = job->last_task;
 	if (!last_task) {
-		spin_lock_irqsave(&rknpu_dev->lock, flags);
+		spin_lock_irqsave(&rknpu_dev->irq_lock, flags);
+		rknpu_job_sched_dequeue(rknpu_dev, job);
 		for (i = 0; i < job->use_core_num; i++) {
 			subcore_data = &rknpu_dev->subcore_datas[i];
 			list_for_each_entry_safe(
@@ -427,10 +545,11 @@ static void rknpu_job_next(struct rknpu_device *rknpu_dev, int core_index)
 		return;
 	}
 
-	job = list_first_entry(&subcore_data->todo_list, struct rknpu_job,
-			       head[core_index]);
+	job = rknpu_job_pick(rknpu_dev, core_index);
 
 	list_del_init(&job->head[core_index]);
+	job->dispatched++;
+	rknpu_job_sched_dequeue(rknpu_dev, job);
 	subcore_data->job = job;
 	job->hw_recoder_time = ktime_get();
 	job->commit_pc_time = job->hw_recoder_time;
@@ -467,6 +586,10 @@ static void rknpu_job_done(struct rknpu_job *job, int ret, int core_index)
 	if (atomic_dec_and_test(&job->interrupt_count)) {
 		int use_core_num = job->use_core_num;
 
+		spin_lock_irqsave(&rknpu_dev->irq_lock, flags);
+		rknpu_job_sched_done(rknpu_dev, job);
+		spin_unlock_irqrestore(&rknpu_dev->irq_lock, flags);
+
 		job->flags |= RKNPU_JOB_DONE;
 		job->ret = ret;
 
@@ -530,10 +653,11 @@ static void rknpu_job_schedule(struct rknpu_job *job)
 	}
 
 	spin_lock_irqsave(&rknpu_dev->irq_lock, flags);
+	rknpu_job_sched_submit(rknpu_dev, job);
 	for (i = 0; i < rknpu_dev->config->num_irqs; i++) {
 		if (job->args->core_mask & rknpu_core_mask(i)) {
 			subcore_data = &rknpu_dev->subcore_datas[i];
-			list_add_tail(&job->head[i], &subcore_data->todo_list);
+			rknpu_job_enqueue(subcore_data, job, i);
 			subcore_data->task_num += rknpu_get_task_number(job, i);
 		}
 	}
@@ -716,6 +840,8 @@ static void rknpu_job_timeout_clean(struct rknpu_device *rknpu_dev,
 							struct rknpu_job,
 							head[i]);
 						list_del_init(&job->head[i]);
+						rknpu_job_sched_dequeue(
+							rknpu_dev, job);
 					} else {
 						job = NULL;
 					}
@@ -739,6 +865,12 @@ static int rknpu_submit(struct rknpu_device *rknpu_dev,
 		return -EINVAL;
 	}
 
+	if (args->priority < RKNPU_JOB_PRIORITY_HIGH ||
+	    args->priority >= RKNPU_JOB_PRIORITY_NUM) {
+		LOG_ERROR("invalid rknpu job priority: %d\n", args->priority);
+		return -EINVAL;
+	}
+
 	job = rknpu_job_alloc(rknpu_dev, args);
 	if (!job) {
 		LOG_ERROR("failed to allocate rknpu job!\n");
@@ -7,10 +7,88 @@
 #include "rknpu_debugger.h"
 #include "rknpu_mm.h"
 
+static inline uint32_t rknpu_mm_obj_chunks(struct rknpu_mm_obj *obj)
+{
+	return obj->range_end - obj->range_start + 1;
+}
+
+/* Order by size, then by address so that equal fits pick the lowest one */
+static inline bool rknpu_mm_size_less(struct rknpu_mm_obj *a,
+				      struct rknpu_mm_obj *b)
+{
+	uint32_t a_chunks = rknpu_mm_obj_chunks(a);
+	uint32_t b_chunks = rknpu_mm_obj_chunks(b);
+
+	if (a_chunks != b_chunks)
+		return a_chunks < b_chunks;
+
+	return a->range_start < b->range_start;
+}
+
+static void rknpu_mm_insert_free(struct rknpu_mm *mm, struct rknpu_mm_obj *obj)
+{
+	struct rb_node **link = &mm->free_by_addr.rb_node;
+	struct rb_node *parent = NULL;
+	struct rknpu_mm_obj *entry = NULL;
+
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct rknpu_mm_obj, addr_node);
+		if (obj->range_start < entry->range_start)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&obj->addr_node, parent, link);
+	rb_insert_color(&obj->addr_node, &mm->free_by_addr);
+
+	link = &mm->free_by_size.rb_node;
+	parent = NULL;
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct rknpu_mm_obj, size_node);
+		if (rknpu_mm_size_less(obj, entry))
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&obj->size_node, parent, link);
+	rb_insert_color(&obj->size_node, &mm->free_by_size);
+
+	mm->free_extents++;
+}
+
+static void rknpu_mm_erase_free(struct rknpu_mm *mm, struct rknpu_mm_obj *obj)
+{
+	rb_erase(&obj->addr_node, &mm->free_by_addr);
+	rb_erase(&obj->size_node, &mm->free_by_size);
+	mm->free_extents--;
+}
+
+/* Find the smallest free extent holding at least @chunks */
+static struct rknpu_mm_obj *rknpu_mm_best_fit(struct rknpu_mm *mm,
+					      uint32_t chunks)
+{
+	struct rb_node *node = mm->free_by_size.rb_node;
+	struct rknpu_mm_obj *entry = NULL, *best = NULL;
+
+	while (node) {
+		entry = rb_entry(node, struct rknpu_mm_obj, size_node);
+		if (rknpu_mm_obj_chunks(entry) >= chunks) {
+			best = entry;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
+	}
+
+	return best;
+}
+
 int rknpu_mm_create(unsigned int mem_size, unsigned int chunk_size,
 		    struct rknpu_mm **mm)
 {
-	unsigned int num_of_longs;
+	struct rknpu_mm_obj *obj = NULL;
 	int ret = -EINVAL;
 
 	if (WARN_ON(mem_size < chunk_size))
@@ -27,33 +105,49 @@ int rknpu_mm_create(unsigned int mem_size, unsigned int chunk_size,
 	(*mm)->chunk_size = chunk_size;
 	(*mm)->total_chunks = mem_size / chunk_size;
 	(*mm)->free_chunks = (*mm)->total_chunks;
+	(*mm)->free_by_addr = RB_ROOT;
+	(*mm)->free_by_size = RB_ROOT;
 
-	num_of_longs =
-		((*mm)->total_chunks + BITS_PER_LONG - 1) / BITS_PER_LONG;
-
-	(*mm)->bitmap = kcalloc(num_of_longs, sizeof(long), GFP_KERNEL);
-	if (!(*mm)->bitmap) {
+	(*mm)->obj_cache = KMEM_CACHE(rknpu_mm_obj, 0);
+	if (!(*mm)->obj_cache) {
 		ret = -ENOMEM;
 		goto free_mm;
 	}
 
+	obj = kmem_cache_zalloc((*mm)->obj_cache, GFP_KERNEL);
+	if (!obj) {
+		ret = -ENOMEM;
+		goto destroy_cache;
+	}
+	obj->range_start = 0;
+	obj->range_end = (*mm)->total_chunks - 1;
+	rknpu_mm_insert_free(*mm, obj);
+
 	mutex_init(&(*mm)->lock);
 
-	LOG_DEBUG("total_chunks: %d, bitmap: %p\n", (*mm)->total_chunks,
-		  (*mm)->bitmap);
+	LOG_DEBUG("total_chunks: %d\n", (*mm)->total_chunks);
 
 	return 0;
 
+destroy_cache:
+	kmem_cache_destroy((*mm)->obj_cache);
 free_mm:
-	kfree(mm);
+	kfree(*mm);
+	*mm = NULL;
 	return ret;
 }
 
 void rknpu_mm_destroy(struct rknpu_mm *mm)
 {
+	struct rknpu_mm_obj *obj, *q;
+
 	if (mm != NULL) {
+		WARN_ON(mm->free_chunks != mm->total_chunks);
+		rbtree_postorder_for_each_entry_safe(obj, q, &mm->free_by_addr,
+						     addr_node)
+			kmem_cache_free(mm->obj_cache, obj);
+		kmem_cache_destroy(mm->obj_cache);
 		mutex_destroy(&mm->lock);
-		kfree(mm->bitmap);
 		kfree(mm);
 	}
 }
@@ -61,7 +155,9 @@ void rknpu_mm_destroy(struct rknpu_mm *mm)
 int rknpu_mm_alloc(struct rknpu_mm *mm, unsigned int size,
 		   struct rknpu_mm_obj **mm_obj)
 {
-	unsigned int found, start_search, cur_size;
+	struct rknpu_mm_obj *free_obj = NULL;
+	struct rknpu_mm_obj *new_obj = NULL;
+	uint32_t chunks;
 
 	if (size == 0)
 		return -EINVAL;
@@ -69,85 +165,58 @@ int rknpu_mm_alloc(struct rknpu_mm *mm, unsigned int size,
 	if (size > mm->total_chunks * mm->chunk_size)
 		return -ENOMEM;
 
-	*mm_obj = kzalloc(sizeof(struct rknpu_mm_obj), GFP_KERNEL);
-	if (!(*mm_obj))
-		return -ENOMEM;
+	chunks = DIV_ROUND_UP(size, mm->chunk_size);
 
-	start_search = 0;
+	/* A split needs a new object, allocate it before taking the lock */
+	new_obj = kmem_cache_zalloc(mm->obj_cache, GFP_KERNEL);
+	if (!new_obj)
+		return -ENOMEM;
 
 	mutex_lock(&mm->lock);
 
-mm_restart_search:
-	/* Find the first chunk that is free */
-	found = find_next_zero_bit(mm->bitmap, mm->total_chunks, start_search);
-
-	/* If there wasn't any free chunk, bail out */
-	if (found == mm->total_chunks)
-		goto mm_no_free_chunk;
-
-	/* Update fields of mm_obj */
-	(*mm_obj)->range_start = found;
-	(*mm_obj)->range_end = found;
-
-	/* If we need only one chunk, mark it as allocated and get out */
-	if (size <= mm->chunk_size) {
-		set_bit(found, mm->bitmap);
-		goto mm_out;
+	free_obj = rknpu_mm_best_fit(mm, chunks);
+	if (!free_obj) {
+		mutex_unlock(&mm->lock);
+		kmem_cache_free(mm->obj_cache, new_obj);
+		return -ENOMEM;
 	}
 
-	/* Otherwise, try to see if we have enough contiguous chunks */
-	cur_size = size - mm->chunk_size;
-	do {
-		(*mm_obj)->range_end = find_next_zero_bit(
-			mm->bitmap, mm->total_chunks, ++found);
-		/*
-		 * If next free chunk is not contiguous than we need to
-		 * restart our search from the last free chunk we found (which
-		 * wasn't contiguous to the previous ones
-		 */
-		if ((*mm_obj)->range_end != found) {
-			start_search = found;
-			goto mm_restart_search;
-		}
-
-		/*
-		 * If we reached end of buffer, bail out with error
-		 */
-		if (found == mm->total_chunks)
-			goto mm_no_free_chunk;
-
-		/* Check if we don't need another chunk */
-		if (cur_size <= mm->chunk_size)
-			cur_size = 0;
-		else
-			cur_size -= mm->chunk_size;
-
-	} while (cur_size > 0);
+	rknpu_mm_erase_free(mm, free_obj);
+
+	if (rknpu_mm_obj_chunks(free_obj) == chunks) {
+		/* Exact fit, hand out the free extent itself */
+		*mm_obj = free_obj;
+	} else {
+		/* Carve from the front, the remainder stays free */
+		new_obj->range_start = free_obj->range_start;
+		new_obj->range_end = free_obj->range_start + chunks - 1;
+		free_obj->range_start += chunks;
+		rknpu_mm_insert_free(mm, free_obj);
+		*mm_obj = new_obj;
+		new_obj = NULL;
+	}
 
-	/* Mark the chunks as allocated */
-	for (found = (*mm_obj)->range_start; found <= (*mm_obj)->range_end;
-	     found++)
-		set_bit(found, mm->bitmap);
+	mm->free_chunks -= chunks;
 
-mm_out:
-	mm->free_chunks -= ((*mm_obj)->range_end - (*mm_obj)->range_start + 1);
 	mutex_unlock(&mm->lock);
 
+	if (new_obj)
+		kmem_cache_free(mm->obj_cache, new_obj);
+
 	LOG_DEBUG("mm allocate, mm_obj: %p, range_start: %d, range_end: %d\n",
 		  *mm_obj, (*mm_obj)->range_start, (*mm_obj)->range_end);
 
 	return 0;
-
-mm_no_free_chunk:
-	mutex_unlock(&mm->lock);
-	kfree(*mm_obj);
-
-	return -ENOMEM;
 }
 
 int rknpu_mm_free(struct rknpu_mm *mm, struct rknpu_mm_obj *mm_obj)
 {
-	unsigned int bit;
+	struct rb_node **link = NULL;
+	struct rb_node *parent = NULL;
+	struct rb_node *node = NULL;
+	struct rknpu_mm_obj *entry = NULL;
+	struct rknpu_mm_obj *prev = NULL;
+	struct rknpu_mm_obj *next = NULL;
 
 	/* Act like kfree when trying to free a NULL object */
 	if (!mm_obj)
@@ -158,15 +227,55 @@ int rknpu_mm_free(struct rknpu_mm *mm, struct rknpu_mm_obj *mm_obj)
 
 	mutex_lock(&mm->lock);
 
-	/* Mark the chunks as free */
-	for (bit = mm_obj->range_start; bit <= mm_obj->range_end; bit++)
-		clear_bit(bit, mm->bitmap);
+	mm->free_chunks += rknpu_mm_obj_chunks(mm_obj);
 
-	mm->free_chunks += (mm_obj->range_end - mm_obj->range_start + 1);
+	/* Find the free neighbours around the range */
+	link = &mm->free_by_addr.rb_node;
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct rknpu_mm_obj, addr_node);
+		if (mm_obj->range_start < entry->range_start)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	if (parent) {
+		entry = rb_entry(parent, struct rknpu_mm_obj, addr_node);
+		if (entry->range_start < mm_obj->range_start) {
+			prev = entry;
+			node = rb_next(parent);
+			next = node ? rb_entry(node, struct rknpu_mm_obj,
+					       addr_node) :
+				      NULL;
+		} else {
+			next = entry;
+			node = rb_prev(parent);
+			prev = node ? rb_entry(node, struct rknpu_mm_obj,
+					       addr_node) :
+				      NULL;
+		}
+	}
 
-	mutex_unlock(&mm->lock);
+	if (prev && prev->range_end + 1 != mm_obj->range_start)
+		prev = NULL;
+	if (next && mm_obj->range_end + 1 != next->range_start)
+		next = NULL;
+
+	/* Coalesce with the neighbours, reusing an existing extent */
+	if (prev) {
+		rknpu_mm_erase_free(mm, prev);
+		prev->range_end = mm_obj->range_end;
+		kmem_cache_free(mm->obj_cache, mm_obj);
+		mm_obj = prev;
+	}
+	if (next) {
+		rknpu_mm_erase_free(mm, next);
+		mm_obj->range_end = next->range_end;
+		kmem_cache_free(mm->obj_cache, next);
+	}
+	rknpu_mm_insert_free(mm, mm_obj);
 
-	kfree(mm_obj);
+	mutex_unlock(&mm->lock);
 
 	return 0;
 }
@@ -178,13 +287,16 @@ int rknpu_mm_dump(struct seq_file *m, void *data)
 	struct rknpu_device *rknpu_dev =
 		container_of(debugger, struct rknpu_device, debugger);
 	struct rknpu_mm *mm = NULL;
-	int cur = 0, rbot = 0, rtop = 0;
+	struct rknpu_mm_obj *obj = NULL;
+	struct rb_node *rb = NULL;
 	size_t ret = 0;
 	char buf[64];
 	size_t size = sizeof(buf);
 	int seg_chunks = 32, seg_id = 0;
 	int free_size = 0;
-	int i = 0;
+	uint32_t largest_free = 0;
+	uint32_t cur = 0, stop = 0;
+	int fragmentation = 0;
 
 	mm = rknpu_dev->sram_mm;
 	if (mm == NULL)
@@ -193,21 +305,14 @@ int rknpu_mm_dump(struct seq_file *m, void *data)
 	seq_printf(m, "SRAM bitmap: \"*\" - used, \".\" - free (1bit = %dKB)\n",
 		   mm->chunk_size / 1024);
 
-	rbot = cur = find_first_bit(mm->bitmap, mm->total_chunks);
-	for (i = 0; i < cur; ++i) {
-		ret += scnprintf(buf + ret, size - ret, ".");
-		if (ret >= seg_chunks) {
-			seq_printf(m, "[%03d] [%s]\n", seg_id++, buf);
-			ret = 0;
-		}
-	}
+	mutex_lock(&mm->lock);
+
+	rb = rb_first(&mm->free_by_addr);
 	while (cur < mm->total_chunks) {
-		rtop = cur;
-		cur = find_next_bit(mm->bitmap, mm->total_chunks, cur + 1);
-		if (cur < mm->total_chunks && cur <= rtop + 1)
-			continue;
+		obj = rb ? rb_entry(rb, struct rknpu_mm_obj, addr_node) : NULL;
+		stop = obj ? obj->range_start : mm->total_chunks;
 
-		for (i = rbot; i <= rtop; ++i) {
+		for (; cur < stop; ++cur) {
 			ret += scnprintf(buf + ret, size - ret, "*");
 			if (ret >= seg_chunks) {
 				seq_printf(m, "[%03d] [%s]\n", seg_id++, buf);
@@ -215,7 +320,12 @@ int rknpu_mm_dump(struct seq_file *m, void *data)
 			}
 		}
 
-		for (i = rtop + 1; i < cur; ++i) {
+		if (!obj)
+			break;
+
+		largest_free = max(largest_free, rknpu_mm_obj_chunks(obj));
+
+		for (; cur <= obj->range_end; ++cur) {
 			ret += scnprintf(buf + ret, size - ret, ".");
 			if (ret >= seg_chunks) {
 				seq_printf(m, "[%03d] [%s]\n", seg_id++, buf);
@@ -223,16 +333,26 @@ int rknpu_mm_dump(struct seq_file *m, void *data)
 			}
 		}
 
-		rbot = cur;
+		rb = rb_next(rb);
 	}
 
 	if (ret > 0)
 		seq_printf(m, "[%03d] [%s]\n", seg_id++, buf);
 
+	/* Share of free space unusable by an allocation of all free space */
+	if (mm->free_chunks)
+		fragmentation = 100 - largest_free * 100 / mm->free_chunks;
+
 	free_size = mm->free_chunks * mm->chunk_size;
 	seq_printf(m, "SRAM total size: %d, used: %d, free: %d\n",
 		   rknpu_dev->sram_size, rknpu_dev->sram_size - free_size,
 		   free_size);
+	seq_printf(m,
+		   "SRAM free extents: %u, largest free: %u, fragmentation: %d%%\n",
+		   mm->free_extents, largest_free * mm->chunk_size,
+		   fragmentation);
+
+	mutex_unlock(&mm->lock);
 
 	return 0;
 }
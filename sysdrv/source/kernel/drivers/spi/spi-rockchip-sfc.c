@@ -21,6 +21,7 @@
 #include <linux/pinctrl/consumer.h>
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
+#include <linux/sched/task_stack.h>
 #include <linux/slab.h>
 #include <linux/spi/spi-mem.h>
 #include <linux/of_gpio.h>
@@ -177,6 +178,10 @@
 
 #define ROCKCHIP_AUTOSUSPEND_DELAY	2000
 
+static bool dma_zero_copy = true;
+module_param(dma_zero_copy, bool, 0644);
+MODULE_PARM_DESC(dma_zero_copy, "DMA directly to/from suitable caller buffers instead of the bounce buffer");
+
 struct rockchip_sfc {
 	struct device *dev;
 	void __iomem *regbase;
@@ -506,9 +511,38 @@ static int rockchip_sfc_xfer_data_poll(struct rockchip_sfc *sfc,
 		return rockchip_sfc_read_fifo(sfc, op->data.buf.in, len);
 }
 
+/*
+ * The DMA master takes a single 32-bit address, so the caller buffer can
+ * only be used directly if it is in the linear map (physically contiguous)
+ * and, for reads, cache line aligned so the invalidate on unmap can't
+ * clobber neighbouring data.  Anything else goes through sfc->buffer.
+ */
+static bool rockchip_sfc_dma_direct_ok(const void *buf, u32 len,
+				       enum spi_mem_data_dir dir)
+{
+	unsigned int align = dma_get_cache_alignment();
+
+	if (!dma_zero_copy || !IS_ALIGNED((unsigned long)buf, 4))
+		return false;
+
+	if (!virt_addr_valid(buf) || !virt_addr_valid(buf + len - 1) ||
+	    object_is_on_stack(buf))
+		return false;
+
+	if (dir == SPI_MEM_DATA_IN &&
+	    (!IS_ALIGNED((unsigned long)buf, align) || !IS_ALIGNED(len, align)))
+		return false;
+
+	return true;
+}
+
 static int rockchip_sfc_xfer_data_dma(struct rockchip_sfc *sfc,
 				      const struct spi_mem_op *op, u32 len)
 {
+	enum dma_data_direction dma_dir;
+	dma_addr_t dma_addr = sfc->dma_buffer;
+	void *buf;
+	bool direct;
 	int ret;
 #ifdef ROCKCHIP_SFC_VERBOSE
 	ktime_t start_time;
@@ -516,9 +550,30 @@ static int rockchip_sfc_xfer_data_dma(struct rockchip_sfc *sfc,
 	unsigned long us = 0;
 #endif
 
-	dev_dbg(sfc->dev, "sfc xfer_dma len=%x\n", len);
-
 	if (op->data.dir == SPI_MEM_DATA_OUT) {
+		buf = (void *)op->data.buf.out;
+		dma_dir = DMA_TO_DEVICE;
+	} else {
+		buf = op->data.buf.in;
+		dma_dir = DMA_FROM_DEVICE;
+	}
+
+	direct = rockchip_sfc_dma_direct_ok(buf, len, op->data.dir);
+	if (direct) {
+		dma_addr = dma_map_single(sfc->dev, buf, len, dma_dir);
+		if (dma_mapping_error(sfc->dev, dma_addr)) {
+			direct = false;
+		} else if (upper_32_bits(dma_addr + len - 1)) {
+			dma_unmap_single(sfc->dev, dma_addr, len, dma_dir);
+			direct = false;
+		}
+		if (!direct)
+			dma_addr = sfc->dma_buffer;
+	}
+
+	dev_dbg(sfc->dev, "sfc xfer_dma len=%x %s\n", len, direct ? "direct" : "bounce");
+
+	if (!direct && op->data.dir == SPI_MEM_DATA_OUT) {
 		memcpy(sfc->buffer, op->data.buf.out, len);
 		dma_sync_single_for_device(sfc->dev, sfc->dma_buffer, len, DMA_TO_DEVICE);
 	}
@@ -526,22 +581,27 @@ static int rockchip_sfc_xfer_data_dma(struct rockchip_sfc *sfc,
 #ifdef ROCKCHIP_SFC_VERBOSE
 	start_time = ktime_get();
 #endif
-	ret = rockchip_sfc_fifo_transfer_dma(sfc, sfc->dma_buffer, len);
+	ret = rockchip_sfc_fifo_transfer_dma(sfc, dma_addr, len);
 	if (!wait_for_completion_timeout(&sfc->cp, msecs_to_jiffies(2000))) {
 		dev_err(sfc->dev, "DMA wait for transfer finish timeout\n");
 		ret = -ETIMEDOUT;
+		/* Stop the master before the caller buffer is unmapped */
+		if (direct)
+			rockchip_sfc_reset(sfc);
 	}
 #ifdef ROCKCHIP_SFC_VERBOSE
 	end_time = ktime_get();
 	us = ktime_to_us(ktime_sub(end_time, start_time));
-	dev_err(sfc->dev, "sfc io %d cost %ldus speed:%ldKB/S %llx\n", len, us, len * 1000 / us, sfc->dma_buffer);
+	dev_err(sfc->dev, "sfc io %d cost %ldus speed:%ldKB/S %llx\n", len, us, len * 1000 / us, dma_addr);
 #endif
 	rockchip_sfc_irq_mask(sfc, SFC_IMR_DMA);
 
 #ifdef ROCKCHIP_SFC_VERBOSE
 	start_time = ktime_get();
 #endif
-	if (op->data.dir == SPI_MEM_DATA_IN) {
+	if (direct) {
+		dma_unmap_single(sfc->dev, dma_addr, len, dma_dir);
+	} else if (op->data.dir == SPI_MEM_DATA_IN) {
 		dma_sync_single_for_cpu(sfc->dev, sfc->dma_buffer, len, DMA_FROM_DEVICE);
 		memcpy(op->data.buf.in, sfc->buffer, len);
 	}
@@ -734,7 +794,7 @@ static int rockchip_sfc_exec_mem_op(struct spi_mem *mem, const struct spi_mem_op
 	rockchip_sfc_xfer_setup(sfc, mem, op, len);
 	if (len) {
 		if (likely(sfc->use_dma) && len >= SFC_DMA_TRANS_THRETHOLD && !(len & 0x3)) {
-			init_completion(&sfc->cp);
+			reinit_completion(&sfc->cp);
 			rockchip_sfc_irq_unmask(sfc, SFC_IMR_DMA);
 			ret = rockchip_sfc_xfer_data_dma(sfc, op, len);
 		} else {
@@ -861,6 +921,7 @@ static int rockchip_sfc_probe(struct platform_device *pdev)
 	sfc = spi_master_get_devdata(master);
 	sfc->dev = dev;
 	sfc->master = master;
+	init_completion(&sfc->cp);
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	sfc->regbase = devm_ioremap_resource(dev, res);
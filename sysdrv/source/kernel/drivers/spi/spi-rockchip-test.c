@@ -13,6 +13,7 @@
 * echo read 0 10 255 > /dev/spi_misc_test
 * echo loop 0 10 255 > /dev/spi_misc_test
 * echo setspeed 0 1000000 > /dev/spi_misc_test
+* echo memread 0 10 2048 > /dev/spi_misc_test
 */
 
 #include <linux/interrupt.h>
@@ -28,6 +29,7 @@
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
 #include <linux/spi/spi.h>
+#include <linux/spi/spi-mem.h>
 #include <linux/gpio.h>
 #include <linux/of.h>
 #include <linux/of_gpio.h>
@@ -147,6 +149,46 @@ int spi_write_and_read_slt(int id, const void *tx_buf,
 	return spi_sync(spi, &m);
 }
 
+#ifdef CONFIG_SPI_MEM
+/*
+ * Read through the spi-mem interface, for controllers such as the SFC that
+ * only implement mem_ops.  0x03 with three address bytes is a plain read
+ * on SPI NOR and a read from cache (two address bytes plus one dummy byte)
+ * on SPI NAND.
+ */
+int spi_mem_read_slt(int id, void *rxbuf, size_t n)
+{
+	struct spi_mem mem = { };
+	size_t done = 0;
+	int ret;
+
+	if (id >= MAX_SPI_DEV_NUM)
+		return -1;
+	if (!g_spi_test_data[id]) {
+		pr_err("g_spi.%d is NULL\n", id);
+		return -1;
+	}
+	mem.spi = g_spi_test_data[id]->spi;
+
+	while (done < n) {
+		struct spi_mem_op op = SPI_MEM_OP(SPI_MEM_OP_CMD(0x03, 1),
+						  SPI_MEM_OP_ADDR(3, done, 1),
+						  SPI_MEM_OP_NO_DUMMY,
+						  SPI_MEM_OP_DATA_IN(n - done, rxbuf + done, 1));
+
+		ret = spi_mem_adjust_op_size(&mem, &op);
+		if (ret)
+			return ret;
+		ret = spi_mem_exec_op(&mem, &op);
+		if (ret)
+			return ret;
+		done += op.data.nbytes;
+	}
+
+	return 0;
+}
+#endif
+
 static ssize_t spi_test_write(struct file *file,
 			const char __user *buf, size_t n, loff_t *offset)
 {
@@ -292,6 +334,39 @@ static ssize_t spi_test_write(struct file *file,
 
 		kfree(txbuf);
 		kfree(rxbuf);
+#ifdef CONFIG_SPI_MEM
+	} else if (!strcmp(cmd, "memread")) {
+		/*
+		 * Compare the SFC DMA bounce buffer against the direct path
+		 * by toggling spi_rockchip_sfc.dma_zero_copy between runs.
+		 */
+		sscanf(argv[0], "%d", &id);
+		sscanf(argv[1], "%d", &times);
+		sscanf(argv[2], "%d", &size);
+
+		rxbuf = kzalloc(size, GFP_KERNEL);
+		if (!rxbuf) {
+			printk("spi memread alloc buf size %d fail\n", size);
+			return n;
+		}
+
+		start_time = ktime_get();
+		for (i = 0; i < times; i++) {
+			if (spi_mem_read_slt(id, rxbuf, size)) {
+				printk("spi memread fail\n");
+				break;
+			}
+		}
+		end_time = ktime_get();
+		cost_time = ktime_sub(end_time, start_time);
+		us = ktime_to_us(cost_time);
+
+		bytes = size * times * 1;
+		bytes = bytes * 1000 / us;
+		printk("spi memread %d*%d cost %ldus speed:%ldKB/S\n", size, times, us, bytes);
+
+		kfree(rxbuf);
+#endif
 	} else if (!strcmp(cmd, "config")) {
 		int width;
 
@@ -308,6 +383,7 @@ static ssize_t spi_test_write(struct file *file,
 		printk("echo read 0 10 255 > /dev/spi_misc_test\n");
 		printk("echo loop 0 10 255 > /dev/spi_misc_test\n");
 		printk("echo setspeed 0 1000000 > /dev/spi_misc_test\n");
+		printk("echo memread 0 10 2048 > /dev/spi_misc_test\n");
 		printk("echo config 8 > /dev/spi_misc_test\n");
 	}
 
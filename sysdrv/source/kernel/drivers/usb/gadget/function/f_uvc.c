@@ -1072,6 +1072,9 @@ static struct usb_function_instance *uvc_alloc_inst(void)
 		return ERR_PTR(-ENOMEM);
 	opts->func_inst.free_func_inst = uvc_free_inst;
 	mutex_init(&opts->lock);
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+	spin_lock_init(&opts->stats.lock);
+#endif
 
 	cd = &opts->uvc_camera_terminal;
 	cd->bLength			= UVC_DT_CAMERA_TERMINAL_SIZE(3);
@@ -13,13 +13,40 @@
 #ifndef U_UVC_H
 #define U_UVC_H
 
+#include <linux/ktime.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
 #include <linux/usb/composite.h>
 #include <linux/usb/video.h>
 
 #define fi_to_f_uvc_opts(f)	container_of(f, struct f_uvc_opts, func_inst)
 DECLARE_UVC_EXTENSION_UNIT_DESCRIPTOR(1, 1);
 
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+/* uvc_zero_copy modes */
+#define UVC_ZERO_COPY_NONE		0
+/* userspace leaves a 2 byte gap for each payload header */
+#define UVC_ZERO_COPY_INPLACE		1
+/* requests scatter-gather from the dma-buf, headers are bounced */
+#define UVC_ZERO_COPY_SG		2
+
+/* Streaming statistics, rolled over every second */
+struct uvc_video_stats {
+	spinlock_t lock;
+	ktime_t window_start;
+	u64 bytes;
+	u32 frames;
+	u32 underruns;
+
+	/* last complete window */
+	u64 bytes_per_sec;
+	u32 frames_per_sec;
+	u32 underruns_per_sec;
+
+	u64 underruns_total;
+};
+#endif
+
 struct f_uvc_opts {
 	struct usb_function_instance			func_inst;
 	bool						streaming_bulk;
@@ -31,6 +58,7 @@ struct f_uvc_opts {
 	const char					*device_name;
 	unsigned int					uvc_num_request;
 	unsigned int					uvc_zero_copy;
+	struct uvc_video_stats				stats;
 #endif
 
 	unsigned int					control_interface;
@@ -69,6 +69,8 @@ extern unsigned int uvc_gadget_trace_param;
 
 #define UVC_MAX_REQUEST_SIZE			64
 #define UVC_MAX_EVENTS				4
+#define UVC_MAX_NUM_REQUESTS			256
+#define UVC_SG_HEADER_SIZE			2
 
 /* ------------------------------------------------------------------------
  * Structures
@@ -79,6 +81,11 @@ struct uvc_request {
 	struct uvc_video *video;
 #if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
 	struct completion req_done;
+	/* scatter-gather zero copy: header bounce + dma-buf pages */
+	struct scatterlist *sgl;
+	unsigned int sg_nents;
+	/* buffer to give back when this request completes */
+	struct uvc_buffer *last_buf;
 #endif
 };
 
@@ -97,6 +104,11 @@ struct uvc_video {
 	struct mutex mutex;	/* protects frame parameters */
 
 	unsigned int uvc_num_requests;
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+	bool use_sg;
+	atomic_t reqs_queued;
+	struct uvc_video_stats *stats;
+#endif
 
 	/* Requests */
 	unsigned int req_size;
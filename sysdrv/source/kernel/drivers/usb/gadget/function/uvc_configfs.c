@@ -2768,8 +2768,8 @@ UVCG_OPTS_ATTR(streaming_maxpacket, streaming_maxpacket, 3072);
 UVCG_OPTS_ATTR(streaming_maxburst, streaming_maxburst, 15);
 UVCG_OPTS_ATTR(pm_qos_latency, pm_qos_latency, PM_QOS_LATENCY_ANY);
 #if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
-UVCG_OPTS_ATTR(uvc_num_request, uvc_num_request, 64);
-UVCG_OPTS_ATTR(uvc_zero_copy, uvc_zero_copy, 1);
+UVCG_OPTS_ATTR(uvc_num_request, uvc_num_request, UVC_MAX_NUM_REQUESTS);
+UVCG_OPTS_ATTR(uvc_zero_copy, uvc_zero_copy, UVC_ZERO_COPY_SG);
 #endif
 
 #undef UVCG_OPTS_ATTR
@@ -2828,6 +2828,34 @@ unlock:
 	return ret;
 }
 UVC_ATTR(f_uvc_opts_, device_name, device_name);
+
+static ssize_t f_uvc_opts_uvc_stats_show(struct config_item *item,
+					 char *page)
+{
+	struct f_uvc_opts *opts = to_f_uvc_opts(item);
+	struct uvc_video_stats *stats = &opts->stats;
+	u64 bytes_per_sec = 0, underruns_total;
+	u32 frames_per_sec = 0, underruns_per_sec = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	/* The window only rolls on completions, a stalled stream reads 0 */
+	if (ktime_ms_delta(ktime_get(), stats->window_start) <
+	    2 * MSEC_PER_SEC) {
+		bytes_per_sec = stats->bytes_per_sec;
+		frames_per_sec = stats->frames_per_sec;
+		underruns_per_sec = stats->underruns_per_sec;
+	}
+	underruns_total = stats->underruns_total;
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	return sprintf(page,
+		       "bytes_per_sec: %llu\nframes_per_sec: %u\n"
+		       "underruns_per_sec: %u\nunderruns_total: %llu\n",
+		       bytes_per_sec, frames_per_sec, underruns_per_sec,
+		       underruns_total);
+}
+UVC_ATTR_RO(f_uvc_opts_, uvc_stats, uvc_stats);
 #endif
 
 #define UVCG_OPTS_STRING_ATTR(cname, aname)				\
@@ -2882,6 +2910,7 @@ static struct configfs_attribute *uvc_attrs[] = {
 	&f_uvc_opts_attr_device_name,
 	&f_uvc_opts_attr_uvc_num_request,
 	&f_uvc_opts_attr_uvc_zero_copy,
+	&f_uvc_opts_attr_uvc_stats,
 #endif
 	&f_uvc_opts_string_attr_function_name,
 	NULL,
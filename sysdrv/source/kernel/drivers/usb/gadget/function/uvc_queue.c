@@ -20,6 +20,7 @@
 #include <media/videobuf2-vmalloc.h>
 
 #include "uvc.h"
+#include "uvc_video.h"
 #include "u_uvc.h"
 
 /* ------------------------------------------------------------------------
@@ -69,6 +70,19 @@ static int uvc_queue_setup(struct vb2_queue *vq,
 		 * max_t(unsigned int, video->ep->maxburst, 1)
 		 * (video->ep->mult);
 
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+	/*
+	 * Scatter-gather requests carry no copy of the data, so keep a
+	 * whole frame in flight to ride out pump scheduling latency.
+	 */
+	if (uvcg_video_use_sg(video)) {
+		nreq = DIV_ROUND_UP(sizes[0], req_size);
+		video->uvc_num_requests = clamp_t(unsigned int, nreq, 4,
+						  UVC_MAX_NUM_REQUESTS);
+		return 0;
+	}
+#endif
+
 	/* We divide by two, to increase the chance to run
 	 * into fewer requests for smaller framesizes.
 	 */
@@ -134,7 +148,8 @@ static void *uvc_buffer_mem_prepare(struct vb2_buffer *vb,
 	struct f_uvc_opts *opts = fi_to_f_uvc_opts(uvc->func.fi);
 	void *mem;
 
-	if (!opts->uvc_zero_copy || video->fcc == V4L2_PIX_FMT_YUYV)
+	if (opts->uvc_zero_copy != UVC_ZERO_COPY_INPLACE ||
+	    video->fcc == V4L2_PIX_FMT_YUYV)
 		return (vb2_plane_vaddr(vb, 0) + vb2_plane_data_offset(vb, 0));
 
 	mem = uvc_dma_buf_phys_to_virt(uvc, vb->planes[0].dbuf);
@@ -143,6 +158,82 @@ static void *uvc_buffer_mem_prepare(struct vb2_buffer *vb,
 
 	return (mem + vb2_plane_data_offset(vb, 0));
 }
+
+static void uvc_buffer_sg_release(struct uvc_buffer *buf)
+{
+	if (!buf->attach)
+		return;
+
+	dma_buf_unmap_attachment(buf->attach, buf->sgt, DMA_TO_DEVICE);
+	dma_buf_detach(buf->dbuf, buf->attach);
+	dma_buf_put(buf->dbuf);
+
+	buf->dbuf = NULL;
+	buf->attach = NULL;
+	buf->sgt = NULL;
+}
+
+/*
+ * uvc_buffer_sg_prepare - Map the dma_buf for scatter-gather requests
+ *
+ * The mapping to the usb controller is kept for as long as userspace queues
+ * the same dma_buf into this buffer, so steady state streaming does not
+ * attach or map anything. The USB requests then point straight at the pages
+ * of the dma_buf, see uvc_video_encode_sg().
+ */
+static int uvc_buffer_sg_prepare(struct vb2_buffer *vb, struct uvc_buffer *buf)
+{
+	struct uvc_video_queue *queue = vb2_get_drv_priv(vb->vb2_queue);
+	struct uvc_video *video = container_of(queue, struct uvc_video, queue);
+	struct uvc_device *uvc = container_of(video, struct uvc_device, video);
+	struct usb_gadget *gadget = uvc->func.config->cdev->gadget;
+	struct dma_buf *dbuf = vb->planes[0].dbuf;
+	unsigned int offset = vb2_plane_data_offset(vb, 0);
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+
+	if (vb->memory != VB2_MEMORY_DMABUF) {
+		uvcg_err(&uvc->func, "scatter-gather zero copy needs dma-buf\n");
+		return -EINVAL;
+	}
+
+	if (buf->dbuf != dbuf) {
+		uvc_buffer_sg_release(buf);
+
+		attach = dma_buf_attach(dbuf, gadget->dev.parent);
+		if (IS_ERR(attach))
+			return PTR_ERR(attach);
+
+		sgt = dma_buf_map_attachment(attach, DMA_TO_DEVICE);
+		if (IS_ERR(sgt)) {
+			dma_buf_detach(dbuf, attach);
+			return PTR_ERR(sgt);
+		}
+
+		get_dma_buf(dbuf);
+		buf->dbuf = dbuf;
+		buf->attach = attach;
+		buf->sgt = sgt;
+	}
+
+	/* Position the cursor at the start of the payload */
+	for (buf->sg = buf->sgt->sgl; buf->sg; buf->sg = sg_next(buf->sg)) {
+		if (offset < buf->sg->length)
+			break;
+		offset -= buf->sg->length;
+	}
+	buf->sg_offset = offset;
+
+	return 0;
+}
+
+static void uvc_buffer_cleanup(struct vb2_buffer *vb)
+{
+	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(vb);
+	struct uvc_buffer *buf = container_of(vbuf, struct uvc_buffer, buf);
+
+	uvc_buffer_sg_release(buf);
+}
 #endif
 
 static int uvc_buffer_prepare(struct vb2_buffer *vb)
@@ -162,6 +253,15 @@ static int uvc_buffer_prepare(struct vb2_buffer *vb)
 
 	buf->state = UVC_BUF_STATE_QUEUED;
 #if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+	if (uvcg_video_use_sg(container_of(queue, struct uvc_video, queue))) {
+		int ret = uvc_buffer_sg_prepare(vb, buf);
+
+		if (ret)
+			return ret;
+	} else {
+		uvc_buffer_sg_release(buf);
+	}
+
 	buf->mem = uvc_buffer_mem_prepare(vb, queue);
 	if (IS_ERR(buf->mem))
 		return -ENOMEM;
@@ -203,6 +303,9 @@ static const struct vb2_ops uvc_queue_qops = {
 	.queue_setup = uvc_queue_setup,
 	.buf_prepare = uvc_buffer_prepare,
 	.buf_queue = uvc_buffer_queue,
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+	.buf_cleanup = uvc_buffer_cleanup,
+#endif
 	.wait_prepare = vb2_ops_wait_prepare,
 	.wait_finish = vb2_ops_wait_finish,
 };
@@ -429,6 +532,28 @@ struct uvc_buffer *uvcg_queue_next_buffer(struct uvc_video_queue *queue,
 	return nextbuf;
 }
 
+/*
+ * Give back a buffer that was already removed from the irqqueue, once the
+ * last request reading from it has completed.
+ */
+void uvcg_complete_buffer(struct uvc_video_queue *queue,
+			  struct uvc_buffer *buf, bool error)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&queue->irqlock, flags);
+
+	buf->buf.field = V4L2_FIELD_NONE;
+	buf->buf.sequence = queue->sequence++;
+	buf->buf.vb2_buf.timestamp = ktime_get_ns();
+
+	vb2_set_plane_payload(&buf->buf.vb2_buf, 0, buf->bytesused);
+	vb2_buffer_done(&buf->buf.vb2_buf, error ? VB2_BUF_STATE_ERROR :
+			VB2_BUF_STATE_DONE);
+
+	spin_unlock_irqrestore(&queue->irqlock, flags);
+}
+
 struct uvc_buffer *uvcg_queue_head(struct uvc_video_queue *queue)
 {
 	struct uvc_buffer *buf = NULL;
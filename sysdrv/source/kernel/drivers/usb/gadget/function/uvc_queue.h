@@ -36,6 +36,16 @@ struct uvc_buffer {
 	void *mem;
 	unsigned int length;
 	unsigned int bytesused;
+
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+	/* dma-buf mapping kept while the same dma-buf is queued here */
+	struct dma_buf *dbuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	/* scatter-gather cursor at queue->buf_used */
+	struct scatterlist *sg;
+	unsigned int sg_offset;
+#endif
 };
 
 #define UVC_QUEUE_DISCONNECTED		(1 << 0)
@@ -92,5 +102,8 @@ struct uvc_buffer *uvcg_queue_next_buffer(struct uvc_video_queue *queue,
 
 struct uvc_buffer *uvcg_queue_head(struct uvc_video_queue *queue);
 
+void uvcg_complete_buffer(struct uvc_video_queue *queue,
+			  struct uvc_buffer *buf, bool error);
+
 #endif /* _UVC_QUEUE_H_ */
 
@@ -13,6 +13,8 @@
 #include <linux/usb/gadget.h>
 #include <linux/usb/video.h>
 #include <linux/pm_qos.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
 
 #include <media/v4l2-dev.h>
 
@@ -27,12 +29,22 @@ static bool uvc_using_zero_copy(struct uvc_video *video)
 	struct uvc_device *uvc = container_of(video, struct uvc_device, video);
 	struct f_uvc_opts *opts = fi_to_f_uvc_opts(uvc->func.fi);
 
-	if (opts && opts->uvc_zero_copy && video->fcc != V4L2_PIX_FMT_YUYV)
+	if (opts && opts->uvc_zero_copy == UVC_ZERO_COPY_INPLACE &&
+	    video->fcc != V4L2_PIX_FMT_YUYV)
 		return true;
 	else
 		return false;
 }
 
+bool uvcg_video_use_sg(struct uvc_video *video)
+{
+	struct uvc_device *uvc = container_of(video, struct uvc_device, video);
+	struct f_uvc_opts *opts = fi_to_f_uvc_opts(uvc->func.fi);
+
+	return opts && opts->uvc_zero_copy == UVC_ZERO_COPY_SG &&
+	       uvc->func.config && uvc->func.config->cdev->gadget->sg_supported;
+}
+
 static void uvc_wait_req_complete(struct uvc_video *video, struct uvc_request *ureq)
 {
 	unsigned long flags;
@@ -192,6 +204,167 @@ uvc_video_encode_isoc(struct usb_request *req, struct uvc_video *video,
 	}
 }
 
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+/*
+ * Build the request as a scatterlist: the payload header from the request
+ * bounce buffer followed by the pages of the dma_buf, so the controller
+ * reads the frame in place. The buffer is removed from the irqqueue when
+ * its last byte is queued and given back by uvc_video_complete().
+ */
+static void
+uvc_video_encode_sg(struct usb_request *req, struct uvc_video *video,
+		struct uvc_buffer *buf)
+{
+	struct uvc_request *ureq = req->context;
+	struct uvc_video_queue *queue = &video->queue;
+	bool bulk = video->max_payload_size;
+	unsigned int len = video->req_size;
+	unsigned int header_len = 0;
+	unsigned int data_len, nbytes, offset;
+	unsigned int nents = 0;
+
+	sg_init_table(ureq->sgl, ureq->sg_nents);
+
+	if (!bulk || video->payload_size == 0) {
+		header_len = uvc_video_encode_header(video, buf,
+						     ureq->req_buffer, len);
+		sg_set_buf(&ureq->sgl[nents++], ureq->req_buffer, header_len);
+		len -= header_len;
+		if (bulk)
+			video->payload_size += header_len;
+	}
+
+	if (bulk)
+		len = min(video->max_payload_size - video->payload_size, len);
+
+	data_len = min(len, buf->bytesused - queue->buf_used);
+
+	for (len = data_len; len && buf->sg; len -= nbytes) {
+		if (WARN_ON_ONCE(nents == ureq->sg_nents))
+			break;
+
+		offset = buf->sg->offset + buf->sg_offset;
+		nbytes = min(len, buf->sg->length - buf->sg_offset);
+		sg_set_page(&ureq->sgl[nents++],
+			    nth_page(sg_page(buf->sg), offset >> PAGE_SHIFT),
+			    nbytes, offset & ~PAGE_MASK);
+
+		buf->sg_offset += nbytes;
+		if (buf->sg_offset == buf->sg->length) {
+			buf->sg = sg_next(buf->sg);
+			buf->sg_offset = 0;
+		}
+	}
+	data_len -= len;
+
+	sg_mark_end(&ureq->sgl[nents - 1]);
+	req->sg = ureq->sgl;
+	req->num_sgs = nents;
+	req->length = header_len + data_len;
+	queue->buf_used += data_len;
+
+	if (bulk) {
+		video->payload_size += data_len;
+		req->zero = video->payload_size == video->max_payload_size;
+	}
+
+	/* A short dma_buf ends the frame instead of stalling the stream */
+	if (buf->bytesused == queue->buf_used || !buf->sg) {
+		queue->buf_used = 0;
+		buf->state = UVC_BUF_STATE_DONE;
+		list_del(&buf->queue);
+		ureq->last_buf = buf;
+		video->fid ^= UVC_STREAM_FID;
+
+		if (bulk) {
+			video->payload_size = 0;
+			req->zero = 1;
+		}
+	}
+
+	if (bulk && video->payload_size == video->max_payload_size)
+		video->payload_size = 0;
+}
+
+static void uvc_video_stats_update(struct uvc_video_stats *stats,
+				   unsigned int bytes, bool frame,
+				   bool underrun)
+{
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	s64 elapsed;
+
+	spin_lock_irqsave(&stats->lock, flags);
+
+	stats->bytes += bytes;
+	stats->frames += frame;
+	stats->underruns += underrun;
+	stats->underruns_total += underrun;
+
+	elapsed = ktime_ms_delta(now, stats->window_start);
+	if (elapsed >= MSEC_PER_SEC) {
+		stats->bytes_per_sec = div_u64(stats->bytes * MSEC_PER_SEC,
+					       elapsed);
+		stats->frames_per_sec = div_u64((u64)stats->frames *
+						MSEC_PER_SEC, elapsed);
+		stats->underruns_per_sec = stats->underruns;
+		stats->bytes = 0;
+		stats->frames = 0;
+		stats->underruns = 0;
+		stats->window_start = now;
+	}
+
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+
+/*
+ * Give back the buffer the request finished and account the transfer. The
+ * queue running dry while streaming with frame data still to send is an
+ * underrun: the controller idles until the pump catches up and the host
+ * sees a gap in the stream. Draining at the end of a frame is normal.
+ */
+static void uvc_video_request_done(struct uvc_video *video,
+				   struct uvc_request *ureq,
+				   struct usb_request *req)
+{
+	struct uvc_video_queue *queue = &video->queue;
+	struct uvc_buffer *buf = ureq->last_buf;
+	bool underrun = false;
+	unsigned long flags;
+
+	if (atomic_dec_and_test(&video->reqs_queued) && !req->status &&
+	    video->uvc->state == UVC_STATE_STREAMING) {
+		spin_lock_irqsave(&queue->irqlock, flags);
+		underrun = queue->buf_used || !list_empty(&queue->irqqueue);
+		spin_unlock_irqrestore(&queue->irqlock, flags);
+	}
+
+	if (buf) {
+		ureq->last_buf = NULL;
+		uvcg_complete_buffer(queue, buf, req->status != 0);
+	}
+
+	if (video->stats)
+		uvc_video_stats_update(video->stats, req->actual,
+				       buf && !req->status, underrun);
+}
+
+/* The endpoint refused the request, undo what the pump set up for it */
+static void uvc_video_request_unqueued(struct uvc_video *video,
+				       struct usb_request *req)
+{
+	struct uvc_request *ureq = req->context;
+	struct uvc_buffer *buf = ureq->last_buf;
+
+	atomic_dec(&video->reqs_queued);
+
+	if (buf) {
+		ureq->last_buf = NULL;
+		uvcg_complete_buffer(&video->queue, buf, true);
+	}
+}
+#endif
+
 /* --------------------------------------------------------------------------
  * Request handling
  */
@@ -241,6 +414,10 @@ uvc_video_complete(struct usb_ep *ep, struct usb_request *req)
 		uvcg_queue_cancel(queue, 0);
 	}
 
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+	uvc_video_request_done(video, ureq, req);
+#endif
+
 	spin_lock_irqsave(&video->req_lock, flags);
 	list_add_tail(&req->list, &video->req_free);
 #if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
@@ -269,6 +446,11 @@ uvc_video_free_requests(struct uvc_video *video)
 				kfree(video->ureq[i].req_buffer);
 				video->ureq[i].req_buffer = NULL;
 			}
+
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+			kfree(video->ureq[i].sgl);
+			video->ureq[i].sgl = NULL;
+#endif
 		}
 
 		kfree(video->ureq);
@@ -284,6 +466,7 @@ static int
 uvc_video_alloc_requests(struct uvc_video *video)
 {
 	unsigned int req_size;
+	unsigned int buf_size;
 	unsigned int i;
 	int ret = -ENOMEM;
 
@@ -298,15 +481,35 @@ uvc_video_alloc_requests(struct uvc_video *video)
 			 * max_t(unsigned int, video->ep->maxburst, 1);
 	}
 
+	buf_size = req_size;
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+	/* Scatter-gather requests only bounce the payload header */
+	if (video->use_sg)
+		buf_size = UVC_SG_HEADER_SIZE;
+#endif
+
 	video->ureq = kcalloc(video->uvc_num_requests, sizeof(struct uvc_request), GFP_KERNEL);
 	if (video->ureq == NULL)
 		return -ENOMEM;
 
 	for (i = 0; i < video->uvc_num_requests; ++i) {
-		video->ureq[i].req_buffer = kmalloc(req_size, GFP_KERNEL);
+		video->ureq[i].req_buffer = kmalloc(buf_size, GFP_KERNEL);
 		if (video->ureq[i].req_buffer == NULL)
 			goto error;
 
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+		if (video->use_sg) {
+			/* header + page aligned data + unaligned tail */
+			video->ureq[i].sg_nents = 2 + DIV_ROUND_UP(req_size,
+								   PAGE_SIZE);
+			video->ureq[i].sgl = kcalloc(video->ureq[i].sg_nents,
+						     sizeof(struct scatterlist),
+						     GFP_KERNEL);
+			if (video->ureq[i].sgl == NULL)
+				goto error;
+		}
+#endif
+
 		video->ureq[i].req = usb_ep_alloc_request(video->ep, GFP_KERNEL);
 		if (video->ureq[i].req == NULL)
 			goto error;
@@ -378,10 +581,16 @@ static void uvcg_video_pump(struct work_struct *work)
 		video->encode(req, video, buf);
 
 		/* Queue the USB request */
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+		atomic_inc(&video->reqs_queued);
+#endif
 		ret = uvcg_video_ep_queue(video, req);
 		spin_unlock_irqrestore(&queue->irqlock, flags);
 
 		if (ret < 0) {
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+			uvc_video_request_unqueued(video, req);
+#endif
 			uvcg_queue_cancel(queue, 0);
 			break;
 		}
@@ -437,6 +646,13 @@ int uvcg_video_enable(struct uvc_video *video, int enable)
 	if ((ret = uvcg_queue_enable(&video->queue, 1)) < 0)
 		return ret;
 
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+	video->use_sg = uvcg_video_use_sg(video);
+	atomic_set(&video->reqs_queued, 0);
+	video->stats = &opts->stats;
+	video->stats->window_start = ktime_get();
+#endif
+
 	if ((ret = uvc_video_alloc_requests(video)) < 0)
 		return ret;
 
@@ -446,6 +662,11 @@ int uvcg_video_enable(struct uvc_video *video, int enable)
 	} else
 		video->encode = uvc_video_encode_isoc;
 
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+	if (video->use_sg)
+		video->encode = uvc_video_encode_sg;
+#endif
+
 	schedule_work(&video->pump);
 
 	return ret;
@@ -18,4 +18,8 @@ int uvcg_video_enable(struct uvc_video *video, int enable);
 
 int uvcg_video_init(struct uvc_video *video, struct uvc_device *uvc);
 
+#if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
+bool uvcg_video_use_sg(struct uvc_video *video);
+#endif
+
 #endif /* __UVC_VIDEO_H__ */
@@ -114,12 +114,33 @@ mpp_taskqueue_pop_pending(struct mpp_taskqueue *queue,
 	return 0;
 }
 
+/*
+ * Move all tasks on the lockless submit list to the pending list in one
+ * batch, keeping the submit order. Caller must hold queue->pending_lock.
+ */
+void mpp_taskqueue_collect_pending(struct mpp_taskqueue *queue)
+{
+	struct llist_node *node;
+	struct mpp_task *task, *n;
+
+	lockdep_assert_held(&queue->pending_lock);
+
+	node = llist_del_all(&queue->submit_list);
+	if (!node)
+		return;
+
+	node = llist_reverse_order(node);
+	llist_for_each_entry_safe(task, n, node, queue_node)
+		list_add_tail(&task->queue_link, &queue->pending_list);
+}
+
 static struct mpp_task *
 mpp_taskqueue_get_pending_task(struct mpp_taskqueue *queue)
 {
 	struct mpp_task *task = NULL;
 
 	mutex_lock(&queue->pending_lock);
+	mpp_taskqueue_collect_pending(queue);
 	task = list_first_entry_or_null(&queue->pending_list,
 					struct mpp_task,
 					queue_link);
@@ -1034,6 +1055,7 @@ struct mpp_taskqueue *mpp_taskqueue_init(struct device *dev)
 	mutex_init(&queue->dev_lock);
 	INIT_LIST_HEAD(&queue->session_attach);
 	INIT_LIST_HEAD(&queue->session_detach);
+	init_llist_head(&queue->submit_list);
 	INIT_LIST_HEAD(&queue->pending_list);
 	INIT_LIST_HEAD(&queue->running_list);
 	INIT_LIST_HEAD(&queue->mmu_list);
@@ -1580,7 +1602,10 @@ static void mpp_msgs_trigger(struct list_head *msgs_list)
 	struct mpp_dev *mpp_prev = NULL;
 	struct mpp_taskqueue *queue_prev = NULL;
 
-	/* push task to queue */
+	/*
+	 * push task to queue without taking the pending lock, the worker
+	 * collects all submitted tasks in one batch on wakeup
+	 */
 	list_for_each_entry_safe(msgs, n, msgs_list, list) {
 		struct mpp_dev *mpp;
 		struct mpp_task *task;
@@ -1594,13 +1619,8 @@ static void mpp_msgs_trigger(struct list_head *msgs_list)
 		queue = msgs->queue;
 
 		if (queue_prev != queue) {
-			if (queue_prev && mpp_prev) {
-				mutex_unlock(&queue_prev->pending_lock);
+			if (queue_prev && mpp_prev)
 				mpp_taskqueue_trigger_work(mpp_prev);
-			}
-
-			if (queue)
-				mutex_lock(&queue->pending_lock);
 
 			mpp_prev = mpp;
 			queue_prev = queue;
@@ -1610,13 +1630,11 @@ static void mpp_msgs_trigger(struct list_head *msgs_list)
 			pr_info("try to trigger abort task %d\n", task->task_id);
 
 		set_bit(TASK_STATE_PENDING, &task->state);
-		list_add_tail(&task->queue_link, &queue->pending_list);
+		llist_add(&task->queue_node, &queue->submit_list);
 	}
 
-	if (mpp_prev && queue_prev) {
-		mutex_unlock(&queue_prev->pending_lock);
+	if (mpp_prev && queue_prev)
 		mpp_taskqueue_trigger_work(mpp_prev);
-	}
 }
 
 static void mpp_msgs_wait(struct list_head *msgs_list)
@@ -2308,7 +2326,8 @@ irqreturn_t mpp_dev_isr_sched(int irq, void *param)
 
 	if (mpp->auto_freq_en &&
 	    mpp->hw_ops->reduce_freq &&
-	    list_empty(&mpp->queue->pending_list))
+	    list_empty(&mpp->queue->pending_list) &&
+	    llist_empty(&mpp->queue->submit_list))
 		mpp->hw_ops->reduce_freq(mpp);
 
 	if (mpp->dev_ops->isr)
@@ -2440,6 +2459,12 @@ void mpp_task_dump_timing(struct mpp_task *task, s64 time_diff)
 	LOG_TIMING(state, TASK_TIMING_TO_CANCEL,  "timeout cancel", task->on_cancel_timeout, s);
 	LOG_TIMING(state, TASK_TIMING_ISR,        "isr",            task->on_isr, s);
 	LOG_TIMING(state, TASK_TIMING_FINISH,     "finish",         task->on_finish, s);
+
+	if (test_bit(TASK_TIMING_BATCH, &state)) {
+		pr_info("timing: %-14s : %u frame %u\n", "batch",
+			task->batch_id, task->batch_idx);
+		LOG_TIMING(state, TASK_TIMING_BATCH, "batch start", task->on_batch, s);
+	}
 }
 
 int mpp_write_req(struct mpp_dev *mpp, u32 *regs,
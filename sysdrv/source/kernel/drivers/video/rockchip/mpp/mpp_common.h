@@ -19,6 +19,7 @@
 #include <linux/time.h>
 #include <linux/workqueue.h>
 #include <linux/kthread.h>
+#include <linux/llist.h>
 #include <linux/reset.h>
 #include <linux/irqreturn.h>
 #include <linux/poll.h>
@@ -445,6 +446,7 @@ enum mpp_task_state {
 	TASK_TIMING_TO_CANCEL	= 23,
 	TASK_TIMING_ISR		= 24,
 	TASK_TIMING_FINISH	= 25,
+	TASK_TIMING_BATCH	= 26,
 };
 
 /* The context for the a task */
@@ -458,6 +460,8 @@ struct mpp_task {
 	struct list_head done_link;
 	/* link to list in taskqueue */
 	struct list_head queue_link;
+	/* link to lockless submit list in taskqueue */
+	struct llist_node queue_node;
 	/* The DMA buffer used in this task */
 	struct list_head mem_region_list;
 	u32 mem_count;
@@ -485,6 +489,10 @@ struct mpp_task {
 	ktime_t on_cancel_timeout;
 	ktime_t on_isr;
 	ktime_t on_finish;
+	/* back-to-back batch the task was started in */
+	ktime_t on_batch;
+	u32 batch_id;
+	u32 batch_idx;
 
 	/* hardware info for current task */
 	struct mpp_hw_info *hw_info;
@@ -516,6 +524,11 @@ struct mpp_taskqueue {
 	atomic_t detach_count;
 
 	atomic_t task_id;
+	/*
+	 * lockless list for task submit, tasks are moved to pending list
+	 * in batch by mpp_taskqueue_collect_pending() under pending lock
+	 */
+	struct llist_head submit_list;
 	/* lock for pending list */
 	struct mutex pending_lock;
 	struct list_head pending_list;
@@ -654,6 +667,7 @@ struct mpp_dev_ops {
 };
 
 struct mpp_taskqueue *mpp_taskqueue_init(struct device *dev);
+void mpp_taskqueue_collect_pending(struct mpp_taskqueue *queue);
 
 struct mpp_mem_region *
 mpp_task_attach_fd(struct mpp_task *task, int fd);
@@ -16,6 +16,7 @@
 #include <linux/of.h>
 #include <linux/of_platform.h>
 #include <linux/kref.h>
+#include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/pm_runtime.h>
 
@@ -33,20 +34,22 @@ mpp_dma_find_buffer_fd(struct mpp_dma_session *dma, int fd)
 {
 	struct dma_buf *dmabuf;
 	struct mpp_dma_buffer *out = NULL;
-	struct mpp_dma_buffer *buffer = NULL, *n;
+	struct mpp_dma_buffer *buffer = NULL;
 
 	dmabuf = dma_buf_get(fd);
 	if (IS_ERR(dmabuf))
 		return NULL;
 
 	mutex_lock(&dma->list_mutex);
-	list_for_each_entry_safe(buffer, n,
-				 &dma->used_list, link) {
-		/*
-		 * fd may dup several and point the same dambuf.
-		 * thus, here should be distinguish with the dmabuf.
-		 */
+	/*
+	 * fd may dup several and point the same dambuf.
+	 * thus, here should be distinguish with the dmabuf.
+	 */
+	hash_for_each_possible(dma->buf_table, buffer, hnode,
+			       (unsigned long)dmabuf) {
 		if (buffer->dmabuf == dmabuf) {
+			/* keep used_list in LRU order */
+			list_move_tail(&buffer->link, &dma->used_list);
 			out = buffer;
 			break;
 		}
@@ -64,6 +67,7 @@ static void mpp_dma_release_buffer(struct kref *ref)
 		container_of(ref, struct mpp_dma_buffer, ref);
 
 	buffer->dma->buffer_count--;
+	hash_del(&buffer->hnode);
 	list_move_tail(&buffer->link, &buffer->dma->unused_list);
 
 	dma_buf_unmap_attachment(buffer->attach, buffer->sgt, buffer->dir);
@@ -80,27 +84,24 @@ static void mpp_dma_release_buffer(struct kref *ref)
 	buffer->last_used = 0;
 }
 
-/* Remove the oldest buffer when count more than the setting */
+/* Remove the least recently used idle buffer when the setting is reached */
 static int
 mpp_dma_remove_extra_buffer(struct mpp_dma_session *dma)
 {
 	struct mpp_dma_buffer *n;
-	struct mpp_dma_buffer *oldest = NULL, *buffer = NULL;
-	ktime_t oldest_time = ktime_set(0, 0);
+	struct mpp_dma_buffer *buffer = NULL;
 
-	if (dma->buffer_count > dma->max_buffers) {
+	if (dma->buffer_count >= dma->max_buffers) {
 		mutex_lock(&dma->list_mutex);
 		list_for_each_entry_safe(buffer, n,
 					 &dma->used_list,
 					 link) {
-			if (ktime_to_ns(oldest_time) == 0 ||
-			    ktime_after(oldest_time, buffer->last_used)) {
-				oldest_time = buffer->last_used;
-				oldest = buffer;
+			if (kref_read(&buffer->ref) <= 1) {
+				dma->evict_count++;
+				kref_put(&buffer->ref, mpp_dma_release_buffer);
+				break;
 			}
 		}
-		if (oldest && kref_read(&oldest->ref) <= 1)
-			kref_put(&oldest->ref, mpp_dma_release_buffer);
 		mutex_unlock(&dma->list_mutex);
 	}
 
@@ -190,19 +191,22 @@ struct mpp_dma_buffer *mpp_dma_import_fd(struct mpp_iommu_info *iommu_info,
 		return ERR_PTR(-EINVAL);
 	}
 
-	/* remove the oldest before add buffer */
-	mpp_dma_remove_extra_buffer(dma);
-
 	/* Check whether in dma session */
 	buffer = mpp_dma_find_buffer_fd(dma, fd);
 	if (!IS_ERR_OR_NULL(buffer)) {
 		if (kref_get_unless_zero(&buffer->ref)) {
 			buffer->last_used = ktime_get();
+			mutex_lock(&dma->list_mutex);
+			dma->hit_count++;
+			mutex_unlock(&dma->list_mutex);
 			return buffer;
 		}
 		dev_dbg(dma->dev, "missing the fd %d\n", fd);
 	}
 
+	/* remove the oldest before add buffer */
+	mpp_dma_remove_extra_buffer(dma);
+
 	dmabuf = dma_buf_get(fd);
 	if (IS_ERR(dmabuf)) {
 		ret = PTR_ERR(dmabuf);
@@ -253,7 +257,9 @@ struct mpp_dma_buffer *mpp_dma_import_fd(struct mpp_iommu_info *iommu_info,
 
 	mutex_lock(&dma->list_mutex);
 	dma->buffer_count++;
+	dma->miss_count++;
 	list_add_tail(&buffer->link, &dma->used_list);
+	hash_add(dma->buf_table, &buffer->hnode, (unsigned long)dmabuf);
 	mutex_unlock(&dma->list_mutex);
 
 	return buffer;
@@ -336,6 +342,7 @@ int mpp_dma_session_destroy(struct mpp_dma_session *dma)
 	}
 	mutex_unlock(&dma->list_mutex);
 
+	kvfree(dma->dma_bufs);
 	kfree(dma);
 
 	return 0;
@@ -355,16 +362,29 @@ mpp_dma_session_create(struct device *dev, u32 max_buffers)
 	mutex_init(&dma->list_mutex);
 	INIT_LIST_HEAD(&dma->unused_list);
 	INIT_LIST_HEAD(&dma->used_list);
+	hash_init(dma->buf_table);
 
-	if (max_buffers > MPP_SESSION_MAX_BUFFERS) {
+	if (max_buffers > MPP_SESSION_MAX_BUFFERS_LIMIT) {
 		mpp_debug(DEBUG_IOCTL, "session_max_buffer %d must less than %d\n",
-			  max_buffers, MPP_SESSION_MAX_BUFFERS);
-		dma->max_buffers = MPP_SESSION_MAX_BUFFERS;
+			  max_buffers, MPP_SESSION_MAX_BUFFERS_LIMIT);
+		dma->max_buffers = MPP_SESSION_MAX_BUFFERS_LIMIT;
 	} else {
 		dma->max_buffers = max_buffers;
 	}
 
-	for (i = 0; i < ARRAY_SIZE(dma->dma_bufs); i++) {
+	/*
+	 * Buffers still referenced by tasks are not evicted, so the pool
+	 * keeps some headroom above max_buffers for them.
+	 */
+	dma->pool_size = dma->max_buffers + MPP_SESSION_BUFFERS_HEADROOM;
+	dma->dma_bufs = kvcalloc(dma->pool_size, sizeof(*dma->dma_bufs),
+				 GFP_KERNEL);
+	if (!dma->dma_bufs) {
+		kfree(dma);
+		return NULL;
+	}
+
+	for (i = 0; i < dma->pool_size; i++) {
 		buffer = &dma->dma_bufs[i];
 		buffer->dma = dma;
 		INIT_LIST_HEAD(&buffer->link);
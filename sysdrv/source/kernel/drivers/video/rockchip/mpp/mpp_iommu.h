@@ -13,11 +13,14 @@
 
 #include <linux/iommu.h>
 #include <linux/dma-mapping.h>
+#include <linux/hashtable.h>
 #include <linux/interrupt.h>
 
 struct mpp_dma_buffer {
 	/* link to dma session buffer list */
 	struct list_head link;
+	/* link to dma session buffer hash table, keyed by dmabuf */
+	struct hlist_node hnode;
 
 	/* dma session belong */
 	struct mpp_dma_session *dma;
@@ -39,18 +42,30 @@ struct mpp_dma_buffer {
 };
 
 #define MPP_SESSION_MAX_BUFFERS		60
+/* upper bound of the configurable session_max_buffers */
+#define MPP_SESSION_MAX_BUFFERS_LIMIT	1024
+/* pool entries beyond max_buffers, for buffers held by running tasks */
+#define MPP_SESSION_BUFFERS_HEADROOM	32
+#define MPP_SESSION_BUF_HASH_BITS	6
 
 struct mpp_dma_session {
-	/* the buffer used in session */
+	/* the buffer used in session, used_list is in LRU order */
 	struct list_head unused_list;
 	struct list_head used_list;
-	struct mpp_dma_buffer dma_bufs[MPP_SESSION_MAX_BUFFERS];
+	struct mpp_dma_buffer *dma_bufs;
+	u32 pool_size;
+	/* used buffers indexed by dmabuf pointer */
+	DECLARE_HASHTABLE(buf_table, MPP_SESSION_BUF_HASH_BITS);
 	/* the mutex for the above buffer list */
 	struct mutex list_mutex;
 	/* the max buffer num for the buffer list */
 	u32 max_buffers;
 	/* the count for the buffer list */
 	int buffer_count;
+	/* import cache statistics, protected by list_mutex */
+	u64 hit_count;
+	u64 miss_count;
+	u64 evict_count;
 
 	struct device *dev;
 };
@@ -1112,6 +1112,7 @@ static int rkvdec2_get_freq(struct mpp_dev *mpp,
 	workload = task->pixels;
 	/* calc workload in pending list */
 	mutex_lock(&mpp->queue->pending_lock);
+	mpp_taskqueue_collect_pending(mpp->queue);
 	list_for_each_entry_safe(loop, n,
 				 &mpp->queue->pending_list,
 				 queue_link) {
@@ -1214,6 +1214,7 @@ static void mpp_taskqueue_scan_pending_abort_task(struct mpp_taskqueue *queue)
 	struct mpp_task *task, *n;
 
 	mutex_lock(&queue->pending_lock);
+	mpp_taskqueue_collect_pending(queue);
 	/* Check and pop all timeout task */
 	list_for_each_entry_safe(task, n, &queue->pending_list, queue_link) {
 		struct mpp_session *session = task->session;
@@ -1480,6 +1481,7 @@ again:
 	 * process pending queue to find the task to accept.
 	 */
 	mutex_lock(&queue->pending_lock);
+	mpp_taskqueue_collect_pending(queue);
 	task = list_first_entry_or_null(&queue->pending_list, struct mpp_task,
 					queue_link);
 	mutex_unlock(&queue->pending_lock);
@@ -1530,6 +1532,7 @@ done:
 		u32 all_done = 0;
 
 		mutex_lock(&queue->pending_lock);
+		mpp_taskqueue_collect_pending(queue);
 		all_done = list_empty(&queue->pending_list);
 		mutex_unlock(&queue->pending_lock);
 
@@ -2138,6 +2141,7 @@ void rkvdec2_soft_ccu_worker(struct kthread_work *work_s)
 get_task:
 	/* get one task form pending list */
 	mutex_lock(&queue->pending_lock);
+	mpp_taskqueue_collect_pending(queue);
 	mpp_task = list_first_entry_or_null(&queue->pending_list,
 					    struct mpp_task, queue_link);
 	mutex_unlock(&queue->pending_lock);
@@ -2786,6 +2790,7 @@ void rkvdec2_hard_ccu_worker(struct kthread_work *work_s)
 get_task:
 	/* get one task form pending list */
 	mutex_lock(&queue->pending_lock);
+	mpp_taskqueue_collect_pending(queue);
 	mpp_task = list_first_entry_or_null(&queue->pending_list,
 					    struct mpp_task, queue_link);
 	mutex_unlock(&queue->pending_lock);
@@ -2812,6 +2817,7 @@ get_task:
 	rkvdec2_hard_ccu_enqueue(dec->ccu, mpp_task, queue, mpp);
 done:
 	mutex_lock(&queue->pending_lock);
+	mpp_taskqueue_collect_pending(queue);
 	if (list_empty(&queue->running_list) &&
 	    list_empty(&queue->pending_list))
 		rkvdec2_ccu_power_off(queue, dec->ccu);
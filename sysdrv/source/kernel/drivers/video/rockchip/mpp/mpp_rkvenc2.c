@@ -283,6 +283,25 @@ struct rkvenc_dev {
 	u32 sram_enabled;
 	struct page *rcb_page;
 
+	/*
+	 * Tasks from all sessions started back-to-back, without the core
+	 * going idle on an empty queue, are accounted as one batch.
+	 */
+	spinlock_t batch_lock;
+	bool batch_active;
+	u32 batch_id;
+	u32 batch_frames;
+	ktime_t batch_start;
+	ktime_t batch_last_isr;
+	/* batch statistics */
+	u32 batch_cnt;
+	u32 batch_frames_max;
+	u64 batch_frames_total;
+	u64 batch_time_total;
+	u32 batch_gap_cnt;
+	u32 batch_gap_max;
+	u64 batch_gap_total;
+
 #ifdef CONFIG_PM_DEVFREQ
 	struct rockchip_opp_info opp_info;
 	struct monitor_dev_info *mdev_info;
@@ -1178,6 +1197,76 @@ static void rkvenc2_update_dchs(struct rkvenc_dev *enc, struct rkvenc_task *task
 	spin_unlock_irqrestore(&ccu->lock_dchs, flags);
 }
 
+static void rkvenc2_batch_begin(struct rkvenc_dev *enc,
+				struct mpp_task *mpp_task)
+{
+	ktime_t now = ktime_get();
+	unsigned long flags;
+	u32 gap;
+
+	spin_lock_irqsave(&enc->batch_lock, flags);
+	if (!enc->batch_active) {
+		enc->batch_active = true;
+		enc->batch_id++;
+		enc->batch_frames = 0;
+		enc->batch_start = now;
+	} else {
+		/* cpu time between previous frame done and this frame start */
+		gap = ktime_us_delta(now, enc->batch_last_isr);
+		enc->batch_gap_cnt++;
+		enc->batch_gap_total += gap;
+		if (gap > enc->batch_gap_max)
+			enc->batch_gap_max = gap;
+	}
+	mpp_task->batch_id = enc->batch_id;
+	mpp_task->batch_idx = enc->batch_frames++;
+	mpp_task->on_batch = enc->batch_start;
+	set_bit(TASK_TIMING_BATCH, &mpp_task->state);
+	spin_unlock_irqrestore(&enc->batch_lock, flags);
+}
+
+/* account the open batch as finished, with batch_lock held */
+static void rkvenc2_batch_close(struct rkvenc_dev *enc, ktime_t now)
+{
+	enc->batch_active = false;
+	enc->batch_cnt++;
+	enc->batch_frames_total += enc->batch_frames;
+	enc->batch_time_total += ktime_us_delta(now, enc->batch_start);
+	if (enc->batch_frames > enc->batch_frames_max)
+		enc->batch_frames_max = enc->batch_frames;
+}
+
+static void rkvenc2_batch_end(struct rkvenc_dev *enc)
+{
+	struct mpp_taskqueue *queue = enc->mpp.queue;
+	ktime_t now = ktime_get();
+	unsigned long flags;
+
+	spin_lock_irqsave(&enc->batch_lock, flags);
+	enc->batch_last_isr = now;
+	/* the batch ends when no more task is waiting for the core */
+	if (enc->batch_active && list_empty_careful(&queue->pending_list) &&
+	    llist_empty(&queue->submit_list))
+		rkvenc2_batch_close(enc, now);
+	spin_unlock_irqrestore(&enc->batch_lock, flags);
+}
+
+/*
+ * A timed out task never reaches the isr, end its batch on reset so the
+ * next one does not measure its gap from a stale frame done time.
+ */
+static void rkvenc2_batch_abort(struct rkvenc_dev *enc)
+{
+	ktime_t now = ktime_get();
+	unsigned long flags;
+
+	spin_lock_irqsave(&enc->batch_lock, flags);
+	enc->batch_last_isr = now;
+	if (enc->batch_active)
+		rkvenc2_batch_close(enc, now);
+	spin_unlock_irqrestore(&enc->batch_lock, flags);
+}
+
 static int rkvenc_run(struct mpp_dev *mpp, struct mpp_task *mpp_task)
 {
 	u32 i, j;
@@ -1234,6 +1323,8 @@ static int rkvenc_run(struct mpp_dev *mpp, struct mpp_task *mpp_task)
 	/* init current task */
 	mpp->cur_task = mpp_task;
 
+	rkvenc2_batch_begin(enc, mpp_task);
+
 	mpp_task_run_begin(mpp_task, timing_en, MPP_WORK_TIMEOUT_DELAY);
 
 	/* Flush the register before the start the device */
@@ -1374,6 +1465,8 @@ static int rkvenc_isr(struct mpp_dev *mpp)
 
 	mpp_task_finish(mpp_task->session, mpp_task);
 
+	rkvenc2_batch_end(enc);
+
 	core_idle = queue->core_idle;
 	set_bit(mpp->core_id, &queue->core_idle);
 
@@ -1614,6 +1707,34 @@ static int rkvenc_show_session_info(struct seq_file *seq, void *offset)
 	return 0;
 }
 
+static int rkvenc_show_batch_info(struct seq_file *seq, void *offset)
+{
+	struct mpp_dev *mpp = seq->private;
+	struct rkvenc_dev *enc = to_rkvenc_dev(mpp);
+	u64 frames_avg = 0, time_avg = 0, gap_avg = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&enc->batch_lock, flags);
+	if (enc->batch_cnt) {
+		frames_avg = div_u64(enc->batch_frames_total, enc->batch_cnt);
+		time_avg = div_u64(enc->batch_time_total, enc->batch_cnt);
+	}
+	if (enc->batch_gap_cnt)
+		gap_avg = div_u64(enc->batch_gap_total, enc->batch_gap_cnt);
+
+	seq_printf(seq, "batch count     : %u\n", enc->batch_cnt);
+	seq_printf(seq, "frames per batch: avg %llu max %u\n",
+		   frames_avg, enc->batch_frames_max);
+	seq_printf(seq, "batch time      : avg %llu us\n", time_avg);
+	seq_printf(seq, "frame gap       : avg %llu us max %u us\n",
+		   gap_avg, enc->batch_gap_max);
+	seq_printf(seq, "current batch   : %u %s frames %u\n", enc->batch_id,
+		   enc->batch_active ? "active" : "idle", enc->batch_frames);
+	spin_unlock_irqrestore(&enc->batch_lock, flags);
+
+	return 0;
+}
+
 static int rkvenc_procfs_init(struct mpp_dev *mpp)
 {
 	struct rkvenc_dev *enc = to_rkvenc_dev(mpp);
@@ -1646,6 +1767,9 @@ static int rkvenc_procfs_init(struct mpp_dev *mpp)
 	/* for show session info */
 	proc_create_single_data("sessions-info", 0444,
 				enc->procfs, rkvenc_show_session_info, mpp);
+	/* for back-to-back batch statistics */
+	proc_create_single_data("batch-info", 0444,
+				enc->procfs, rkvenc_show_batch_info, mpp);
 
 	return 0;
 }
@@ -1875,6 +1999,7 @@ static int rkvenc_reset(struct mpp_dev *mpp)
 	set_bit(mpp->core_id, &queue->core_idle);
 	if (enc->ccu)
 		enc->ccu->dchs[mpp->core_id].val = 0;
+	rkvenc2_batch_abort(enc);
 
 	mpp_dbg_core("core %d reset idle %lx\n", mpp->core_id, queue->core_idle);
 
@@ -2385,6 +2510,8 @@ static int rkvenc_core_probe(struct platform_device *pdev)
 	if (!enc)
 		return -ENOMEM;
 
+	spin_lock_init(&enc->batch_lock);
+
 	mpp = &enc->mpp;
 	platform_set_drvdata(pdev, mpp);
 
@@ -2445,6 +2572,8 @@ static int rkvenc_probe_default(struct platform_device *pdev)
 	if (!enc)
 		return -ENOMEM;
 
+	spin_lock_init(&enc->batch_lock);
+
 	mpp = &enc->mpp;
 	platform_set_drvdata(pdev, mpp);
 
@@ -228,6 +228,11 @@ static int mpp_dump_session(struct mpp_session *session, struct seq_file *s)
 	seq_printf(s, "session: pid=%d index=%d\n", session->pid, session->index);
 	seq_printf(s, " device: %s\n", dev_name(session->mpp->dev));
 	seq_printf(s, " memory: %lu MiB\n", K(K(t)));
+	mutex_lock(&dma->list_mutex);
+	seq_printf(s, " dma cache: %d/%u hit %llu miss %llu evict %llu\n",
+		   dma->buffer_count, dma->max_buffers, dma->hit_count,
+		   dma->miss_count, dma->evict_count);
+	mutex_unlock(&dma->list_mutex);
 
 	return 0;
 }
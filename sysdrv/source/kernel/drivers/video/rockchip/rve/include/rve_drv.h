@@ -88,6 +88,11 @@
 #define RVE_MAX_BUS_CLK 10
 #define RVE_MAX_PID_INFO 10
 
+/* async jobs a ctx may have in flight when auto cancel is disabled */
+#define RVE_CTX_QUEUE_DEPTH_MAX 16
+
+#define RVE_HIST_BUCKETS 20
+
 extern struct rve_drvdata_t *rve_drvdata;
 
 enum {
@@ -116,6 +121,10 @@ struct rve_fence_waiter {
 struct rve_scheduler_t;
 struct rve_internal_ctx_t;
 
+struct rve_cmd_reg_array_t {
+	uint32_t cmd_reg[58];
+};
+
 struct rve_session {
 	int id;
 
@@ -128,6 +137,8 @@ struct rve_job {
 	struct rve_session *session;
 
 	struct rve_cmd_reg_array_t *regcmd_data;
+	/* private copy of the commands for queued async jobs */
+	struct rve_cmd_reg_array_t regcmd;
 
 	struct rve_internal_ctx_t *ctx;
 
@@ -136,7 +147,10 @@ struct rve_job {
 
 	struct dma_fence *out_fence;
 	struct dma_fence *in_fence;
+	struct rve_fence_waiter fence_waiter;
 	spinlock_t fence_lock;
+	/* false while waiting for in_fence, protected by scheduler->irq_lock */
+	bool ready;
 	ktime_t timestamp;
 	ktime_t hw_running_time;
 	ktime_t hw_recoder_time;
@@ -203,15 +217,20 @@ struct rve_scheduler_t {
 	struct rve_version_t version;
 	int core;
 
+	/* runs rve_job_next() for jobs whose input fence signaled */
+	struct work_struct kick_work;
+	u64 sched_seq;
+	u32 pick_gen;
+
+	/* todo_list depth at submit, and log2(us) from submit to done */
+	u32 depth_hist[RVE_HIST_BUCKETS];
+	u32 latency_hist[RVE_HIST_BUCKETS];
+
 	struct rve_timer timer;
 
 	struct rve_sche_session_info_t session;
 };
 
-struct rve_cmd_reg_array_t {
-	uint32_t cmd_reg[58];
-};
-
 struct rve_ctx_debug_info_t {
 	pid_t pid;
 	u32 timestamp;
@@ -238,8 +257,14 @@ struct rve_internal_ctx_t {
 
 	uint32_t running_job_count;
 	uint32_t finished_job_count;
+	/* queued async jobs not yet finished */
+	uint32_t queued_job_count;
 	bool is_running;
 
+	/* scheduler->sched_seq when this ctx last got the hardware */
+	u64 sched_seq;
+	u32 pick_gen;
+
 	uint32_t disable_auto_cancel;
 
 	int priority;
@@ -19,12 +19,15 @@ enum job_flags {
 	RVE_SYNC			= 1 << 2,
 	RVE_JOB_USE_HANDLE		= 1 << 3,
 	RVE_JOB_UNSUPPORT_RVE2		= 1 << 4,
+	RVE_JOB_QUEUED			= 1 << 5,
+	RVE_JOB_CANCELED		= 1 << 6,
 };
 
 struct rve_scheduler_t *rve_job_get_scheduler(struct rve_job *job);
 struct rve_internal_ctx_t *rve_job_get_internal_ctx(struct rve_job *job);
 
 void rve_job_done(struct rve_scheduler_t *rve_scheduler, int ret);
+void rve_job_kick_work(struct work_struct *work);
 int rve_job_commit(struct rve_internal_ctx_t *ctx);
 
 int rve_job_config_by_user_ctx(struct rve_user_ctx_t *user_ctx);
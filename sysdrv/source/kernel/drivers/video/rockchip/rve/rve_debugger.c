@@ -225,6 +225,83 @@ static int rve_scheduler_show(struct seq_file *m, void *data)
 	return 0;
 }
 
+static int rve_histogram_show(struct seq_file *m, void *data)
+{
+	struct rve_scheduler_t *scheduler = NULL;
+	u32 depth_hist[RVE_HIST_BUCKETS];
+	u32 latency_hist[RVE_HIST_BUCKETS];
+	unsigned long flags;
+	int i, j;
+
+	for (i = 0; i < rve_drvdata->num_of_scheduler; i++) {
+		scheduler = rve_drvdata->scheduler[i];
+
+		spin_lock_irqsave(&scheduler->irq_lock, flags);
+
+		memcpy(depth_hist, scheduler->depth_hist, sizeof(depth_hist));
+		memcpy(latency_hist, scheduler->latency_hist, sizeof(latency_hist));
+
+		spin_unlock_irqrestore(&scheduler->irq_lock, flags);
+
+		seq_printf(m, "scheduler[%d]: %s\n", i, dev_driver_string(scheduler->dev));
+		seq_printf(m, "---------------- queue depth ----------------\n");
+		for (j = 0; j < RVE_HIST_BUCKETS; j++) {
+			if (!depth_hist[j])
+				continue;
+			seq_printf(m, "\t %s%d: %u\n",
+				   j == RVE_HIST_BUCKETS - 1 ? ">= " : "", j, depth_hist[j]);
+		}
+
+		seq_printf(m, "------------- job latency (us) -------------\n");
+		for (j = 0; j < RVE_HIST_BUCKETS; j++) {
+			if (!latency_hist[j])
+				continue;
+			if (j == RVE_HIST_BUCKETS - 1)
+				seq_printf(m, "\t >= %u: %u\n", 1U << (j - 1), latency_hist[j]);
+			else
+				seq_printf(m, "\t < %u: %u\n", 1U << j, latency_hist[j]);
+		}
+	}
+
+	seq_puts(m, "\nhelp:\n");
+	seq_puts(m, " 'echo reset > histogram' to clear the histograms.\n");
+
+	return 0;
+}
+
+static ssize_t rve_histogram_write(struct file *file, const char __user *ubuf,
+				   size_t len, loff_t *offp)
+{
+	struct rve_scheduler_t *scheduler = NULL;
+	unsigned long flags;
+	char buf[8];
+	int i;
+
+	if (!len)
+		return 0;
+	if (len > sizeof(buf) - 1)
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, len))
+		return -EFAULT;
+	buf[len] = '\0';
+
+	if (!sysfs_streq(buf, "reset"))
+		return -EINVAL;
+
+	for (i = 0; i < rve_drvdata->num_of_scheduler; i++) {
+		scheduler = rve_drvdata->scheduler[i];
+
+		spin_lock_irqsave(&scheduler->irq_lock, flags);
+
+		memset(scheduler->depth_hist, 0, sizeof(scheduler->depth_hist));
+		memset(scheduler->latency_hist, 0, sizeof(scheduler->latency_hist));
+
+		spin_unlock_irqrestore(&scheduler->irq_lock, flags);
+	}
+
+	return len;
+}
+
 static int rve_ctx_manager_show(struct seq_file *m, void *data)
 {
 	int id;
@@ -233,6 +310,7 @@ static int rve_ctx_manager_show(struct seq_file *m, void *data)
 	unsigned long flags;
 	int cmd_num = 0;
 	int finished_job_count = 0;
+	int queued_job_count = 0;
 	bool status = false;
 	pid_t pid;
 
@@ -257,6 +335,7 @@ static int rve_ctx_manager_show(struct seq_file *m, void *data)
 
 		cmd_num = ctx->cmd_num;
 		finished_job_count = ctx->finished_job_count;
+		queued_job_count = ctx->queued_job_count;
 		status = ctx->is_running;
 		pid = ctx->debug_info.pid;
 		last_job_hw_use_time = ctx->debug_info.last_job_hw_use_time;
@@ -268,8 +347,8 @@ static int rve_ctx_manager_show(struct seq_file *m, void *data)
 
 		seq_printf(m, "----------------- RVE CTX INFO -----------------\n");
 		seq_printf(m, "\t [pid: %d] status: %s\n", pid, status ? "active" : "pending");
-		seq_printf(m, "\t set cmd num: %d\t finish job sum: %d\n",
-				cmd_num, finished_job_count);
+		seq_printf(m, "\t set cmd num: %d\t finish job sum: %d\t queued job: %d\n",
+				cmd_num, finished_job_count, queued_job_count);
 		seq_printf(m, "\t last_job_use_time: %u us\t last_job_hw_use_time: %u us",
 				last_job_use_time, last_job_hw_use_time);
 		seq_printf(m, "\t hw_time_total: %u us\t max_cost_time_per_sec: %u us",
@@ -292,6 +371,7 @@ struct rve_debugger_list rve_debugger_root_list[] = {
 	{"driver_version", rve_version_show, NULL, NULL},
 	{"load", rve_load_show, NULL, NULL},
 	{"scheduler_status", rve_scheduler_show, NULL, NULL},
+	{"histogram", rve_histogram_show, rve_histogram_write, NULL},
 	{"ctx_manager", rve_ctx_manager_show, NULL, NULL},
 };
 
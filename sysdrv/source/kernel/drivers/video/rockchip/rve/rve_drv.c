@@ -637,6 +637,7 @@ static void init_scheduler(struct rve_scheduler_t *scheduler,
 	spin_lock_init(&scheduler->irq_lock);
 	INIT_LIST_HEAD(&scheduler->todo_list);
 	init_waitqueue_head(&scheduler->job_done_wq);
+	INIT_WORK(&scheduler->kick_work, rve_job_kick_work);
 
 	if (!strcmp(name, "rve")) {
 		scheduler->ops = &rve_ops;
@@ -788,6 +789,10 @@ failed:
 
 static int rve_drv_remove(struct platform_device *pdev)
 {
+	struct rve_scheduler_t *scheduler = platform_get_drvdata(pdev);
+
+	cancel_work_sync(&scheduler->kick_work);
+
 	device_init_wakeup(&pdev->dev, false);
 #ifndef RVE_PD_AWAYS_ON
 	pm_runtime_disable(&pdev->dev);
@@ -106,31 +106,16 @@ int rve_wait_input_fence(struct dma_fence *in_fence)
 int rve_add_dma_fence_callback(struct rve_job *job, struct dma_fence *in_fence,
 				 dma_fence_func_t func)
 {
-	struct rve_fence_waiter *waiter;
+	struct rve_fence_waiter *waiter = &job->fence_waiter;
 	int ret;
 
-	waiter = kmalloc(sizeof(*waiter), GFP_KERNEL);
-	if (!waiter) {
-		pr_err("%s: Failed to allocate waiter\n", __func__);
-		return -ENOMEM;
-	}
-
 	waiter->job = job;
 
+	/* -ENOENT: 'input fence' has been already signaled */
 	ret = dma_fence_add_callback(in_fence, &waiter->waiter, func);
-	if (ret == -ENOENT) {
-		pr_err("'input fence' has been already signaled.");
-		goto err_free_waiter;
-	} else if (ret == -EINVAL) {
-		pr_err
-			("%s: failed to add callback to dma_fence, err: %d\n",
-			 __func__, ret);
-		goto err_free_waiter;
-	}
-
-	return ret;
+	if (ret == -EINVAL)
+		pr_err("%s: failed to add callback to dma_fence, err: %d\n",
+		       __func__, ret);
 
-err_free_waiter:
-	kfree(waiter);
 	return ret;
 }
@@ -93,6 +93,9 @@ struct rve_internal_ctx_t *rve_job_get_internal_ctx(struct rve_job *job)
 static void rve_job_free(struct rve_job *job)
 {
 #ifdef CONFIG_SYNC_FILE
+	if (job->in_fence)
+		dma_fence_put(job->in_fence);
+
 	if (job->out_fence)
 		dma_fence_put(job->out_fence);
 #endif
@@ -100,6 +103,41 @@ static void rve_job_free(struct rve_job *job)
 	free_page((unsigned long)job);
 }
 
+/*
+ * Release a job that never reached the hardware. If its input fence
+ * callback is already running, the callback frees the job instead.
+ */
+static void rve_job_cancel(struct rve_job *job)
+{
+#ifdef CONFIG_SYNC_FILE
+	struct rve_scheduler_t *scheduler = rve_job_get_scheduler(job);
+	unsigned long flags;
+	bool pending;
+
+	spin_lock_irqsave(&scheduler->irq_lock, flags);
+	pending = !job->ready;
+	spin_unlock_irqrestore(&scheduler->irq_lock, flags);
+
+	if (pending &&
+	    !dma_fence_remove_callback(job->in_fence, &job->fence_waiter.waiter)) {
+		spin_lock_irqsave(&scheduler->irq_lock, flags);
+		if (!job->ready) {
+			job->flags |= RVE_JOB_CANCELED;
+			spin_unlock_irqrestore(&scheduler->irq_lock, flags);
+			return;
+		}
+		spin_unlock_irqrestore(&scheduler->irq_lock, flags);
+	}
+
+	if (job->out_fence && !dma_fence_is_signaled(job->out_fence)) {
+		dma_fence_set_error(job->out_fence, -ECANCELED);
+		dma_fence_signal(job->out_fence);
+	}
+#endif
+
+	rve_job_free(job);
+}
+
 static int rve_job_cleanup(struct rve_job *job)
 {
 	ktime_t now = ktime_get();
@@ -117,6 +155,7 @@ void rve_job_session_destroy(struct rve_session *session)
 {
 	struct rve_scheduler_t *scheduler = NULL;
 	struct rve_job *job_pos, *job_q;
+	LIST_HEAD(cancel_list);
 	int i;
 
 	unsigned long flags;
@@ -128,18 +167,18 @@ void rve_job_session_destroy(struct rve_session *session)
 
 		list_for_each_entry_safe(job_pos, job_q, &scheduler->todo_list, head) {
 			if (session == job_pos->session) {
-				list_del(&job_pos->head);
-
-				spin_unlock_irqrestore(&scheduler->irq_lock, flags);
-
-				rve_job_free(job_pos);
-
-				spin_lock_irqsave(&scheduler->irq_lock, flags);
+				list_move_tail(&job_pos->head, &cancel_list);
+				scheduler->job_count--;
 			}
 		}
 
 		spin_unlock_irqrestore(&scheduler->irq_lock, flags);
 	}
+
+	list_for_each_entry_safe(job_pos, job_q, &cancel_list, head) {
+		list_del_init(&job_pos->head);
+		rve_job_cancel(job_pos);
+	}
 }
 
 static struct rve_job *rve_job_alloc(struct rve_internal_ctx_t *ctx)
@@ -155,6 +194,7 @@ static struct rve_job *rve_job_alloc(struct rve_internal_ctx_t *ctx)
 #endif
 	INIT_LIST_HEAD(&job->head);
 
+	job->ready = true;
 	job->timestamp = ktime_get();
 	job->pid = current->pid;
 	job->regcmd_data = &ctx->regcmd_data[ctx->running_job_count];
@@ -223,6 +263,38 @@ failed:
 	return ret;
 }
 
+/*
+ * Only the oldest queued job of each ctx is a candidate, so a ctx's jobs
+ * run in submission order and a ctx waiting on its input fence does not
+ * hold up the others. The highest priority candidate wins, ties go to the
+ * ctx that got the hardware least recently.
+ */
+static struct rve_job *rve_job_pick_next(struct rve_scheduler_t *scheduler)
+{
+	struct rve_job *job, *next = NULL;
+	u32 gen = ++scheduler->pick_gen;
+
+	list_for_each_entry(job, &scheduler->todo_list, head) {
+		if (job->ctx->pick_gen == gen)
+			continue;
+
+		job->ctx->pick_gen = gen;
+
+		if (!job->ready)
+			continue;
+
+		if (!next || job->priority > next->priority ||
+		    (job->priority == next->priority &&
+		     job->ctx->sched_seq < next->ctx->sched_seq))
+			next = job;
+	}
+
+	if (next)
+		next->ctx->sched_seq = ++scheduler->sched_seq;
+
+	return next;
+}
+
 static void rve_job_next(struct rve_scheduler_t *scheduler)
 {
 	struct rve_job *job = NULL;
@@ -237,7 +309,11 @@ next_job:
 		return;
 	}
 
-	job = list_first_entry(&scheduler->todo_list, struct rve_job, head);
+	job = rve_job_pick_next(scheduler);
+	if (!job) {
+		spin_unlock_irqrestore(&scheduler->irq_lock, flags);
+		return;
+	}
 
 	list_del_init(&job->head);
 
@@ -266,6 +342,14 @@ next_job:
 	}
 }
 
+void rve_job_kick_work(struct work_struct *work)
+{
+	struct rve_scheduler_t *scheduler =
+		container_of(work, struct rve_scheduler_t, kick_work);
+
+	rve_job_next(scheduler);
+}
+
 static void rve_job_finish_and_next(struct rve_job *job, int ret)
 {
 	ktime_t now = ktime_get();
@@ -307,6 +391,9 @@ void rve_job_done(struct rve_scheduler_t *scheduler, int ret)
 
 	scheduler->timer.busy_time += ktime_us_delta(now, job->hw_recoder_time);
 
+	scheduler->latency_hist[min_t(int, fls(ktime_us_delta(now, job->timestamp)),
+				      RVE_HIST_BUCKETS - 1)]++;
+
 	rve_scheduler_set_pid_info(job, now);
 
 	spin_unlock_irqrestore(&scheduler->irq_lock, flags);
@@ -357,6 +444,7 @@ static void rve_job_timeout_clean(struct rve_scheduler_t *scheduler)
 
 		scheduler->ops->soft_reset(scheduler);
 
+		job->ret = -ETIMEDOUT;
 		rve_internal_ctx_signal(job);
 
 #ifndef RVE_PD_AWAYS_ON
@@ -383,6 +471,10 @@ static struct rve_scheduler_t *rve_job_schedule(struct rve_job *job)
 	/* Only async will timeout clean */
 	rve_job_timeout_clean(scheduler);
 
+	/*
+	 * Jobs still waiting for their input fence are queued too, they are
+	 * skipped by rve_job_next() until the fence callback marks them ready.
+	 */
 	spin_lock_irqsave(&scheduler->irq_lock, flags);
 
 	/* priority policy set by userspace */
@@ -410,6 +502,7 @@ static struct rve_scheduler_t *rve_job_schedule(struct rve_job *job)
 	}
 
 	scheduler->job_count++;
+	scheduler->depth_hist[min(scheduler->job_count, RVE_HIST_BUCKETS - 1)]++;
 
 	spin_unlock_irqrestore(&scheduler->irq_lock, flags);
 
@@ -483,7 +576,10 @@ static void rve_job_input_fence_signaled(struct dma_fence *fence,
 					 struct dma_fence_cb *_waiter)
 {
 	struct rve_fence_waiter *waiter = (struct rve_fence_waiter *)_waiter;
-	struct rve_scheduler_t *scheduler = NULL;
+	struct rve_job *job = waiter->job;
+	struct rve_scheduler_t *scheduler = rve_job_get_scheduler(job);
+	unsigned long flags;
+	bool canceled;
 
 	ktime_t now;
 
@@ -491,14 +587,22 @@ static void rve_job_input_fence_signaled(struct dma_fence *fence,
 
 	if (DEBUGGER_EN(TIME))
 		pr_err("rve job wait in_fence signal use time = %lld\n",
-			ktime_to_us(ktime_sub(now, waiter->job->timestamp)));
+			ktime_to_us(ktime_sub(now, job->timestamp)));
+
+	spin_lock_irqsave(&scheduler->irq_lock, flags);
 
-	scheduler = rve_job_schedule(waiter->job);
+	job->ready = true;
+	canceled = job->flags & RVE_JOB_CANCELED;
 
-	if (scheduler == NULL)
-		pr_err("failed to get scheduler, %s(%d)\n", __func__, __LINE__);
+	spin_unlock_irqrestore(&scheduler->irq_lock, flags);
 
-	kfree(waiter);
+	if (canceled) {
+		rve_job_cancel(job);
+		return;
+	}
+
+	/* May be called from the signaler's irq context, run the job later */
+	queue_work(system_highpri_wq, &scheduler->kick_work);
 }
 #endif
 
@@ -519,7 +623,8 @@ int rve_job_config_by_user_ctx(struct rve_user_ctx_t *user_ctx)
 
 	spin_lock_irqsave(&ctx->lock, flags);
 
-	if (ctx->is_running) {
+	/* queued jobs run from their own copy of the commands */
+	if (ctx->is_running && !ctx->queued_job_count) {
 		pr_err("can not re-config when ctx is running");
 		spin_unlock_irqrestore(&ctx->lock, flags);
 		return -EFAULT;
@@ -568,6 +673,7 @@ int rve_job_commit_by_user_ctx(struct rve_user_ctx_t *user_ctx)
 	struct rve_internal_ctx_t *ctx;
 	int ret = 0;
 	unsigned long flags;
+	bool queue;
 	int i;
 
 	ctx_manager = rve_drvdata->pend_ctx_manager;
@@ -578,14 +684,27 @@ int rve_job_commit_by_user_ctx(struct rve_user_ctx_t *user_ctx)
 		return -EINVAL;
 	}
 
+	/*
+	 * An async ctx that is not auto canceled may keep several commits in
+	 * flight, each waiting on its own input fence and signaling its own
+	 * output fence, so a pipeline never waits on userspace in between.
+	 */
+	queue = user_ctx->sync_mode == RVE_ASYNC && user_ctx->disable_auto_cancel;
+
 	spin_lock_irqsave(&ctx->lock, flags);
 
-	if (ctx->is_running) {
+	if (ctx->is_running && (!queue || !ctx->queued_job_count)) {
 		pr_err("can not re-config when ctx is running");
 		spin_unlock_irqrestore(&ctx->lock, flags);
 		return -EFAULT;
 	}
 
+	if (queue && ctx->queued_job_count + ctx->cmd_num > RVE_CTX_QUEUE_DEPTH_MAX) {
+		pr_err("ctx[%d] queue is full", ctx->id);
+		spin_unlock_irqrestore(&ctx->lock, flags);
+		return -EBUSY;
+	}
+
 	/* Reset */
 	ctx->finished_job_count = 0;
 	ctx->running_job_count = 0;
@@ -596,12 +715,24 @@ int rve_job_commit_by_user_ctx(struct rve_user_ctx_t *user_ctx)
 	if (ctx->sync_mode == 0)
 		ctx->sync_mode = RVE_SYNC;
 
+	if (queue)
+		ctx->queued_job_count += ctx->cmd_num;
+
 	spin_unlock_irqrestore(&ctx->lock, flags);
 
 	for (i = 0; i < ctx->cmd_num; i++) {
 		ret = rve_job_commit(ctx);
 		if (ret < 0) {
 			pr_err("rve_job_commit failed, i = %d\n", i);
+
+			if (queue) {
+				spin_lock_irqsave(&ctx->lock, flags);
+				ctx->queued_job_count -= ctx->cmd_num - i;
+				if (!ctx->queued_job_count)
+					ctx->is_running = false;
+				spin_unlock_irqrestore(&ctx->lock, flags);
+			}
+
 			return -EFAULT;
 		}
 
@@ -661,20 +792,40 @@ int rve_job_commit(struct rve_internal_ctx_t *ctx)
 #ifdef CONFIG_SYNC_FILE
 		job->flags |= RVE_ASYNC;
 
-		if (!ctx->out_fence) {
+		if (ctx->disable_auto_cancel) {
+			/* ctx may be re-configured before this job runs */
+			job->flags |= RVE_JOB_QUEUED;
+			job->regcmd = *job->regcmd_data;
+			job->regcmd_data = &job->regcmd;
+
 			ret = rve_out_fence_alloc(job);
 			if (ret) {
 				rve_job_free(job);
 				return ret;
 			}
-		}
 
-		ctx->out_fence = job->out_fence;
+			/* jobs of a ctx finish in order, export the last one */
+			if (ctx->running_job_count == ctx->cmd_num - 1) {
+				ctx->out_fence_fd = rve_out_fence_get_fd(job);
+				if (ctx->out_fence_fd < 0)
+					pr_err("out fence get fd failed");
+			}
+		} else {
+			if (!ctx->out_fence) {
+				ret = rve_out_fence_alloc(job);
+				if (ret) {
+					rve_job_free(job);
+					return ret;
+				}
+			}
 
-		ctx->out_fence_fd = rve_out_fence_get_fd(job);
+			ctx->out_fence = job->out_fence;
 
-		if (ctx->out_fence_fd < 0)
-			pr_err("out fence get fd failed");
+			ctx->out_fence_fd = rve_out_fence_get_fd(job);
+
+			if (ctx->out_fence_fd < 0)
+				pr_err("out fence get fd failed");
+		}
 
 		if (DEBUGGER_EN(MSG))
 			pr_info("in_fence_fd = %d", ctx->in_fence_fd);
@@ -687,48 +838,45 @@ int rve_job_commit(struct rve_internal_ctx_t *ctx)
 				pr_err("%s: failed to get input dma_fence\n",
 					 __func__);
 				rve_job_free(job);
-				return ret;
+				return -EINVAL;
 			}
 
 			/* close input fence fd */
 			ksys_close(ctx->in_fence_fd);
 
+			job->in_fence = in_fence;
+
 			ret = dma_fence_get_status(in_fence);
-			/* ret = 1: fence has been signaled */
-			if (ret == 1) {
-				scheduler = rve_job_schedule(job);
-
-				if (scheduler == NULL) {
-					pr_err("failed to get scheduler, %s(%d)\n",
-						 __func__, __LINE__);
-					goto invalid_job;
-				}
-				/* if input fence is valid */
-			} else if (ret == 0) {
+			/* ret = 0: fence is not signaled yet */
+			if (ret == 0) {
+				job->ready = false;
+
 				ret = rve_add_dma_fence_callback(job,
 					in_fence, rve_job_input_fence_signaled);
-				if (ret < 0) {
+				if (ret == -ENOENT) {
+					job->ready = true;
+				} else if (ret < 0) {
 					pr_err("%s: failed to add fence callback\n",
 						 __func__);
 					rve_job_free(job);
 					return ret;
 				}
-			} else {
+			} else if (ret < 0) {
 				pr_err("%s: fence status error\n", __func__);
 				rve_job_free(job);
 				return ret;
 			}
-		} else {
-			scheduler = rve_job_schedule(job);
+		}
 
-			if (scheduler == NULL) {
-				pr_err("failed to get scheduler, %s(%d)\n",
-					 __func__, __LINE__);
-				goto invalid_job;
-			}
+		scheduler = rve_job_schedule(job);
+
+		if (scheduler == NULL) {
+			pr_err("failed to get scheduler, %s(%d)\n",
+				 __func__, __LINE__);
+			goto invalid_job;
 		}
 
-		return ret;
+		return 0;
 #else
 		pr_err("can not support ASYNC mode, please enable CONFIG_SYNC_FILE");
 		return -EFAULT;
@@ -838,6 +986,26 @@ int rve_internal_ctx_signal(struct rve_job *job)
 		return -EINVAL;
 	}
 
+	if (job->flags & RVE_JOB_QUEUED) {
+#ifdef CONFIG_SYNC_FILE
+		if (job->ret < 0)
+			dma_fence_set_error(job->out_fence, job->ret);
+		dma_fence_signal(job->out_fence);
+#endif
+		job->flags |= RVE_JOB_DONE;
+
+		spin_lock_irqsave(&ctx->lock, flags);
+
+		if (--ctx->queued_job_count == 0)
+			ctx->is_running = false;
+
+		spin_unlock_irqrestore(&ctx->lock, flags);
+
+		rve_job_cleanup(job);
+
+		return 0;
+	}
+
 	ctx->regcmd_data = job->regcmd_data;
 
 	spin_lock_irqsave(&ctx->lock, flags);
@@ -935,6 +1103,7 @@ void rve_internal_ctx_kref_release(struct kref *ref)
 	struct rve_internal_ctx_t *ctx;
 	struct rve_scheduler_t *scheduler = NULL;
 	struct rve_job *job_pos, *job_q, *job;
+	LIST_HEAD(cancel_list);
 	int i;
 	bool need_reset = false;
 	unsigned long flags;
@@ -960,6 +1129,10 @@ void rve_internal_ctx_kref_release(struct kref *ref)
 				list_del_init(&job_pos->head);
 
 				scheduler->job_count--;
+
+				/* nobody waits for async jobs, release them here */
+				if (job_pos->flags & RVE_ASYNC)
+					list_add_tail(&job_pos->head, &cancel_list);
 			}
 		}
 
@@ -976,6 +1149,11 @@ void rve_internal_ctx_kref_release(struct kref *ref)
 
 		spin_unlock_irqrestore(&scheduler->irq_lock, flags);
 
+		list_for_each_entry_safe(job_pos, job_q, &cancel_list, head) {
+			list_del_init(&job_pos->head);
+			rve_job_cancel(job_pos);
+		}
+
 		if (need_reset) {
 			pr_err("reset core[%d] by user cancel", scheduler->core);
 			scheduler->ops->soft_reset(scheduler);
@@ -31,10 +31,10 @@ static uint32_t none_stat_compr_blocks=0,none_stat_decompr_blocks=0,none_stat_co
 /*
  * Return 1 to use this compression
  */
-static int jffs2_is_best_compression(struct jffs2_compressor *this,
+static int jffs2_is_best_compression(int mode, struct jffs2_compressor *this,
 		struct jffs2_compressor *best, uint32_t size, uint32_t bestsize)
 {
-	switch (jffs2_compression_mode) {
+	switch (mode) {
 	case JFFS2_COMPR_MODE_SIZE:
 		if (bestsize > size)
 			return 1;
@@ -127,6 +127,25 @@ static int jffs2_selected_compress(u8 compr, unsigned char *data_in,
 	return ret;
 }
 
+/*
+ * Track whether the inode's data compresses, and stop trying for a while
+ * once it keeps failing: every failed attempt costs a full trial compression
+ * (several of them in "size" mode), which is what dominates writes of
+ * already-compressed data on slow single-core parts.
+ */
+static void jffs2_compr_account(struct jffs2_inode_info *f, int compressed)
+{
+	if (compressed) {
+		f->compr_fails = 0;
+		return;
+	}
+
+	if (f->compr_fails < JFFS2_COMPR_SKIP_AFTER)
+		f->compr_fails++;
+	if (f->compr_fails == JFFS2_COMPR_SKIP_AFTER)
+		f->compr_skip = JFFS2_COMPR_SKIP_NODES;
+}
+
 /* jffs2_compress:
  * @data_in: Pointer to uncompressed data
  * @cpage_out: Pointer to returned pointer to buffer for compressed data
@@ -144,6 +163,9 @@ static int jffs2_selected_compress(u8 compr, unsigned char *data_in,
  * If the cdata buffer isn't large enough to hold all the uncompressed data,
  * jffs2_compress should compress as much as will fit, and should set
  * *datalen accordingly to show the amount of data which were compressed.
+ *
+ * The mode is taken from the inode's "user.jffs2.compr" xattr if it has one,
+ * then from the "compr=" mount option, then from the default mode.
  */
 uint16_t jffs2_compress(struct jffs2_sb_info *c, struct jffs2_inode_info *f,
 			unsigned char *data_in, unsigned char **cpage_out,
@@ -155,12 +177,20 @@ uint16_t jffs2_compress(struct jffs2_sb_info *c, struct jffs2_inode_info *f,
 	unsigned char *output_buf = NULL, *tmp_buf;
 	uint32_t orig_slen, orig_dlen;
 	uint32_t best_slen=0, best_dlen=0;
+	uint32_t in_len = *datalen;
 
-	if (c->mount_opts.override_compr)
+	if (f->compr_mode < JFFS2_COMPR_MODE_DEFAULT)
+		mode = f->compr_mode;
+	else if (c->mount_opts.override_compr)
 		mode = c->mount_opts.compr;
 	else
 		mode = jffs2_compression_mode;
 
+	if (mode != JFFS2_COMPR_MODE_NONE && f->compr_skip) {
+		f->compr_skip--;
+		mode = JFFS2_COMPR_MODE_NONE;
+	}
+
 	switch (mode) {
 	case JFFS2_COMPR_MODE_NONE:
 		break;
@@ -207,7 +237,7 @@ uint16_t jffs2_compress(struct jffs2_sb_info *c, struct jffs2_inode_info *f,
 			spin_lock(&jffs2_compressor_list_lock);
 			this->usecount--;
 			if (!compr_ret) {
-				if (((!best_dlen) || jffs2_is_best_compression(this, best, *cdatalen, best_dlen))
+				if (((!best_dlen) || jffs2_is_best_compression(mode, this, best, *cdatalen, best_dlen))
 						&& (*cdatalen < *datalen)) {
 					best_dlen = *cdatalen;
 					best_slen = *datalen;
@@ -237,10 +267,21 @@ uint16_t jffs2_compress(struct jffs2_sb_info *c, struct jffs2_inode_info *f,
 		ret = jffs2_selected_compress(JFFS2_COMPR_ZLIB, data_in,
 				cpage_out, datalen, cdatalen);
 		break;
+	case JFFS2_COMPR_MODE_FORCELZ4:
+		ret = jffs2_selected_compress(JFFS2_COMPR_LZ4, data_in,
+				cpage_out, datalen, cdatalen);
+		break;
+	case JFFS2_COMPR_MODE_FORCEZSTD:
+		ret = jffs2_selected_compress(JFFS2_COMPR_ZSTD, data_in,
+				cpage_out, datalen, cdatalen);
+		break;
 	default:
 		pr_err("unknown compression mode\n");
 	}
 
+	if (mode != JFFS2_COMPR_MODE_NONE && in_len >= JFFS2_COMPR_SKIP_MINLEN)
+		jffs2_compr_account(f, ret != JFFS2_COMPR_NONE);
+
 	if (ret == JFFS2_COMPR_NONE) {
 		*cpage_out = data_in;
 		*datalen = *cdatalen;
@@ -362,6 +403,75 @@ void jffs2_free_comprbuf(unsigned char *comprbuf, unsigned char *orig)
 		kfree(comprbuf);
 }
 
+static const struct {
+	const char *name;
+	int mode;
+} jffs2_compr_modes[] = {
+	{ "none",	JFFS2_COMPR_MODE_NONE },
+	{ "priority",	JFFS2_COMPR_MODE_PRIORITY },
+	{ "size",	JFFS2_COMPR_MODE_SIZE },
+	{ "favourlzo",	JFFS2_COMPR_MODE_FAVOURLZO },
+#ifdef CONFIG_JFFS2_LZO
+	{ "lzo",	JFFS2_COMPR_MODE_FORCELZO },
+#endif
+#ifdef CONFIG_JFFS2_ZLIB
+	{ "zlib",	JFFS2_COMPR_MODE_FORCEZLIB },
+#endif
+#ifdef CONFIG_JFFS2_LZ4
+	{ "lz4",	JFFS2_COMPR_MODE_FORCELZ4 },
+#endif
+#ifdef CONFIG_JFFS2_ZSTD
+	{ "zstd",	JFFS2_COMPR_MODE_FORCEZSTD },
+#endif
+};
+
+/*
+ * Parse a "user.jffs2.compr" xattr value. Returns the compression mode, or
+ * -EINVAL if the name is unknown or its compressor is not built in.
+ */
+int jffs2_compr_parse_mode(const char *buf, size_t len)
+{
+	int i;
+
+	/* Tolerate "echo"-style values */
+	while (len && (buf[len - 1] == '\n' || buf[len - 1] == '\0'))
+		len--;
+
+	for (i = 0; i < ARRAY_SIZE(jffs2_compr_modes); i++) {
+		if (strlen(jffs2_compr_modes[i].name) == len &&
+		    !memcmp(jffs2_compr_modes[i].name, buf, len))
+			return jffs2_compr_modes[i].mode;
+	}
+	return -EINVAL;
+}
+
+#ifdef CONFIG_JFFS2_FS_XATTR
+/*
+ * Look up the inode's compression policy when it is read in, so that both
+ * writes and GC follow it. Setting the xattr updates it directly.
+ */
+void jffs2_compr_load_policy(struct inode *inode)
+{
+	struct jffs2_inode_info *f = JFFS2_INODE_INFO(inode);
+	int mode = JFFS2_COMPR_MODE_DEFAULT;
+	char buf[16];
+	int len;
+
+	if (READ_ONCE(f->compr_mode) != JFFS2_COMPR_MODE_UNKNOWN)
+		return;
+
+	len = do_jffs2_getxattr(inode, JFFS2_XPREFIX_USER, JFFS2_COMPR_XATTR,
+				buf, sizeof(buf));
+	if (len > 0) {
+		mode = jffs2_compr_parse_mode(buf, len);
+		if (mode < 0)
+			mode = JFFS2_COMPR_MODE_DEFAULT;
+	}
+
+	WRITE_ONCE(f->compr_mode, mode);
+}
+#endif
+
 int __init jffs2_compressors_init(void)
 {
 /* Registering compressors */
@@ -378,6 +488,12 @@ int __init jffs2_compressors_init(void)
 #ifdef CONFIG_JFFS2_LZO
 	jffs2_lzo_init();
 #endif
+#ifdef CONFIG_JFFS2_LZ4
+	jffs2_lz4_init();
+#endif
+#ifdef CONFIG_JFFS2_ZSTD
+	jffs2_zstd_init();
+#endif
 /* Setting default compression mode */
 #ifdef CONFIG_JFFS2_CMODE_NONE
 	jffs2_compression_mode = JFFS2_COMPR_MODE_NONE;
@@ -401,6 +517,12 @@ int __init jffs2_compressors_init(void)
 int jffs2_compressors_exit(void)
 {
 /* Unregistering compressors */
+#ifdef CONFIG_JFFS2_ZSTD
+	jffs2_zstd_exit();
+#endif
+#ifdef CONFIG_JFFS2_LZ4
+	jffs2_lz4_exit();
+#endif
 #ifdef CONFIG_JFFS2_LZO
 	jffs2_lzo_exit();
 #endif
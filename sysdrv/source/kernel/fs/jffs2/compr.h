@@ -30,7 +30,9 @@
 #define JFFS2_LZARI_PRIORITY     30
 #define JFFS2_RTIME_PRIORITY     50
 #define JFFS2_ZLIB_PRIORITY      60
+#define JFFS2_ZSTD_PRIORITY      70
 #define JFFS2_LZO_PRIORITY       80
+#define JFFS2_LZ4_PRIORITY       90
 
 
 #define JFFS2_RUBINMIPS_DISABLED /* RUBINs will be used only */
@@ -42,9 +44,23 @@
 #define JFFS2_COMPR_MODE_FAVOURLZO  3
 #define JFFS2_COMPR_MODE_FORCELZO   4
 #define JFFS2_COMPR_MODE_FORCEZLIB  5
+#define JFFS2_COMPR_MODE_FORCELZ4   6
+#define JFFS2_COMPR_MODE_FORCEZSTD  7
+
+/* Name of the xattr (in the "user." namespace) holding the inode's policy */
+#define JFFS2_COMPR_XATTR           "jffs2.compr"
 
 #define FAVOUR_LZO_PERCENT 80
 
+/*
+ * After JFFS2_COMPR_SKIP_AFTER nodes of an inode in a row did not compress,
+ * the next JFFS2_COMPR_SKIP_NODES nodes are stored without trying. Nodes
+ * shorter than JFFS2_COMPR_SKIP_MINLEN do not count either way.
+ */
+#define JFFS2_COMPR_SKIP_AFTER   4
+#define JFFS2_COMPR_SKIP_NODES   16
+#define JFFS2_COMPR_SKIP_MINLEN  512
+
 struct jffs2_compressor {
 	struct list_head list;
 	int priority;			/* used by prirority comr. mode */
@@ -80,6 +96,13 @@ int jffs2_decompress(struct jffs2_sb_info *c, struct jffs2_inode_info *f,
 
 void jffs2_free_comprbuf(unsigned char *comprbuf, unsigned char *orig);
 
+int jffs2_compr_parse_mode(const char *buf, size_t len);
+#ifdef CONFIG_JFFS2_FS_XATTR
+void jffs2_compr_load_policy(struct inode *inode);
+#else
+static inline void jffs2_compr_load_policy(struct inode *inode) { }
+#endif
+
 /* Compressor modules */
 /* These functions will be called by jffs2_compressors_init/exit */
 
@@ -101,5 +124,13 @@ void jffs2_zlib_exit(void);
 int jffs2_lzo_init(void);
 void jffs2_lzo_exit(void);
 #endif
+#ifdef CONFIG_JFFS2_LZ4
+int jffs2_lz4_init(void);
+void jffs2_lz4_exit(void);
+#endif
+#ifdef CONFIG_JFFS2_ZSTD
+int jffs2_zstd_init(void);
+void jffs2_zstd_exit(void);
+#endif
 
 #endif /* __JFFS2_COMPR_H__ */
@@ -0,0 +1,81 @@
+/*
+ * JFFS2 -- Journalling Flash File System, Version 2.
+ *
+ * Copyright (c) 2023 Rockchip Electronics Co., Ltd.
+ *
+ * Based on compr_lzo.c
+ *
+ * For licensing information, see the file 'LICENCE' in this directory.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/init.h>
+#include <linux/lz4.h>
+#include "compr.h"
+
+static void *lz4_mem;
+static DEFINE_MUTEX(lz4_mutex);	/* for lz4_mem */
+
+static int jffs2_lz4_compress(unsigned char *data_in, unsigned char *cpage_out,
+			      uint32_t *sourcelen, uint32_t *dstlen)
+{
+	int compress_size;
+
+	/* LZ4 fails rather than overrun the output, so no bounce buffer */
+	mutex_lock(&lz4_mutex);
+	compress_size = LZ4_compress_default(data_in, cpage_out, *sourcelen,
+					     *dstlen, lz4_mem);
+	mutex_unlock(&lz4_mutex);
+
+	if (compress_size <= 0)
+		return -1;
+
+	*dstlen = compress_size;
+	return 0;
+}
+
+static int jffs2_lz4_decompress(unsigned char *data_in, unsigned char *cpage_out,
+				uint32_t srclen, uint32_t destlen)
+{
+	int ret;
+
+	ret = LZ4_decompress_safe(data_in, cpage_out, srclen, destlen);
+
+	if (ret != destlen)
+		return -1;
+
+	return 0;
+}
+
+static struct jffs2_compressor jffs2_lz4_comp = {
+	.priority = JFFS2_LZ4_PRIORITY,
+	.name = "lz4",
+	.compr = JFFS2_COMPR_LZ4,
+	.compress = &jffs2_lz4_compress,
+	.decompress = &jffs2_lz4_decompress,
+	.disabled = 0,
+};
+
+int __init jffs2_lz4_init(void)
+{
+	int ret;
+
+	lz4_mem = vmalloc(LZ4_MEM_COMPRESS);
+	if (!lz4_mem)
+		return -ENOMEM;
+
+	ret = jffs2_register_compressor(&jffs2_lz4_comp);
+	if (ret)
+		vfree(lz4_mem);
+
+	return ret;
+}
+
+void jffs2_lz4_exit(void)
+{
+	jffs2_unregister_compressor(&jffs2_lz4_comp);
+	vfree(lz4_mem);
+}
@@ -0,0 +1,124 @@
+/*
+ * JFFS2 -- Journalling Flash File System, Version 2.
+ *
+ * Copyright (c) 2023 Rockchip Electronics Co., Ltd.
+ *
+ * Based on compr_lzo.c
+ *
+ * For licensing information, see the file 'LICENCE' in this directory.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/init.h>
+#include <linux/zstd.h>
+#include "compr.h"
+
+/*
+ * Nodes hold at most a page of data, a low level is close to the best ratio
+ * zstd reaches on such small inputs and keeps the matcher tables small.
+ */
+#define JFFS2_ZSTD_LEVEL 3
+
+static ZSTD_parameters zstd_params;
+static void *zstd_cwksp;
+static void *zstd_dwksp;
+static ZSTD_CCtx *zstd_cctx;
+static ZSTD_DCtx *zstd_dctx;
+static DEFINE_MUTEX(zstd_cmutex);	/* for zstd_cctx */
+static DEFINE_MUTEX(zstd_dmutex);	/* for zstd_dctx */
+
+static void free_workspace(void)
+{
+	vfree(zstd_cwksp);
+	vfree(zstd_dwksp);
+}
+
+static int __init alloc_workspace(void)
+{
+	size_t csize, dsize;
+
+	zstd_params = ZSTD_getParams(JFFS2_ZSTD_LEVEL, PAGE_SIZE, 0);
+	csize = ZSTD_CCtxWorkspaceBound(zstd_params.cParams);
+	dsize = ZSTD_DCtxWorkspaceBound();
+
+	zstd_cwksp = vmalloc(csize);
+	zstd_dwksp = vmalloc(dsize);
+	if (!zstd_cwksp || !zstd_dwksp)
+		goto fail;
+
+	zstd_cctx = ZSTD_initCCtx(zstd_cwksp, csize);
+	zstd_dctx = ZSTD_initDCtx(zstd_dwksp, dsize);
+	if (!zstd_cctx || !zstd_dctx)
+		goto fail;
+
+	return 0;
+
+ fail:
+	free_workspace();
+	return -ENOMEM;
+}
+
+static int jffs2_zstd_compress(unsigned char *data_in, unsigned char *cpage_out,
+			       uint32_t *sourcelen, uint32_t *dstlen)
+{
+	size_t compress_size;
+
+	mutex_lock(&zstd_cmutex);
+	compress_size = ZSTD_compressCCtx(zstd_cctx, cpage_out, *dstlen,
+					  data_in, *sourcelen, zstd_params);
+	mutex_unlock(&zstd_cmutex);
+
+	if (ZSTD_isError(compress_size))
+		return -1;
+
+	*dstlen = compress_size;
+	return 0;
+}
+
+static int jffs2_zstd_decompress(unsigned char *data_in, unsigned char *cpage_out,
+				 uint32_t srclen, uint32_t destlen)
+{
+	size_t dl;
+
+	mutex_lock(&zstd_dmutex);
+	dl = ZSTD_decompressDCtx(zstd_dctx, cpage_out, destlen, data_in, srclen);
+	mutex_unlock(&zstd_dmutex);
+
+	if (ZSTD_isError(dl) || dl != destlen)
+		return -1;
+
+	return 0;
+}
+
+static struct jffs2_compressor jffs2_zstd_comp = {
+	.priority = JFFS2_ZSTD_PRIORITY,
+	.name = "zstd",
+	.compr = JFFS2_COMPR_ZSTD,
+	.compress = &jffs2_zstd_compress,
+	.decompress = &jffs2_zstd_decompress,
+	.disabled = 0,
+};
+
+int __init jffs2_zstd_init(void)
+{
+	int ret;
+
+	ret = alloc_workspace();
+	if (ret < 0)
+		return ret;
+
+	ret = jffs2_register_compressor(&jffs2_zstd_comp);
+	if (ret)
+		free_workspace();
+
+	return ret;
+}
+
+void jffs2_zstd_exit(void)
+{
+	jffs2_unregister_compressor(&jffs2_zstd_comp);
+	free_workspace();
+}
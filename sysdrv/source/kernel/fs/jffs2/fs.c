@@ -26,6 +26,7 @@
 #include <linux/vfs.h>
 #include <linux/crc32.h>
 #include "nodelist.h"
+#include "compr.h"
 
 static int jffs2_flash_setup(struct jffs2_sb_info *c);
 
@@ -318,6 +319,8 @@ struct inode *jffs2_iget(struct super_block *sb, unsigned long ino)
 		inode->i_fop = &jffs2_file_operations;
 		inode->i_mapping->a_ops = &jffs2_file_address_operations;
 		inode->i_mapping->nrpages = 0;
+		/* GC recompresses the data too, so the policy is needed now */
+		jffs2_compr_load_policy(inode);
 		break;
 
 	case S_IFBLK:
@@ -17,6 +17,10 @@
 #include <linux/posix_acl.h>
 #include <linux/mutex.h>
 
+/* jffs2_inode_info.compr_mode values besides JFFS2_COMPR_MODE_xxx */
+#define JFFS2_COMPR_MODE_DEFAULT 0xfe	/* no policy xattr, use the mount's */
+#define JFFS2_COMPR_MODE_UNKNOWN 0xff	/* policy xattr not looked up yet */
+
 struct jffs2_inode_info {
 	/* We need an internal mutex similar to inode->i_mutex.
 	   Unfortunately, we can't used the existing one, because
@@ -50,6 +54,12 @@ struct jffs2_inode_info {
 
 	uint16_t flags;
 	uint8_t usercompr;
+
+	/* Compression policy, JFFS2_COMPR_MODE_xxx, and the state used to
+	   stop trying to compress data which does not compress */
+	uint8_t compr_mode;
+	uint8_t compr_fails;
+	uint8_t compr_skip;
 	struct inode vfs_inode;
 };
 
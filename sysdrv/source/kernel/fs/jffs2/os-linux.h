@@ -57,6 +57,9 @@ static inline void jffs2_init_inode_info(struct jffs2_inode_info *f)
 	f->target = NULL;
 	f->flags = 0;
 	f->usercompr = 0;
+	f->compr_mode = JFFS2_COMPR_MODE_UNKNOWN;
+	f->compr_fails = 0;
+	f->compr_skip = 0;
 }
 
 
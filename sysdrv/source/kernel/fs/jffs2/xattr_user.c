@@ -15,6 +15,7 @@
 #include <linux/xattr.h>
 #include <linux/mtd/mtd.h>
 #include "nodelist.h"
+#include "compr.h"
 
 static int jffs2_user_getxattr(const struct xattr_handler *handler,
 			       struct dentry *unused, struct inode *inode,
@@ -30,8 +31,23 @@ static int jffs2_user_setxattr(const struct xattr_handler *handler,
 			       const char *name, const void *buffer,
 			       size_t size, int flags)
 {
-	return do_jffs2_setxattr(inode, JFFS2_XPREFIX_USER,
-				 name, buffer, size, flags);
+	bool policy = !strcmp(name, JFFS2_COMPR_XATTR);
+	int mode = JFFS2_COMPR_MODE_DEFAULT;
+	int rc;
+
+	/* Refuse compression policies this kernel could not apply */
+	if (policy && buffer) {
+		mode = jffs2_compr_parse_mode(buffer, size);
+		if (mode < 0)
+			return -EINVAL;
+	}
+
+	rc = do_jffs2_setxattr(inode, JFFS2_XPREFIX_USER,
+			       name, buffer, size, flags);
+	if (!rc && policy)
+		WRITE_ONCE(JFFS2_INODE_INFO(inode)->compr_mode, mode);
+
+	return rc;
 }
 
 const struct xattr_handler jffs2_user_xattr_handler = {
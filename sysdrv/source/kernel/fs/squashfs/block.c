@@ -73,8 +73,8 @@ static int copy_bio_to_actor(struct bio *bio,
 	return copied_bytes;
 }
 
-static int squashfs_bio_read(struct super_block *sb, u64 index, int length,
-			     struct bio **biop, int *block_offset)
+static int squashfs_bio_alloc(struct super_block *sb, u64 index, int length,
+			      struct bio **biop)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
 	const u64 read_start = round_down(index, msblk->devblksize);
@@ -116,18 +116,131 @@ static int squashfs_bio_read(struct super_block *sb, u64 index, int length,
 		total_len -= len;
 	}
 
-	error = submit_bio_wait(bio);
+	*biop = bio;
+	return 0;
+
+out_free_bio:
+	bio_free_pages(bio);
+	bio_put(bio);
+	return error;
+}
+
+static int squashfs_bio_read(struct super_block *sb, u64 index, int length,
+			     struct bio **biop, int *block_offset)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	struct bio *bio;
+	int error;
+
+	error = squashfs_bio_alloc(sb, index, length, &bio);
 	if (error)
-		goto out_free_bio;
+		return error;
+
+	error = submit_bio_wait(bio);
+	if (error) {
+		bio_free_pages(bio);
+		bio_put(bio);
+		return error;
+	}
 
 	*biop = bio;
 	*block_offset = index & ((1 << msblk->devblksize_log2) - 1);
 	return 0;
+}
+
+static void squashfs_bio_end_io(struct bio *bio)
+{
+	complete(bio->bi_private);
+}
+
+/*
+ * Start reading a datablock without waiting for the I/O, so that it can
+ * overlap decompression of the previous block.  Length is the on-disk
+ * length field.  Must be followed by squashfs_read_data_wait() or
+ * squashfs_read_data_cancel().
+ */
+int squashfs_read_data_submit(struct super_block *sb, u64 index, int length,
+			      struct squashfs_read_req *req)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	int size = SQUASHFS_COMPRESSED_SIZE_BLOCK(length);
+	struct bio *bio;
+	int res;
+
+	req->bio = NULL;
+	if (size < 0 || size > msblk->block_size ||
+			(index + size) > msblk->bytes_used)
+		return -EIO;
+
+	res = squashfs_bio_alloc(sb, index, size, &bio);
+	if (res)
+		return res;
+
+	init_completion(&req->done);
+	req->index = index;
+	req->length = length;
+	req->bio = bio;
+	bio->bi_private = &req->done;
+	bio->bi_end_io = squashfs_bio_end_io;
+	submit_bio(bio);
+	return 0;
+}
+
+void squashfs_read_data_cancel(struct squashfs_read_req *req)
+{
+	if (!req->bio)
+		return;
+
+	wait_for_completion_io(&req->done);
+	bio_free_pages(req->bio);
+	bio_put(req->bio);
+	req->bio = NULL;
+}
+
+/*
+ * Wait for a datablock started by squashfs_read_data_submit() and
+ * decompress it into the page actor.
+ */
+int squashfs_read_data_wait(struct super_block *sb,
+			    struct squashfs_read_req *req,
+			    struct squashfs_page_actor *output)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	struct bio *bio = req->bio;
+	int compressed = SQUASHFS_COMPRESSED_BLOCK(req->length);
+	int length = SQUASHFS_COMPRESSED_SIZE_BLOCK(req->length);
+	int offset = req->index & ((1 << msblk->devblksize_log2) - 1);
+	int res;
+
+	wait_for_completion_io(&req->done);
+	req->bio = NULL;
+
+	res = blk_status_to_errno(bio->bi_status);
+	if (res)
+		goto out_free_bio;
+
+	if (length > output->length) {
+		res = -EIO;
+		goto out_free_bio;
+	}
+
+	if (compressed) {
+		if (!msblk->stream) {
+			res = -EIO;
+			goto out_free_bio;
+		}
+		res = squashfs_decompress(msblk, bio, offset, length, output);
+	} else {
+		res = copy_bio_to_actor(bio, output, offset, length);
+	}
 
 out_free_bio:
 	bio_free_pages(bio);
 	bio_put(bio);
-	return error;
+	if (res < 0)
+		ERROR("Failed to read block 0x%llx: %d\n", req->index, res);
+
+	return res;
 }
 
 /*
@@ -19,6 +19,11 @@
  * To avoid out of memory and fragmentation issues with vmalloc the cache
  * uses sequences of kmalloced PAGE_SIZE buffers.
  *
+ * Large caches are set-associative, a block hashes to one set of a few
+ * entries, and each set has its own lock, so lookups of different blocks
+ * only contend when they land in the same set.  Small caches use a single
+ * fully associative set.
+ *
  * It should be noted that the cache is not used for file datablocks, these
  * are decompressed and cached in the page-cache in the normal way.  The
  * cache is only used to temporarily cache fragment and metadata blocks
@@ -39,6 +44,9 @@
 #include <linux/spinlock.h>
 #include <linux/wait.h>
 #include <linux/pagemap.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -52,65 +60,69 @@
 struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 	struct squashfs_cache *cache, u64 block, int length)
 {
-	int i, n;
+	int i, n, first;
+	struct squashfs_cache_set *set;
 	struct squashfs_cache_entry *entry;
 
-	spin_lock(&cache->lock);
+	i = cache->sets > 1 ? hash_64(block, ilog2(cache->sets)) : 0;
+	set = &cache->set[i];
+	first = i * cache->ways;
+
+	spin_lock(&set->lock);
 
 	while (1) {
-		for (i = cache->curr_blk, n = 0; n < cache->entries; n++) {
-			if (cache->entry[i].block == block) {
-				cache->curr_blk = i;
+		for (i = first, n = 0; n < cache->ways; n++, i++)
+			if (cache->entry[i].block == block)
 				break;
-			}
-			i = (i + 1) % cache->entries;
-		}
 
-		if (n == cache->entries) {
+		if (n == cache->ways) {
 			/*
-			 * Block not in cache, if all cache entries are used
-			 * go to sleep waiting for one to become available.
+			 * Block not in cache, if all entries of the set are
+			 * used go to sleep waiting for one to become available.
 			 */
-			if (cache->unused == 0) {
-				cache->num_waiters++;
-				spin_unlock(&cache->lock);
-				wait_event(cache->wait_queue, cache->unused);
-				spin_lock(&cache->lock);
-				cache->num_waiters--;
+			if (set->unused == 0) {
+				set->num_waiters++;
+				set->waits++;
+				spin_unlock(&set->lock);
+				wait_event(set->wait_queue, set->unused);
+				spin_lock(&set->lock);
+				set->num_waiters--;
 				continue;
 			}
 
 			/*
-			 * At least one unused cache entry.  A simple
+			 * At least one unused entry in the set.  A simple
 			 * round-robin strategy is used to choose the entry to
-			 * be evicted from the cache.
+			 * be evicted from the set.
 			 */
-			i = cache->next_blk;
-			for (n = 0; n < cache->entries; n++) {
-				if (cache->entry[i].refcount == 0)
+			i = set->next_blk;
+			for (n = 0; n < cache->ways; n++) {
+				if (cache->entry[first + i].refcount == 0)
 					break;
-				i = (i + 1) % cache->entries;
+				i = (i + 1) % cache->ways;
 			}
 
-			cache->next_blk = (i + 1) % cache->entries;
+			set->next_blk = (i + 1) % cache->ways;
+			i += first;
 			entry = &cache->entry[i];
 
 			/*
 			 * Initialise chosen cache entry, and fill it in from
 			 * disk.
 			 */
-			cache->unused--;
+			set->unused--;
+			set->misses++;
 			entry->block = block;
 			entry->refcount = 1;
 			entry->pending = 1;
 			entry->num_waiters = 0;
 			entry->error = 0;
-			spin_unlock(&cache->lock);
+			spin_unlock(&set->lock);
 
 			entry->length = squashfs_read_data(sb, block, length,
 				&entry->next_index, entry->actor);
 
-			spin_lock(&cache->lock);
+			spin_lock(&set->lock);
 
 			if (entry->length < 0)
 				entry->error = entry->length;
@@ -123,10 +135,10 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			 * waiting for it to become available.
 			 */
 			if (entry->num_waiters) {
-				spin_unlock(&cache->lock);
+				spin_unlock(&set->lock);
 				wake_up_all(&entry->wait_queue);
 			} else
-				spin_unlock(&cache->lock);
+				spin_unlock(&set->lock);
 
 			goto out;
 		}
@@ -134,13 +146,14 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		/*
 		 * Block already in cache.  Increment refcount so it doesn't
 		 * get reused until we're finished with it, if it was
-		 * previously unused there's one less cache entry available
-		 * for reuse.
+		 * previously unused there's one less entry in the set
+		 * available for reuse.
 		 */
 		entry = &cache->entry[i];
 		if (entry->refcount == 0)
-			cache->unused--;
+			set->unused--;
 		entry->refcount++;
+		set->hits++;
 
 		/*
 		 * If the entry is currently being filled in by another process
@@ -148,10 +161,10 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		 */
 		if (entry->pending) {
 			entry->num_waiters++;
-			spin_unlock(&cache->lock);
+			spin_unlock(&set->lock);
 			wait_event(entry->wait_queue, !entry->pending);
 		} else
-			spin_unlock(&cache->lock);
+			spin_unlock(&set->lock);
 
 		goto out;
 	}
@@ -172,23 +185,23 @@ out:
  */
 void squashfs_cache_put(struct squashfs_cache_entry *entry)
 {
-	struct squashfs_cache *cache = entry->cache;
+	struct squashfs_cache_set *set = entry->set;
 
-	spin_lock(&cache->lock);
+	spin_lock(&set->lock);
 	entry->refcount--;
 	if (entry->refcount == 0) {
-		cache->unused++;
+		set->unused++;
 		/*
 		 * If there's any processes waiting for a block to become
-		 * available, wake one up.
+		 * available in this set, wake one up.
 		 */
-		if (cache->num_waiters) {
-			spin_unlock(&cache->lock);
-			wake_up(&cache->wait_queue);
+		if (set->num_waiters) {
+			spin_unlock(&set->lock);
+			wake_up(&set->wait_queue);
 			return;
 		}
 	}
-	spin_unlock(&cache->lock);
+	spin_unlock(&set->lock);
 }
 
 /*
@@ -201,7 +214,7 @@ void squashfs_cache_delete(struct squashfs_cache *cache)
 	if (cache == NULL)
 		return;
 
-	for (i = 0; i < cache->entries; i++) {
+	for (i = 0; cache->entry && i < cache->entries; i++) {
 		if (cache->entry[i].data) {
 			for (j = 0; j < cache->pages; j++)
 				kfree(cache->entry[i].data[j]);
@@ -211,6 +224,7 @@ void squashfs_cache_delete(struct squashfs_cache *cache)
 	}
 
 	kfree(cache->entry);
+	kfree(cache->set);
 	kfree(cache);
 }
 
@@ -219,6 +233,12 @@ void squashfs_cache_delete(struct squashfs_cache *cache)
  * Initialise cache allocating the specified number of entries, each of
  * size block_size.  To avoid vmalloc fragmentation issues each entry
  * is allocated as a sequence of kmalloced PAGE_SIZE buffers.
+ *
+ * Caches of up to 2 * SQUASHFS_CACHE_WAYS entries are kept as a single
+ * fully associative set, splitting them would only cost hit rate.  Larger
+ * caches are split into a power of two number of sets of between
+ * SQUASHFS_CACHE_WAYS and 2 * SQUASHFS_CACHE_WAYS entries, rounding
+ * entries up to fill the last set.
  */
 struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 	int block_size)
@@ -231,29 +251,43 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 		return NULL;
 	}
 
+	cache->sets = entries > 2 * SQUASHFS_CACHE_WAYS ?
+		rounddown_pow_of_two(entries / SQUASHFS_CACHE_WAYS) : 1;
+	cache->ways = DIV_ROUND_UP(entries, cache->sets);
+	entries = cache->sets * cache->ways;
+
+	cache->set = kcalloc(cache->sets, sizeof(*(cache->set)), GFP_KERNEL);
+	if (cache->set == NULL) {
+		ERROR("Failed to allocate %s cache\n", name);
+		goto cleanup;
+	}
+
 	cache->entry = kcalloc(entries, sizeof(*(cache->entry)), GFP_KERNEL);
 	if (cache->entry == NULL) {
 		ERROR("Failed to allocate %s cache\n", name);
 		goto cleanup;
 	}
 
-	cache->curr_blk = 0;
-	cache->next_blk = 0;
-	cache->unused = entries;
 	cache->entries = entries;
 	cache->block_size = block_size;
 	cache->pages = block_size >> PAGE_SHIFT;
 	cache->pages = cache->pages ? cache->pages : 1;
 	cache->name = name;
-	cache->num_waiters = 0;
-	spin_lock_init(&cache->lock);
-	init_waitqueue_head(&cache->wait_queue);
+
+	for (i = 0; i < cache->sets; i++) {
+		struct squashfs_cache_set *set = &cache->set[i];
+
+		spin_lock_init(&set->lock);
+		init_waitqueue_head(&set->wait_queue);
+		set->unused = cache->ways;
+	}
 
 	for (i = 0; i < entries; i++) {
 		struct squashfs_cache_entry *entry = &cache->entry[i];
 
 		init_waitqueue_head(&cache->entry[i].wait_queue);
 		entry->cache = cache;
+		entry->set = &cache->set[i / cache->ways];
 		entry->block = SQUASHFS_INVALID_BLK;
 		entry->data = kcalloc(cache->pages, sizeof(void *), GFP_KERNEL);
 		if (entry->data == NULL) {
@@ -285,6 +319,30 @@ cleanup:
 }
 
 
+/*
+ * Report the lookup statistics of a cache, summed over its sets.  The
+ * counters are sampled without the set locks.
+ */
+void squashfs_cache_show_stats(struct seq_file *m,
+	struct squashfs_cache *cache)
+{
+	unsigned long hits = 0, misses = 0, waits = 0;
+	int i;
+
+	if (cache == NULL)
+		return;
+
+	for (i = 0; i < cache->sets; i++) {
+		hits += READ_ONCE(cache->set[i].hits);
+		misses += READ_ONCE(cache->set[i].misses);
+		waits += READ_ONCE(cache->set[i].waits);
+	}
+
+	seq_printf(m, "\n\t%s cache: entries %d sets %d hits %lu misses %lu waits %lu",
+		cache->name, cache->entries, cache->sets, hits, misses, waits);
+}
+
+
 /*
  * Copy up to length bytes from cache entry to buffer starting at offset bytes
  * into the cache entry.  If there's not length bytes then copy the number of
@@ -494,7 +494,163 @@ out:
 	return 0;
 }
 
+/* Fill the pages of a fragment or sparse block, releasing them */
+static void squashfs_readahead_fill(struct page **page, int pages,
+	struct squashfs_cache_entry *buffer, int offset, int bytes)
+{
+	int n;
+
+	for (n = 0; n < pages; n++, bytes -= PAGE_SIZE, offset += PAGE_SIZE) {
+		int avail = buffer ? clamp_t(int, bytes, 0, PAGE_SIZE) : 0;
+
+		if (page[n] == NULL)
+			continue;
+
+		squashfs_fill_page(page[n], buffer, offset, avail);
+		unlock_page(page[n]);
+		put_page(page[n]);
+	}
+}
+
+/*
+ * Readahead is handed out one datablock at a time, so each block is read
+ * and decompressed once for all of its pages rather than once per
+ * squashfs_readpage() call.  With direct decompression the read of the
+ * next block in the window is submitted before the current block is
+ * decompressed, overlapping the device I/O with the decompressor.
+ */
+static void squashfs_readahead(struct readahead_control *ractl)
+{
+	struct inode *inode = ractl->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_SHIFT;
+	int mask = (1 << shift) - 1, max_pages = 1 << shift;
+	loff_t i_size = i_size_read(inode);
+	int file_end = i_size >> msblk->block_log;
+	pgoff_t end_page = (i_size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	pgoff_t next = readahead_index(ractl);
+	struct squashfs_read_req req[2] = { };
+	struct page **batch, **page;
+	int cur = 0;
+
+	TRACE("Entered squashfs_readahead, index %lx, count %x\n",
+				readahead_index(ractl), readahead_count(ractl));
+
+	batch = kmalloc_array(max_pages * 2, sizeof(void *), GFP_KERNEL);
+	if (batch == NULL)
+		return;
+	page = batch + max_pages;
+
+	for (;;) {
+		int index = next >> shift;
+		pgoff_t start_index = next & ~mask;
+		int expected = index == file_end ?
+				(i_size & (msblk->block_size - 1)) :
+				 msblk->block_size;
+		int i, nr_pages, pages, bsize, res;
+		u64 block = 0;
+
+		nr_pages = __readahead_batch(ractl, batch,
+					     max_pages - (next & mask));
+		if (!nr_pages)
+			break;
+		next += nr_pages;
+
+		memset(page, 0, max_pages * sizeof(void *));
+		for (i = 0; i < nr_pages; i++)
+			page[batch[i]->index & mask] = batch[i];
+
+		/* Pages beyond the end of file are zero filled */
+		pages = start_index >= end_page ? 0 :
+			min_t(pgoff_t, max_pages, end_page - start_index);
+		squashfs_readahead_fill(page + pages, max_pages - pages,
+					NULL, 0, 0);
+		if (!pages)
+			continue;
+
+		if (index < file_end || squashfs_i(inode)->fragment_block ==
+						SQUASHFS_INVALID_BLK) {
+			bsize = read_blocklist(inode, index, &block);
+			if (bsize < 0)
+				goto error_out;
+
+			if (bsize == 0) {
+				squashfs_readahead_fill(page, pages, NULL, 0, 0);
+				continue;
+			}
+
+			/*
+			 * readahead_count() still includes this batch, so
+			 * anything above nr_pages is the following block.
+			 */
+			if (IS_ENABLED(CONFIG_SQUASHFS_FILE_DIRECT)) {
+				struct squashfs_read_req *r = &req[!cur];
+				u64 next_block = 0;
+				int next_bsize;
+
+				if (req[cur].bio && req[cur].index != block)
+					squashfs_read_data_cancel(&req[cur]);
+				if (!req[cur].bio)
+					squashfs_read_data_submit(inode->i_sb,
+						block, bsize, &req[cur]);
+
+				squashfs_read_data_cancel(r);
+				if (readahead_count(ractl) > nr_pages &&
+				    ((loff_t)(index + 1) << msblk->block_log) <
+						i_size &&
+				    (index + 1 < file_end ||
+				     squashfs_i(inode)->fragment_block ==
+						SQUASHFS_INVALID_BLK)) {
+					next_bsize = read_blocklist(inode,
+						index + 1, &next_block);
+					if (next_bsize > 0)
+						squashfs_read_data_submit(
+							inode->i_sb, next_block,
+							next_bsize, r);
+				}
+			}
+
+			squashfs_readahead_block(ractl->mapping, page, pages,
+				start_index, block, bsize, &req[cur], expected);
+			cur = !cur;
+		} else {
+			struct squashfs_cache_entry *buffer =
+				squashfs_get_fragment(inode->i_sb,
+					squashfs_i(inode)->fragment_block,
+					squashfs_i(inode)->fragment_size);
+
+			res = buffer->error;
+			if (res) {
+				ERROR("Unable to read page, block %llx, size %x\n",
+					squashfs_i(inode)->fragment_block,
+					squashfs_i(inode)->fragment_size);
+				squashfs_cache_put(buffer);
+				goto error_out;
+			}
+
+			squashfs_readahead_fill(page, pages, buffer,
+				squashfs_i(inode)->fragment_offset, expected);
+			squashfs_cache_put(buffer);
+		}
+		continue;
+
+error_out:
+		for (i = 0; i < pages; i++) {
+			if (page[i] == NULL)
+				continue;
+			SetPageError(page[i]);
+			unlock_page(page[i]);
+			put_page(page[i]);
+		}
+	}
+
+	squashfs_read_data_cancel(&req[0]);
+	squashfs_read_data_cancel(&req[1]);
+	kfree(batch);
+}
+
 
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+	.readahead = squashfs_readahead
 };
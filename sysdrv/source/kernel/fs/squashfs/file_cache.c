@@ -34,3 +34,39 @@ int squashfs_readpage_block(struct page *page, u64 block, int bsize, int expecte
 	squashfs_cache_put(buffer);
 	return res;
 }
+
+/* Read datablock for readahead, all pages are unlocked and released */
+int squashfs_readahead_block(struct address_space *mapping, struct page **page,
+	int pages, pgoff_t start_index, u64 block, int bsize,
+	struct squashfs_read_req *req, int expected)
+{
+	struct inode *i = mapping->host;
+	struct squashfs_cache_entry *buffer;
+	int n, res, offset = 0;
+
+	squashfs_read_data_cancel(req);
+
+	buffer = squashfs_get_datablock(i->i_sb, block, bsize);
+	res = buffer->error;
+	if (res)
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+
+	for (n = 0; n < pages; n++, offset += PAGE_SIZE) {
+		int avail = clamp_t(int, expected - offset, 0, PAGE_SIZE);
+
+		if (page[n] == NULL)
+			continue;
+
+		if (res) {
+			flush_dcache_page(page[n]);
+			SetPageError(page[n]);
+		} else
+			squashfs_fill_page(page[n], buffer, offset, avail);
+		unlock_page(page[n]);
+		put_page(page[n]);
+	}
+
+	squashfs_cache_put(buffer);
+	return res;
+}
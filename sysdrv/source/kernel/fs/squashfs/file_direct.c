@@ -18,8 +18,8 @@
 #include "squashfs.h"
 #include "page_actor.h"
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page, int bytes);
+static int squashfs_read_cache(struct inode *i, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page, int bytes);
 
 /* Read separately compressed datablock directly into page cache */
 int squashfs_readpage_block(struct page *target_page, u64 block, int bsize,
@@ -81,8 +81,8 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize,
 		 * squashfs_readpage also trying to grab them.  Fall back to
 		 * using an intermediate buffer.
 		 */
-		res = squashfs_read_cache(target_page, block, bsize, pages,
-							page, expected);
+		res = squashfs_read_cache(inode, target_page, block, bsize,
+							pages, page, expected);
 		if (res < 0)
 			goto mark_errored;
 
@@ -141,10 +141,110 @@ out:
 }
 
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page, int bytes)
+/*
+ * Read datablock for readahead.  Page[] holds the locked pages of the
+ * datablock starting at start_index, NULL for the ones readahead did not
+ * allocate.  If req has been submitted for this block its I/O is already in
+ * flight.  All pages are unlocked and released on return.
+ */
+int squashfs_readahead_block(struct address_space *mapping, struct page **page,
+	int pages, pgoff_t start_index, u64 block, int bsize,
+	struct squashfs_read_req *req, int expected)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_page_actor *actor;
+	int i, missing_pages, bytes, res = -ENOMEM;
+	void *pageaddr;
+
+	/*
+	 * Readahead windows do not have to be aligned to the datablock, grab
+	 * the rest of the block so it can be decompressed directly
+	 */
+	for (missing_pages = 0, i = 0; i < pages; i++) {
+		if (page[i] == NULL)
+			page[i] = grab_cache_page_nowait(mapping,
+							 start_index + i);
+
+		if (page[i] == NULL) {
+			missing_pages++;
+			continue;
+		}
+
+		if (PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			put_page(page[i]);
+			page[i] = NULL;
+			missing_pages++;
+		}
+	}
+
+	if (req->bio && req->index != block)
+		squashfs_read_data_cancel(req);
+
+	if (missing_pages) {
+		squashfs_read_data_cancel(req);
+		res = squashfs_read_cache(inode, NULL, block, bsize, pages,
+							page, expected);
+		if (res < 0)
+			goto mark_errored;
+
+		return 0;
+	}
+
+	actor = squashfs_page_actor_init_special(page, pages, 0);
+	if (actor == NULL)
+		goto mark_errored;
+
+	/* Decompress directly into the page cache buffers */
+	if (req->bio)
+		res = squashfs_read_data_wait(inode->i_sb, req, actor);
+	else
+		res = squashfs_read_data(inode->i_sb, block, bsize, NULL,
+							actor);
+	kfree(actor);
+	if (res < 0)
+		goto mark_errored;
+
+	if (res != expected) {
+		res = -EIO;
+		goto mark_errored;
+	}
+
+	/* Last page may have trailing bytes not filled */
+	bytes = res % PAGE_SIZE;
+	if (bytes) {
+		pageaddr = kmap_atomic(page[pages - 1]);
+		memset(pageaddr + bytes, 0, PAGE_SIZE - bytes);
+		kunmap_atomic(pageaddr);
+	}
+
+	for (i = 0; i < pages; i++) {
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+		unlock_page(page[i]);
+		put_page(page[i]);
+	}
+
+	return 0;
+
+mark_errored:
+	squashfs_read_data_cancel(req);
+	for (i = 0; i < pages; i++) {
+		if (page[i] == NULL)
+			continue;
+		flush_dcache_page(page[i]);
+		SetPageError(page[i]);
+		unlock_page(page[i]);
+		put_page(page[i]);
+	}
+
+	return res;
+}
+
+
+static int squashfs_read_cache(struct inode *i, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page, int bytes)
 {
-	struct inode *i = target_page->mapping->host;
 	struct squashfs_cache_entry *buffer = squashfs_get_datablock(i->i_sb,
 						 block, bsize);
 	int res = buffer->error, n, offset = 0;
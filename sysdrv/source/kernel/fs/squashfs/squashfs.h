@@ -15,8 +15,21 @@
 #define WARNING(s, args...)	pr_warn("SQUASHFS: "s, ## args)
 
 /* block.c */
+struct squashfs_read_req {
+	struct bio		*bio;
+	struct completion	done;
+	u64			index;
+	int			length;
+};
+
 extern int squashfs_read_data(struct super_block *, u64, int, u64 *,
 				struct squashfs_page_actor *);
+extern int squashfs_read_data_submit(struct super_block *, u64, int,
+				struct squashfs_read_req *);
+extern int squashfs_read_data_wait(struct super_block *,
+				struct squashfs_read_req *,
+				struct squashfs_page_actor *);
+extern void squashfs_read_data_cancel(struct squashfs_read_req *);
 
 /* cache.c */
 extern struct squashfs_cache *squashfs_cache_init(char *, int, int);
@@ -25,6 +38,8 @@ extern struct squashfs_cache_entry *squashfs_cache_get(struct super_block *,
 				struct squashfs_cache *, u64, int);
 extern void squashfs_cache_put(struct squashfs_cache_entry *);
 extern int squashfs_copy_data(void *, struct squashfs_cache_entry *, int, int);
+extern void squashfs_cache_show_stats(struct seq_file *,
+				struct squashfs_cache *);
 extern int squashfs_read_metadata(struct super_block *, void *, u64 *,
 				int *, int);
 extern struct squashfs_cache_entry *squashfs_get_fragment(struct super_block *,
@@ -60,6 +75,9 @@ void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int, int);
+extern int squashfs_readahead_block(struct address_space *, struct page **,
+				int, pgoff_t, u64, int, struct squashfs_read_req *,
+				int);
 
 /* id.c */
 extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
@@ -12,17 +12,25 @@
 
 #include "squashfs_fs.h"
 
-struct squashfs_cache {
-	char			*name;
-	int			entries;
-	int			curr_blk;
+struct squashfs_cache_set {
+	spinlock_t		lock;
 	int			next_blk;
 	int			num_waiters;
 	int			unused;
+	wait_queue_head_t	wait_queue;
+	unsigned long		hits;
+	unsigned long		misses;
+	unsigned long		waits;
+} ____cacheline_aligned_in_smp;
+
+struct squashfs_cache {
+	char			*name;
+	int			entries;
+	int			sets;
+	int			ways;
 	int			block_size;
 	int			pages;
-	spinlock_t		lock;
-	wait_queue_head_t	wait_queue;
+	struct squashfs_cache_set *set;
 	struct squashfs_cache_entry *entry;
 };
 
@@ -36,6 +44,7 @@ struct squashfs_cache_entry {
 	int			num_waiters;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache	*cache;
+	struct squashfs_cache_set	*set;
 	void			**data;
 	struct squashfs_page_actor	*actor;
 };
@@ -65,5 +74,7 @@ struct squashfs_sb_info {
 	unsigned int				fragments;
 	int					xattr_ids;
 	unsigned int				ids;
+	int					meta_cache;
+	int					frag_cache;
 };
 #endif
@@ -18,6 +18,7 @@
 
 #include <linux/fs.h>
 #include <linux/fs_context.h>
+#include <linux/fs_parser.h>
 #include <linux/vfs.h>
 #include <linux/slab.h>
 #include <linux/mutex.h>
@@ -26,6 +27,7 @@
 #include <linux/module.h>
 #include <linux/magic.h>
 #include <linux/xattr.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -37,6 +39,22 @@
 static struct file_system_type squashfs_fs_type;
 static const struct super_operations squashfs_super_ops;
 
+enum squashfs_param {
+	Opt_meta_cache,
+	Opt_frag_cache,
+};
+
+static const struct fs_parameter_spec squashfs_fs_parameters[] = {
+	fsparam_u32("meta_cache",	Opt_meta_cache),
+	fsparam_u32("frag_cache",	Opt_frag_cache),
+	{}
+};
+
+struct squashfs_mount_opts {
+	int meta_cache;
+	int frag_cache;
+};
+
 static const struct squashfs_decompressor *supported_squashfs_filesystem(
 	struct fs_context *fc,
 	short major, short minor, short id)
@@ -67,6 +85,7 @@ static const struct squashfs_decompressor *supported_squashfs_filesystem(
 
 static int squashfs_fill_super(struct super_block *sb, struct fs_context *fc)
 {
+	struct squashfs_mount_opts *opts = fc->fs_private;
 	struct squashfs_sb_info *msblk;
 	struct squashfs_super_block *sblk = NULL;
 	struct inode *root;
@@ -84,6 +103,8 @@ static int squashfs_fill_super(struct super_block *sb, struct fs_context *fc)
 		return -ENOMEM;
 	}
 	msblk = sb->s_fs_info;
+	msblk->meta_cache = opts->meta_cache;
+	msblk->frag_cache = opts->frag_cache;
 
 	msblk->devblksize = sb_min_blocksize(sb, SQUASHFS_DEVBLK_SIZE);
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
@@ -195,7 +216,7 @@ static int squashfs_fill_super(struct super_block *sb, struct fs_context *fc)
 	err = -ENOMEM;
 
 	msblk->block_cache = squashfs_cache_init("metadata",
-			SQUASHFS_CACHED_BLKS, SQUASHFS_METADATA_SIZE);
+			msblk->meta_cache, SQUASHFS_METADATA_SIZE);
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
@@ -270,7 +291,7 @@ handle_fragments:
 		goto check_directory_table;
 
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		msblk->frag_cache, msblk->block_size);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
@@ -348,24 +369,109 @@ static int squashfs_get_tree(struct fs_context *fc)
 	return get_tree_bdev(fc, squashfs_fill_super);
 }
 
+static int squashfs_parse_param(struct fs_context *fc,
+				struct fs_parameter *param)
+{
+	struct squashfs_mount_opts *opts = fc->fs_private;
+	struct fs_parse_result result;
+	int opt;
+
+	opt = fs_parse(fc, squashfs_fs_parameters, param, &result);
+	if (opt < 0)
+		return opt;
+
+	if (result.uint_32 < 1 || result.uint_32 > SQUASHFS_CACHE_MAX_ENTRIES)
+		return invalfc(fc, "%s must be between 1 and %d", param->key,
+			       SQUASHFS_CACHE_MAX_ENTRIES);
+
+	switch (opt) {
+	case Opt_meta_cache:
+		opts->meta_cache = result.uint_32;
+		break;
+	case Opt_frag_cache:
+		opts->frag_cache = result.uint_32;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
 static int squashfs_reconfigure(struct fs_context *fc)
 {
+	struct squashfs_sb_info *msblk = fc->root->d_sb->s_fs_info;
+	struct squashfs_mount_opts *opts = fc->fs_private;
+
+	/* The caches are sized at mount time */
+	if (opts->meta_cache != msblk->meta_cache ||
+	    opts->frag_cache != msblk->frag_cache)
+		warnf(fc, "cache sizes cannot be changed on remount");
+
 	sync_filesystem(fc->root->d_sb);
 	fc->sb_flags |= SB_RDONLY;
 	return 0;
 }
 
+static void squashfs_free_fs_context(struct fs_context *fc)
+{
+	kfree(fc->fs_private);
+}
+
 static const struct fs_context_operations squashfs_context_ops = {
 	.get_tree	= squashfs_get_tree,
 	.reconfigure	= squashfs_reconfigure,
+	.parse_param	= squashfs_parse_param,
+	.free		= squashfs_free_fs_context,
 };
 
 static int squashfs_init_fs_context(struct fs_context *fc)
 {
+	struct squashfs_mount_opts *opts;
+
+	opts = kzalloc(sizeof(*opts), GFP_KERNEL);
+	if (!opts)
+		return -ENOMEM;
+
+	opts->meta_cache = SQUASHFS_CACHED_BLKS;
+	opts->frag_cache = SQUASHFS_CACHED_FRAGMENTS;
+	if (fc->purpose == FS_CONTEXT_FOR_RECONFIGURE) {
+		struct squashfs_sb_info *msblk = fc->root->d_sb->s_fs_info;
+
+		opts->meta_cache = msblk->meta_cache;
+		opts->frag_cache = msblk->frag_cache;
+	}
+
+	fc->fs_private = opts;
 	fc->ops = &squashfs_context_ops;
 	return 0;
 }
 
+static int squashfs_show_options(struct seq_file *s, struct dentry *root)
+{
+	struct squashfs_sb_info *msblk = root->d_sb->s_fs_info;
+
+	if (msblk->meta_cache != SQUASHFS_CACHED_BLKS)
+		seq_printf(s, ",meta_cache=%d", msblk->meta_cache);
+	if (msblk->frag_cache != SQUASHFS_CACHED_FRAGMENTS)
+		seq_printf(s, ",frag_cache=%d", msblk->frag_cache);
+
+	return 0;
+}
+
+/* Cache statistics, reported in /proc/<pid>/mountstats */
+static int squashfs_show_stats(struct seq_file *s, struct dentry *root)
+{
+	struct squashfs_sb_info *msblk = root->d_sb->s_fs_info;
+
+	seq_puts(s, "statvers=1.0");
+	squashfs_cache_show_stats(s, msblk->block_cache);
+	squashfs_cache_show_stats(s, msblk->fragment_cache);
+	squashfs_cache_show_stats(s, msblk->read_page);
+
+	return 0;
+}
+
 static int squashfs_statfs(struct dentry *dentry, struct kstatfs *buf)
 {
 	struct squashfs_sb_info *msblk = dentry->d_sb->s_fs_info;
@@ -481,6 +587,7 @@ static struct file_system_type squashfs_fs_type = {
 	.owner = THIS_MODULE,
 	.name = "squashfs",
 	.init_fs_context = squashfs_init_fs_context,
+	.parameters = squashfs_fs_parameters,
 	.kill_sb = kill_block_super,
 	.fs_flags = FS_REQUIRES_DEV
 };
@@ -491,6 +598,8 @@ static const struct super_operations squashfs_super_ops = {
 	.free_inode = squashfs_free_inode,
 	.statfs = squashfs_statfs,
 	.put_super = squashfs_put_super,
+	.show_options = squashfs_show_options,
+	.show_stats = squashfs_show_stats,
 };
 
 module_init(init_squashfs_fs);
@@ -42,6 +42,10 @@
 #define RKCIF_CMD_START_CAPTURE_ONE_FRAME_AOV \
 	_IOW('V', BASE_VIDIOC_PRIVATE + 9, int)
 
+/* 1: when no buffer is queued, overwrite the oldest frame, 0: drop the newest */
+#define RKCIF_CMD_SET_LATEST_FRAME \
+	_IOW('V', BASE_VIDIOC_PRIVATE + 10, int)
+
 /* cif memory mode
  * 0: raw12/raw10/raw8 8bit memory compact
  * 1: raw12/raw10 16bit memory one pixel
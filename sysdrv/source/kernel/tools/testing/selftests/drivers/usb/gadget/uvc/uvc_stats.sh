@@ -0,0 +1,80 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Check that a steady uvc gadget stream reports no underruns.
+#
+# Run while a host is streaming from the gadget and the gadget side keeps
+# its buffer queue fed. The uvc_stats attribute of every uvc function in
+# configfs is sampled twice, SAMPLE_SECS apart, and underruns_total must
+# not grow on any function that streamed for the whole interval. CONFIGFS
+# overrides the configfs mount point.
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+
+SAMPLE_SECS=${SAMPLE_SECS:-5}
+CONFIGFS=${CONFIGFS:-$(awk '$3 == "configfs" { print $2; exit }' /proc/mounts)}
+
+stat_get()
+{
+	awk -v key="$2:" '$1 == key { print $2 }' "$1"
+}
+
+if [ -z "$CONFIGFS" ]; then
+	echo "SKIP: configfs is not mounted"
+	exit $ksft_skip
+fi
+
+files=$(ls "$CONFIGFS"/usb_gadget/*/functions/uvc.*/uvc_stats 2>/dev/null)
+if [ -z "$files" ]; then
+	echo "SKIP: no uvc function with uvc_stats"
+	exit $ksft_skip
+fi
+
+streaming=""
+for f in $files; do
+	fps=$(stat_get "$f" frames_per_sec)
+	[ "${fps:-0}" -gt 0 ] && streaming="$streaming $f"
+done
+
+if [ -z "$streaming" ]; then
+	echo "SKIP: no uvc function is streaming"
+	exit $ksft_skip
+fi
+
+before=""
+for f in $streaming; do
+	before="$before $(stat_get "$f" underruns_total)"
+done
+
+sleep "$SAMPLE_SECS"
+
+ret=0
+checked=0
+for f in $streaming; do
+	set -- $before
+	old=$1
+	shift
+	before="$*"
+
+	fps=$(stat_get "$f" frames_per_sec)
+	if [ "${fps:-0}" -eq 0 ]; then
+		echo "SKIP: $f stopped streaming"
+		continue
+	fi
+
+	new=$(stat_get "$f" underruns_total)
+	checked=$((checked + 1))
+	if [ "$new" -ne "$old" ]; then
+		echo "FAIL: $f: $((new - old)) underruns in ${SAMPLE_SECS}s at $fps fps"
+		ret=1
+	else
+		echo "PASS: $f: no underruns in ${SAMPLE_SECS}s at $fps fps"
+	fi
+done
+
+if [ $checked -eq 0 ]; then
+	exit $ksft_skip
+fi
+
+exit $ret